@@ -40,6 +40,7 @@
 // TLMPlugin includes
 #include "Plugin/TLMPlugin.h"
 #include "Logging/TLMErrorLog.h"
+#include "Logging/TLMTrace.h"
 #include "common.h"
 
 using namespace std;
@@ -94,7 +95,24 @@ static fmi2_real_t* states_abstol = 0;
 static fmi2_real_t* states_der = 0;
 static fmi2_import_t* fmu = 0;
 
+// The bidirectional interfaces grouped by type, for the batched plugin calls
+struct tlmBatch_t {
+  std::vector<size_t> index3D;         // Index of the 3D interfaces in fmiConfig
+  std::vector<int> ids3D;              // Interface IDs of the 3D interfaces
+  std::vector<double> position3D;
+  std::vector<double> orientation3D;
+  std::vector<double> speed3D;
+  std::vector<double> ang_speed3D;
+  std::vector<double> force3D;
+  std::vector<size_t> index1D;         // Index of the 1D interfaces in fmiConfig
+  std::vector<int> ids1D;              // Interface IDs of the 1D interfaces
+  std::vector<double> position1D;
+  std::vector<double> speed1D;
+  std::vector<double> force1D;
+};
+
 static fmiConfig_t fmiConfig = fmiConfig_t();
+static tlmBatch_t tlmBatch = tlmBatch_t();
 static tlmConfig_t tlmConfig = tlmConfig_t();
 static simConfig_t simConfig = simConfig_t();
 
@@ -286,56 +304,133 @@ void applyStartValues()
     }
 }
 
-//Read force from TLMPlugin and write it to FMU
-void forceFromTlmToFmu(double tcur)
+//Group the bidirectional interfaces by type for the batched plugin calls
+void initializeBatches()
 {
-    //Write interpolated force to FMU
-    for(size_t j=0; j<fmiConfig.nInterfaces; ++j) {
-        if(fmiConfig.dimensions[j] == 6 &&
-           fmiConfig.domains[j] == "Mechanical" &&
-           fmiConfig.causalities[j] == "Bidirectional") {
-            double position[3],orientation[9],speed[3],ang_speed[3],force[6];
-            //Read position and speed from FMU
-            fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],3,position);
-            fmistatus = fmi2_import_get_real(fmu,fmiConfig.orientation_vr[j],9,orientation);
-            fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],3,speed);
-            fmistatus = fmi2_import_get_real(fmu,fmiConfig.ang_speed_vr[j],3,ang_speed);
+  for(size_t j=0; j<fmiConfig.nInterfaces; ++j) {
+    if(fmiConfig.causalities[j] != "Bidirectional") {
+      continue;
+    }
+    if(fmiConfig.dimensions[j] == 6) {
+      tlmBatch.index3D.push_back(j);
+      tlmBatch.ids3D.push_back(fmiConfig.interfaceIds[j]);
+    }
+    else if(fmiConfig.dimensions[j] == 1) {
+      tlmBatch.index1D.push_back(j);
+      tlmBatch.ids1D.push_back(fmiConfig.interfaceIds[j]);
+    }
+  }
 
-            //Get interpolated force
-            plugin->GetForce3D(fmiConfig.interfaceIds[j], tcur, position,orientation,speed,ang_speed,force);
+  size_t n3D = tlmBatch.index3D.size();
+  tlmBatch.position3D.resize(3*n3D);
+  tlmBatch.orientation3D.resize(9*n3D);
+  tlmBatch.speed3D.resize(3*n3D);
+  tlmBatch.ang_speed3D.resize(3*n3D);
+  tlmBatch.force3D.resize(6*n3D);
+
+  size_t n1D = tlmBatch.index1D.size();
+  tlmBatch.position1D.resize(n1D);
+  tlmBatch.speed1D.resize(n1D);
+  tlmBatch.force1D.resize(n1D);
+}
 
-            for(size_t k=0; k<6; ++k) {
-              force[k] = -force[k];
-            }
+//Read position and speed of the bidirectional interfaces from FMU
+void readMotionFromFmu()
+{
+  for(size_t k=0; k<tlmBatch.index3D.size(); ++k) {
+    size_t j = tlmBatch.index3D[k];
+    fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],3,&tlmBatch.position3D[3*k]);
+    fmistatus = fmi2_import_get_real(fmu,fmiConfig.orientation_vr[j],9,&tlmBatch.orientation3D[9*k]);
+    fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],3,&tlmBatch.speed3D[3*k]);
+    fmistatus = fmi2_import_get_real(fmu,fmiConfig.ang_speed_vr[j],3,&tlmBatch.ang_speed3D[3*k]);
+  }
+  for(size_t k=0; k<tlmBatch.index1D.size(); ++k) {
+    size_t j = tlmBatch.index1D[k];
+    fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],1,&tlmBatch.position1D[k]);
+    fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],1,&tlmBatch.speed1D[k]);
+  }
+}
 
-            // Write force to FMU
-            fmistatus = fmi2_import_set_real(fmu,fmiConfig.force_vr[j],6,force);
-        }
-        else if(fmiConfig.dimensions[j] == 1  &&
-                fmiConfig.causalities[j] == "Bidirectional") {
-          double position,speed,force;
+//Get interpolated forces of all bidirectional interfaces from TLMPlugin
+void getForcesFromTlm(double tcur)
+{
+  if(!tlmBatch.ids3D.empty()) {
+    plugin->GetForces3D(int(tlmBatch.ids3D.size()), &tlmBatch.ids3D[0], tcur,
+                        &tlmBatch.position3D[0], &tlmBatch.orientation3D[0],
+                        &tlmBatch.speed3D[0], &tlmBatch.ang_speed3D[0], &tlmBatch.force3D[0]);
+  }
+  if(!tlmBatch.ids1D.empty()) {
+    plugin->GetForces1D(int(tlmBatch.ids1D.size()), &tlmBatch.ids1D[0], tcur,
+                        &tlmBatch.speed1D[0], &tlmBatch.force1D[0]);
+  }
+}
 
-          //Read position and speed from FMU
-          fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],1,&position);
-          fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],1,&speed);
+//Write motion of all bidirectional interfaces to TLMPlugin
+void setMotionsToTlm(double tcur)
+{
+  if(!tlmBatch.ids3D.empty()) {
+    plugin->SetMotions3D(int(tlmBatch.ids3D.size()), &tlmBatch.ids3D[0], tcur,
+                         &tlmBatch.position3D[0], &tlmBatch.orientation3D[0],
+                         &tlmBatch.speed3D[0], &tlmBatch.ang_speed3D[0]);
+  }
+  if(!tlmBatch.ids1D.empty()) {
+    plugin->SetMotions1D(int(tlmBatch.ids1D.size()), &tlmBatch.ids1D[0], tcur,
+                         &tlmBatch.position1D[0], &tlmBatch.speed1D[0]);
+  }
+}
 
-          //Get interpolated force
-          plugin->GetForce1D(fmiConfig.interfaceIds[j], tcur, speed,&force);
+//Read output values from FMU and write them to TLMPlugin
+void valuesFromFmuToTlm(double tcur)
+{
+  for(size_t j=0; j<fmiConfig.nInterfaces; ++j) {
+    if(fmiConfig.dimensions[j] == 1 &&
+       fmiConfig.causalities[j] == "Output") {
+      double value;
 
-          if(fmiConfig.domains[j] != "Hydraulic") {
-              force = -force;
-          }
+      fmistatus = fmi2_import_get_real(fmu,fmiConfig.value_vr[j],1,&value);
 
-          // Write force to FMU
-          fmistatus = fmi2_import_set_real(fmu,fmiConfig.force_vr[j],1,&force);
+      plugin->SetValueSignal(fmiConfig.interfaceIds[j], tcur, value);
+    }
+  }
+}
+
+//Read force from TLMPlugin and write it to FMU
+void forceFromTlmToFmu(double tcur)
+{
+    //Read position and speed from FMU
+    readMotionFromFmu();
+
+    //Get interpolated forces
+    getForcesFromTlm(tcur);
+
+    //Write forces to FMU
+    for(size_t k=0; k<tlmBatch.index3D.size(); ++k) {
+        size_t j = tlmBatch.index3D[k];
+        double* force = &tlmBatch.force3D[6*k];
+        for(size_t i=0; i<6; ++i) {
+          force[i] = -force[i];
         }
-        else if(fmiConfig.dimensions[j] == 1 &&
-                fmiConfig.causalities[j] == "Input" ) {
+
+        fmistatus = fmi2_import_set_real(fmu,fmiConfig.force_vr[j],6,force);
+    }
+    for(size_t k=0; k<tlmBatch.index1D.size(); ++k) {
+        size_t j = tlmBatch.index1D[k];
+        double force = tlmBatch.force1D[k];
+        if(fmiConfig.domains[j] != "Hydraulic") {
+            force = -force;
+        }
+
+        fmistatus = fmi2_import_set_real(fmu,fmiConfig.force_vr[j],1,&force);
+    }
+
+    //Write input values to FMU
+    for(size_t j=0; j<fmiConfig.nInterfaces; ++j) {
+        if(fmiConfig.dimensions[j] == 1 &&
+           fmiConfig.causalities[j] == "Input" ) {
             double value;
 
             plugin->GetValueSignal(fmiConfig.interfaceIds[j], tcur, &value);
 
-            //Write value from FMU
             fmistatus = fmi2_import_set_real(fmu,fmiConfig.value_vr[j],1,&value);
         }
     }
@@ -509,55 +604,10 @@ int simulate_fmi2_cs()
 
     fmi2_real_t hsub = tlmConfig.hmax/fmiConfig.nSubSteps;
     for(size_t i=0; i<fmiConfig.nSubSteps; ++i) {
-      for(size_t j=0; j<fmiConfig.nInterfaces; ++j) {
-          if(fmiConfig.dimensions[j] == 6 &&
-             fmiConfig.causalities[j] == "Bidirectional") {
-              double position[3],orientation[9],speed[3],ang_speed[3],force[6];
-
-              //Read position and speed from FMU
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],3,position);
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.orientation_vr[j],9,orientation);
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],3,speed);
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.ang_speed_vr[j],3,ang_speed);
-
-              //Get interpolated force
-              plugin->GetForce3D(fmiConfig.interfaceIds[j], tcur, position,orientation,speed,ang_speed,force);
-
-              for(size_t k=0; k<6; ++k) {
-                force[k] = -force[k];
-              }
-
-              //Write force to FMU
-              fmistatus = fmi2_import_set_real(fmu,fmiConfig.force_vr[j],6,force);
-          }
-          else if(fmiConfig.dimensions[j] == 1 &&
-                  fmiConfig.causalities[j] == "Bidirectional") {
-            double position,speed,force;
+      TLMTraceScope trace(TLM_TRACE_SOLVER_STEP, -1, tcur+hsub);
 
-            //Read position and speed from FMU
-            fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],1,&position);
-            fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],1,&speed);
-
-            //Get interpolated force
-            plugin->GetForce1D(fmiConfig.interfaceIds[j], tcur, speed,&force);
-
-            if(fmiConfig.domains[j] != "Hydraulic") {
-                force = -force;
-            }
-
-            //Write force to FMU
-            fmistatus = fmi2_import_set_real(fmu,fmiConfig.force_vr[j],1,&force);
-          }
-          else if(fmiConfig.dimensions[j] == 1 &&
-                  fmiConfig.causalities[j] == "Input") {
-              double value;
-
-              //Get value
-              plugin->GetValueSignal(fmiConfig.interfaceIds[j], tcur, &value);
-
-              fmistatus = fmi2_import_set_real(fmu,fmiConfig.value_vr[j],1,&value);
-          }
-      }
+      //Write interpolated forces and input values to FMU
+      forceFromTlmToFmu(tcur);
 
       //Take one sub step
       TLMErrorLog::Info("Taking step!");
@@ -566,48 +616,15 @@ int simulate_fmi2_cs()
       //Increment time
       tcur+=hsub;
 
-      for(size_t j=0; j<fmiConfig.nInterfaces; ++j) {
-          if(fmiConfig.dimensions[j] == 6 &&
-             fmiConfig.causalities[j] == "Bidirectional") {
-              double force[6], position[3],orientation[9],speed[3],ang_speed[3];
-
-              //Read position and speed from FMU
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],3,position);
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.orientation_vr[j],9,orientation);
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],3,speed);
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.ang_speed_vr[j],3,ang_speed);
-
-              //Get interpolated force
-              plugin->GetForce3D(fmiConfig.interfaceIds[j], tcur, position,orientation,speed,ang_speed,force);
-
-              //Write back motion for sub step
-              plugin->SetMotion3D(fmiConfig.interfaceIds[j], tcur, position, orientation, speed, ang_speed);
-          }
-          else if(fmiConfig.dimensions[j] == 1 &&
-                  fmiConfig.causalities[j] == "Bidirectional") {
-              double force, position, speed;
-
-              //Read position and speed from FMU
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],1,&position);
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],1,&speed);
-
-              //Get interpolated force
-              plugin->GetForce1D(fmiConfig.interfaceIds[j], tcur, speed,&force);
+      //Read position and speed from FMU
+      readMotionFromFmu();
 
-              //Write back motion for sub step
-              plugin->SetMotion1D(fmiConfig.interfaceIds[j], tcur, position, speed);
-          }
-          else if(fmiConfig.dimensions[j] == 1 &&
-                  fmiConfig.causalities[j] == "Output") {
-              double value;
-
-              //Read value from FMU
-              fmistatus = fmi2_import_get_real(fmu,fmiConfig.value_vr[j],1,&value);
+      //Get interpolated forces
+      getForcesFromTlm(tcur);
 
-              //Write back value for sub step
-              plugin->SetValueSignal(fmiConfig.interfaceIds[j], tcur, value);
-          }
-      }
+      //Write back motion and output values for sub step
+      setMotionsToTlm(tcur);
+      valuesFromFmuToTlm(tcur);
     }
   }
 
@@ -636,36 +653,9 @@ void do_event_iteration(fmi2_import_t *fmu, fmi2_event_info_t *eventInfo)
 //Read motion from FMU and write it to TLMPlugin
 void motionFromFmuToTlm(double tcur)
 {
-  for(size_t j=0; j<fmiConfig.nInterfaces; ++j) {
-    if(fmiConfig.dimensions[j] == 6 &&
-       fmiConfig.causalities[j] == "Bidirectional") {
-      double position[3],orientation[9],speed[3],ang_speed[3];
-
-      fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],3,position);
-      fmistatus = fmi2_import_get_real(fmu,fmiConfig.orientation_vr[j],9,orientation);
-      fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],3,speed);
-      fmistatus = fmi2_import_get_real(fmu,fmiConfig.ang_speed_vr[j],3,ang_speed);
-
-       plugin->SetMotion3D(fmiConfig.interfaceIds[j], tcur, position, orientation, speed, ang_speed);
-    }
-    else if(fmiConfig.dimensions[j] == 1 &&
-            fmiConfig.causalities[j] == "Bidirectional") {
-      double position,speed;
-
-      fmistatus = fmi2_import_get_real(fmu,fmiConfig.position_vr[j],1,&position);
-      fmistatus = fmi2_import_get_real(fmu,fmiConfig.speed_vr[j],1,&speed);
-
-      plugin->SetMotion1D(fmiConfig.interfaceIds[j], tcur, position, speed);
-    }
-    else if(fmiConfig.dimensions[j] == 1 &&
-            fmiConfig.causalities[j] == "Output") {
-        double value;
-
-        fmistatus = fmi2_import_get_real(fmu,fmiConfig.value_vr[j],1,&value);
-
-        plugin->SetValueSignal(fmiConfig.interfaceIds[j], tcur, value);
-    }
-  }
+  readMotionFromFmu();
+  setMotionsToTlm(tcur);
+  valuesFromFmuToTlm(tcur);
 }
 
 
@@ -950,6 +940,8 @@ int simulate_fmi2_me()
       hcur = tcur - tlast;
     }
 
+    TLMTraceScope trace(TLM_TRACE_SOLVER_STEP, -1, tcur);
+
     // Write interpolated force to FMU
     forceFromTlmToFmu(tlast);
 
@@ -1470,7 +1462,8 @@ int main(int argc, char* argv[])
       exit(1);
     }
 
-  // Register TLM interfaces
+  // Interfaces and parameters are registered together below
+  std::vector<TLMInterfaceSpec> interfaceSpecs;
   for(size_t i=0; i<fmiConfig.interfaceNames.size(); ++i) {
     std::stringstream ss;
     ss << "Registers interface " <<
@@ -1478,10 +1471,10 @@ int main(int argc, char* argv[])
           " of type " <<
           fmiConfig.dimensions[i];
     TLMErrorLog::Info(ss.str());
-    fmiConfig.interfaceIds[i] = plugin->RegisteTLMInterface(fmiConfig.interfaceNames[i],
-                                                            fmiConfig.dimensions[i],
-                                                            fmiConfig.causalities[i],
-                                                            fmiConfig.domains[i]);
+    interfaceSpecs.push_back(TLMInterfaceSpec(fmiConfig.interfaceNames[i],
+                                              fmiConfig.dimensions[i],
+                                              fmiConfig.causalities[i],
+                                              fmiConfig.domains[i]));
   }
 
 
@@ -1490,6 +1483,8 @@ int main(int argc, char* argv[])
   fmi2_fmu_kind_enu_t kind = fmi2_import_get_fmu_kind(fmu);
 
   TLMErrorLog::Info("Registering component parameters...");
+  std::vector<TLMParameterSpec> parameterSpecs;
+  std::vector<fmi2_value_reference_t> parameterRefs;
   fmi2_import_variable_list_t *list = fmi2_import_get_variable_list(fmu,0);
   size_t nVar = fmi2_import_get_variable_list_size(list);
   for(size_t i=0; i<nVar; ++i) {
@@ -1528,14 +1523,23 @@ int main(int argc, char* argv[])
             value = value_str;
         }
 
-        int parId = plugin->RegisterComponentParameter(name,value);
-
-        plugin->GetParameterValue(parId, name, value);
-        TLMErrorLog::Info("Received value: "+value+" for parameter "+name);
-        fmi2_value_reference_t vr = fmi2_import_get_variable_vr(var);
-        parameterMap.insert(std::pair<fmi2_value_reference_t,std::string>(vr,value));
+        parameterSpecs.push_back(TLMParameterSpec(name,value));
+        parameterRefs.push_back(fmi2_import_get_variable_vr(var));
       }
   }
+
+  // One request to the manager for all the interfaces and parameters
+  std::vector<int> parameterIds;
+  plugin->RegisterTLMInterfaces(interfaceSpecs, parameterSpecs, fmiConfig.interfaceIds, parameterIds);
+  initializeBatches();
+
+  for(size_t i=0; i<parameterIds.size(); ++i) {
+      std::string name = parameterSpecs[i].Name;
+      std::string value = parameterSpecs[i].DefaultValue;
+      plugin->GetParameterValue(parameterIds[i], name, value);
+      TLMErrorLog::Info("Received value: "+value+" for parameter "+name);
+      parameterMap.insert(std::pair<fmi2_value_reference_t,std::string>(parameterRefs[i],value));
+  }
   TLMErrorLog::Info("Component parameters registered.");
 
   TLMErrorLog::Info("Initializing logging...");
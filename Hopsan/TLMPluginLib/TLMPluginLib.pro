@@ -49,8 +49,14 @@ SOURCES += \
     TLMPluginLib.cc \
     ../../common/Plugin/PluginImplementer.cc \
     ../../common/Communication/TLMClientComm.cc \
+    ../../common/Communication/TLMClientReceiver.cc \
+    ../../common/Communication/TLMClientSender.cc \
     ../../common/Communication/TLMCommUtil.cc \
+    ../../common/Communication/TLMShmTransport.cc \
     ../../common/Logging/TLMErrorLog.cc \
+    ../../common/Logging/TLMLogSink.cc \
+    ../../common/Logging/TLMStatistics.cc \
+    ../../common/Logging/TLMTrace.cc \
     ../../common/Interfaces/TLMInterface.cc \
     ../../common/Plugin/TLMPlugin.cc \
     ../../3rdParty/misc/src/Bstring.cc \
@@ -69,6 +75,8 @@ SOURCES += \
     ../../common/Interfaces/TLMInterfaceSignalOutput.cc \
     ../../common/Interfaces/TLMInterface1D.cc \
     ../../common/Interfaces/TLMInterface3D.cc \
+    ../../common/Interfaces/TLMInterpolation.cc \
+    ../../common/Interfaces/TLMFrameTransform.cc \
     ../../common/Parameters/ComponentParameter.cc
 
 HEADERS += \
@@ -11,6 +11,7 @@
 // TLMPlugin includes
 #include "Plugin/TLMPlugin.h"
 #include "Logging/TLMErrorLog.h"
+#include "Logging/TLMTrace.h"
 #include "common.h"
 
 std::ofstream DebugOutFile;
@@ -196,6 +197,8 @@ int main(int argc, char *argv[])
   std::cout << "Simulating...\n";
   double time = options.startTime;
   while(time < options.stopTime) {
+    TLMTraceScope trace(TLM_TRACE_SOLVER_STEP, -1, time+options.stepSize);
+
     for(size_t i=0; i<options.interfaces.size(); ++i) {
       if(options.interfaces.at(i).causality == oms_causality_input) {
         double value;
@@ -1,4 +1,5 @@
 #include "Communication/ManagerCommHandler.h"
+#include "Logging/TLMTrace.h"
 #include "tostr.h"
 #include <iostream>
 #include <sstream>
@@ -25,11 +26,39 @@ using std::cerr;
 using std::endl;
 using std::multimap;
 
+//! Max. number of messages waiting in the inbox of an I/O worker.
+static const size_t TLM_WORKER_INBOX_SIZE = 1 << 12;
+
+TLMWorkerShard::TLMWorkerShard(ManagerCommHandler* handler, int index)
+    : Handler(handler),
+      Index(index),
+      Inbox(TLM_WORKER_INBOX_SIZE),
+      ClosedComponents(),
+      Finished(false) {
+}
+
+ManagerCommHandler::~ManagerCommHandler() {
+    for(std::vector<TLMWorkerShard*>::iterator it = Workers.begin(); it != Workers.end(); ++it) {
+        TLMMessage* msg;
+        while((msg = (*it)->Inbox.Get()) != NULL) {
+            delete msg;
+        }
+        delete *it;
+    }
+}
+
 // Run method executes all the protocols in the right order:
 // Startup, Check then Simulate
 void ManagerCommHandler::Run(CommunicationMode CommMode_In) {
     CommMode = CommMode_In;
 
+    for(size_t i = 0; i < TheModel.GetInterfacesNum(); i++) {
+        TLMInterfaceProxy& ifc = TheModel.GetTLMInterfaceProxy(i);
+        Statistics.Add(TheModel.GetTLMComponentProxy(ifc.GetComponentID()).GetName() + "." + ifc.GetName(),
+                       &ifc.GetStats());
+    }
+    Statistics.SetFile(TheModel.GetSimParams().GetStatisticsFile(), 1.0);
+
 #ifdef USE_THREADS
     pthread_attr_t attr;
     pthread_attr_init(&attr);
@@ -69,6 +98,9 @@ void ManagerCommHandler::HandleThreadException(const std::string &msg) {
 
     exceptionMsg += msg + "\n";
 
+    // Stop the I/O workers, if any.
+    Aborted = true;
+
     // Terminate message queue, this will unblock the writer thread if needed.
     MessageQueue.Terminate();
 
@@ -90,6 +122,11 @@ void ManagerCommHandler::RunStartupProtocol() {
     int numToRegister = TheModel.GetComponentsNum();
     // Number of components waiting for check model reply
     int numCheckModel = 0;
+    // Accepted connections that did not register their component yet
+    std::vector<int> PendingSockets;
+
+    DirectLinkAddress.assign(TheModel.GetComponentsNum(), string());
+    DirectLinked.assign(TheModel.GetInterfacesNum(), false);
 
     // Server socket is used to accept connections
     int acceptSocket = Comm.CreateServerSocket();
@@ -153,8 +190,28 @@ void ManagerCommHandler::RunStartupProtocol() {
 
                 comp.SetReadyToSim();
                 numCheckModel++;
+                ProcessCheckModelMessage(iSock, *message);
                 MessageQueue.ReleaseSlot(message);
             }
+            else if(message->Header.MessageType == TLMMessageTypeConst::TLM_REG_SHM) {
+                // The client accepted the shared memory offer, the reply still goes on the socket.
+                int slot = message->Header.TLMInterfaceID;
+                if(slot != iSock || !Comm.AttachSharedMemory(hdl, slot)) {
+                    slot = -1;
+                }
+                TLMErrorLog::Info(string("Component ") + comp.GetName() +
+                                  (slot < 0 ? " refused" : " uses") + " shared memory transport");
+
+                Comm.AddActiveSocket(hdl);
+                message->Header.TLMInterfaceID = slot;
+                message->Header.DataSize = 0;
+                MessageQueue.PutWriteSlot(message);
+            }
+            else if(message->Header.MessageType == TLMMessageTypeConst::TLM_REG_BATCH) {
+                Comm.AddActiveSocket(hdl);
+                ProcessRegBatchMessage(iSock, *message);
+                MessageQueue.PutWriteSlot(message);
+            }
             else if(message->Header.MessageType == TLMMessageTypeConst::TLM_REG_PARAMETER) {
                 TLMErrorLog::Info(string("Component ") + comp.GetName() + " registers parameter");
 
@@ -171,15 +228,16 @@ void ManagerCommHandler::RunStartupProtocol() {
             }
         }
 
-        // Check if a new connection is waiting to be accepted.
-        if((numToRegister > 0) && Comm.HasData(acceptSocket)) {
-            int hdl = Comm.AcceptComponentConnections();
-            // WARNING!!! This is potentially a problematic case
-            // since I immediately try to receive a message from just accepted connection
-            // and might block in 'read' while other clients wait.
-            // Alternatively I could put the sockets that are not associated
-            // with any component to a separate place and "select" on them once more.
-            // Might be necessary to fix later.
+        // Accepted connections register their component with the first message.
+        // They are selected on like the components, so a slow client does not
+        // block the registration of the others.
+        for(size_t iPend = PendingSockets.size(); iPend-- > 0; ) {
+            int hdl = PendingSockets[iPend];
+            if(!Comm.HasData(hdl)) {
+                Comm.AddActiveSocket(hdl);
+                continue;
+            }
+            PendingSockets.erase(PendingSockets.begin() + iPend);
 
             TLMMessage* message = MessageQueue.GetReadSlot();
             message->SocketHandle = hdl;
@@ -199,10 +257,21 @@ void ManagerCommHandler::RunStartupProtocol() {
             Comm.AddActiveSocket(hdl);
         }
 
-        if(numToRegister)  // still more connections expected
+        // Check if a new connection is waiting to be accepted.
+        if((numToRegister > (int)PendingSockets.size()) && Comm.HasData(acceptSocket)) {
+            int hdl = Comm.AcceptComponentConnections();
+            PendingSockets.push_back(hdl);
+            Comm.AddActiveSocket(hdl);
+        }
+
+        if(numToRegister > (int)PendingSockets.size())  // still more connections expected
             Comm.AddActiveSocket(acceptSocket);
         
     }
+
+    // All the clients have mapped the shared memory or refused it,
+    // the names are not needed any more.
+    Comm.UnlinkSharedMemory();
 }
 
 // ProcessRegComponentMessage processes the first message after "accept"
@@ -227,15 +296,81 @@ void ManagerCommHandler::ProcessRegComponentMessage(TLMMessage& mess) {
     TLMComponentProxy& comp = TheModel.GetTLMComponentProxy(CompID);
 
     comp.SetSocketHandle(mess.SocketHandle);
-
-    mess.Header.DataSize = 0;
+    Comm.SetSocketComponent(mess.SocketHandle, CompID);
+
+    // Offer the shared memory transport, the client answers with TLM_REG_SHM
+    // if it can use it. Older clients ignore the reply data.
+    string offer = Comm.GetSharedMemoryOffer(CompID);
+    mess.Header.DataSize = offer.size();
+    mess.Data.resize(offer.size());
+    if(!offer.empty()) {
+        memcpy(&mess.Data[0], offer.c_str(), offer.size());
+    }
 
     mess.Header.TLMInterfaceID = CompID;
+
+    // Tell the client that it can send its registrations in one TLM_REG_BATCH.
+    // Older managers return the client's header field unchanged.
+    TLMCommUtil::SetEncoding(mess.Header, TLMWireEncodingConst::TLM_ENC_REG_BATCH);
     
     TLMErrorLog::Info(string("Component ") + aName + " is connected");
 
 }
 
+// ProcessCheckModelMessage stores the port where the client accepts direct links.
+// Older clients and clients without direct link support send no data.
+void ManagerCommHandler::ProcessCheckModelMessage(int compID, TLMMessage& mess) {
+    if(!TheModel.GetSimParams().GetDirectLinks() || CommMode != CoSimulationMode
+       || mess.Header.DataSize <= 0) {
+        return;
+    }
+
+    string portStr((const char*)(& mess.Data[0]), mess.Header.DataSize);
+    int port = std::atoi(portStr.c_str());
+    string host = Comm.GetPeerHost(mess.SocketHandle);
+    if(port <= 0 || host.empty()) return;
+
+    DirectLinkAddress[compID] = host + ":" + ToStr(port);
+
+    TLMErrorLog::Info(string("Component ") + TheModel.GetTLMComponentProxy(compID).GetName()
+                      + " accepts direct links on " + DirectLinkAddress[compID]);
+}
+
+// SetupDirectLinkMessage lists the connections of the component where both
+// ends accept direct links. The table is sent as TLM_CHECK_MODEL reply data.
+void ManagerCommHandler::SetupDirectLinkMessage(int compID, TLMMessage& mess) {
+    mess.Header.DataSize = 0;
+    if(DirectLinkAddress[compID].empty()) return;
+
+    bool mirror = TheModel.GetSimParams().GetMonitorPort() > 0;
+
+    std::ostringstream table;
+    for(size_t i = 0; i < TheModel.GetInterfacesNum(); i++) {
+        TLMInterfaceProxy& src = TheModel.GetTLMInterfaceProxy(i);
+        if(src.GetComponentID() != compID) continue;
+
+        int destID = src.GetLinkedID();
+        if(destID < 0) continue;
+
+        int peerID = TheModel.GetTLMInterfaceProxy(destID).GetComponentID();
+        if(peerID == compID || DirectLinkAddress[peerID].empty()) continue;
+
+        DirectLinked[i] = true;
+        table << i << ' ' << destID << ' ' << peerID << ' ' << DirectLinkAddress[peerID]
+              << ' ' << (mirror ? 1 : 0) << '\n';
+
+        TLMErrorLog::Info("Direct link from " + TheModel.GetTLMComponentProxy(compID).GetName() + '.' +
+                          src.GetName() + " to " + DirectLinkAddress[peerID]);
+    }
+
+    string tableStr = table.str();
+    mess.Header.DataSize = tableStr.size();
+    mess.Data.resize(tableStr.size());
+    if(!tableStr.empty()) {
+        memcpy(&mess.Data[0], tableStr.c_str(), tableStr.size());
+    }
+}
+
 // ProcessRegInterfaceMessage processes a TLMInterface registration message from a client.
 // It finds the appropriate proxy, sets its status to "connected"
 // and prepares a reply message with interface ID and connection parameters.
@@ -328,6 +463,7 @@ void ManagerCommHandler::ProcessRegInterfaceMessage(int compID, TLMMessage& mess
     }
 
     if(CommMode == CoSimulationMode) {
+        TheModel.GetTLMInterfaceProxy(IfcID).SetWireEncodings(TLMCommUtil::GetEncoding(mess.Header));
         SetupInterfaceConnectionMessage(IfcID, aName, mess);
     }
     else if(CommMode == InterfaceRequestMode) {
@@ -410,6 +546,35 @@ void ManagerCommHandler::ProcessRegParameterMessage(int compID, TLMMessage &mess
     memcpy(& mess.Data[0], &ValueBuf, mess.Header.DataSize);
 }
 
+// ProcessRegBatchMessage handles the interface and parameter registrations
+// that a client sends in one TLM_REG_BATCH message. The message is replaced
+// by a TLM_REG_BATCH with the replies in the order of the requests.
+void ManagerCommHandler::ProcessRegBatchMessage(int compID, TLMMessage& mess) {
+    TLMMessage batch;
+    batch.Header = mess.Header;
+    batch.SocketHandle = mess.SocketHandle;
+    batch.Data.swap(mess.Data);
+
+    TLMCommUtil::InitBundle(mess, TLMMessageTypeConst::TLM_REG_BATCH);
+
+    TLMMessage entry;
+    size_t offset = 0;
+    int count = 0;
+    while(TLMCommUtil::GetBundleEntry(batch, offset, entry)) {
+        if(entry.Header.MessageType == TLMMessageTypeConst::TLM_REG_PARAMETER) {
+            ProcessRegParameterMessage(compID, entry);
+        }
+        else {
+            ProcessRegInterfaceMessage(compID, entry);
+        }
+        TLMCommUtil::AddToBundle(mess, entry);
+        count++;
+    }
+
+    TLMErrorLog::Info(string("Component ") + TheModel.GetTLMComponentProxy(compID).GetName() +
+                      " registered " + TLMErrorLog::ToStdStr(count) + " interfaces and parameters");
+}
+
 void ManagerCommHandler::SetupInterfaceConnectionMessage(int IfcID, std::string& aName, TLMMessage& mess) {
     // set the connected flag in the CompositeModel
     TLMInterfaceProxy& ifc = TheModel.GetTLMInterfaceProxy(IfcID);
@@ -456,9 +621,42 @@ void ManagerCommHandler::SetupInterfaceConnectionMessage(int IfcID, std::string&
     //        param.Nom_cI_A_cX[6] = 0;       param.Nom_cI_A_cX[7] = 0;       param.Nom_cI_A_cX[8] = 1;
     //    }
 
-    mess.Header.DataSize = sizeof(TLMConnectionParams);
+    // The compact encoding is granted if the client understands it, clients
+    // without an encoding get the parameters without the Encoding field.
+    // The manager decodes the data again for receivers that do not understand it.
+    int clientEncodings = TLMCommUtil::GetEncoding(mess.Header);
+    TLMCommUtil::SetEncoding(mess.Header, 0);
+    int encoding = 0;
+    if(ifc.GetDimensions() == 6 && ifc.GetCausality() == "bidirectional") {
+        encoding = int(param.Encoding) & clientEncodings;
+    }
 
-    mess.Data.resize(sizeof(TLMConnectionParams));
+    // Time data of several interfaces may come and go in one bundle.
+    encoding |= clientEncodings & TLMWireEncodingConst::TLM_ENC_BUNDLE;
+
+    // Clients that understand the interpolation flags get the whole parameters.
+    encoding |= clientEncodings & TLMWireEncodingConst::TLM_ENC_INTERPOLATION;
+    if(int(param.Interpolation) != 0 && (encoding & TLMWireEncodingConst::TLM_ENC_INTERPOLATION) == 0) {
+        TLMErrorLog::Warning(string("Interface ") + aName + " does not support the interpolation of the connection, "
+                             "uses the default");
+    }
+
+    if(encoding != 0) {
+        TLMConnectionParams encParam = param;
+        encParam.Encoding = encoding;
+        size_t size = (encoding & TLMWireEncodingConst::TLM_ENC_INTERPOLATION) ? sizeof(TLMConnectionParams)
+                                                                              : TLM_CONNECTION_PARAMS_ENC_SIZE;
+        mess.Header.DataSize = size;
+        mess.Data.resize(size);
+        memcpy(& mess.Data[0], &encParam, mess.Header.DataSize);
+
+        TLMErrorLog::Info(string("Interface ") + aName + " uses wire encoding " + ToStr(encoding));
+        return;
+    }
+
+    mess.Header.DataSize = TLM_CONNECTION_PARAMS_BASE_SIZE;
+
+    mess.Data.resize(TLM_CONNECTION_PARAMS_BASE_SIZE);
 
     memcpy(& mess.Data[0], &param, mess.Header.DataSize);
 
@@ -469,8 +667,8 @@ void ManagerCommHandler::SetupInterfaceRequestMessage(TLMMessage& mess) {
     param.Delay = 0.1;
     param.mode = 1;
 
-    mess.Header.DataSize = sizeof(TLMConnectionParams);
-    mess.Data.resize(sizeof(TLMConnectionParams));
+    mess.Header.DataSize = TLM_CONNECTION_PARAMS_BASE_SIZE;
+    mess.Data.resize(TLM_CONNECTION_PARAMS_BASE_SIZE);
     memcpy(& mess.Data[0], &param, mess.Header.DataSize);
     
 }
@@ -486,6 +684,11 @@ void ManagerCommHandler::ReaderThreadRun() {
     // Check that startup completed correctly
     int StartupOK = TheModel.CheckProxyComm();
     
+    // With several I/O workers the data exchange starts outside of the
+    // writer thread, so the status must be sent before it.
+    int numWorkers = std::min(TheModel.GetSimParams().GetIOWorkers(), TheModel.GetComponentsNum());
+    bool sharded = (CommMode == CoSimulationMode) && (numWorkers > 1);
+
     // Send the status result to all components
     for(int iSock =  TheModel.GetComponentsNum() - 1; iSock >= 0; --iSock) {
         int hdl = TheModel.GetTLMComponentProxy(iSock).GetSocketHandle();
@@ -494,7 +697,16 @@ void ManagerCommHandler::ReaderThreadRun() {
         message->Header.MessageType = TLMMessageTypeConst::TLM_CHECK_MODEL;
         message->Header.DataSize = 0;
         message->Header.TLMInterfaceID = StartupOK;
-        MessageQueue.PutWriteSlot(message);
+        if(StartupOK) {
+            SetupDirectLinkMessage(iSock, *message);
+        }
+        if(sharded) {
+            TLMCommUtil::SendMessage(*message);
+            MessageQueue.ReleaseSlot(message);
+        }
+        else {
+            MessageQueue.PutWriteSlot(message);
+        }
     }
 
     if(!StartupOK) {
@@ -504,56 +716,87 @@ void ManagerCommHandler::ReaderThreadRun() {
 
     TLMErrorLog::Info("------------------  Starting time data exchange   ------------------");
     
-    Comm.SwitchToRunningMode();
+    if(sharded) {
+        sharded = Comm.SwitchToShardedMode(numWorkers);
+    }
+    else {
+        Comm.SwitchToRunningMode();
+    }
     runningMode = RunMode;
 
     int nClosedSock = 0;
     std::vector<int> closedSockets;
+    std::vector<bool> isClosed(TheModel.GetComponentsNum(), false);
+    std::vector<TLMReadySocket> readySockets;
+    std::vector<TLMMessage*> forward;
+    if(sharded) {
+        RunWorkers(closedSockets);
+        if(Aborted) return;
+
+        // The monitors are served by the monitor and writer threads,
+        // wait for them as the single reader loop below does.
+        while(DisconnectedMonitors.size() < MonitorSockets.size() && !Aborted) {
+#ifndef _MSC_VER
+            usleep(10000); // micro seconds
+#else
+            Sleep(10); // milli seconds
+#endif
+        }
+        nClosedSock = TheModel.GetComponentsNum();
+    }
     while(nClosedSock < TheModel.GetComponentsNum() || DisconnectedMonitors.size() < MonitorSockets.size()) {
-        Comm.SelectReadSocket(); // wait for a change
+        // wait for a change, only the sockets with data are returned
+        Comm.SelectReadySockets(readySockets);
 
-        for(int iSock =  TheModel.GetComponentsNum() - 1; iSock >= 0; --iSock) {
-            TLMComponentProxy& comp = TheModel.GetTLMComponentProxy(iSock);
-            int hdl = comp.GetSocketHandle();
+        for(std::vector<TLMReadySocket>::iterator it = readySockets.begin(); it != readySockets.end(); ++it) {
+            int iSock = it->ComponentIndex;
+            if(iSock < 0 || isClosed[iSock]) continue;
 
-            if((std::find(closedSockets.begin(), closedSockets.end(), iSock) == closedSockets.end())
-               && (hdl != 0) && Comm.HasData(hdl)) { // there is data to be received on the socket
-
-                TLMMessage* message = MessageQueue.GetReadSlot();
-                message->SocketHandle = hdl;
-                if(TLMCommUtil::ReceiveMessage(*message)) {
-                    if(message->Header.MessageType == TLMMessageTypeConst::TLM_CLOSE_REQUEST) {
-                        MessageQueue.ReleaseSlot(message);
-                        TLMErrorLog::Info("Received close permission request from "+comp.GetName());
-                        closedSockets.push_back(iSock);
-                        nClosedSock++;
-                    }
-                    else if(CommMode == CoSimulationMode) {
-                        MarshalMessage(*message);
+            TLMComponentProxy& comp = TheModel.GetTLMComponentProxy(iSock);
+            int hdl = it->Socket;
+            if(hdl == 0) continue;
 
-                        // Forward message for monitoring.
-                        ForwardToMonitor(*message);
+            // there is data to be received on the socket
+            TLMMessage* message = MessageQueue.GetReadSlot();
+            message->SocketHandle = hdl;
+            if(TLMCommUtil::ReceiveMessage(*message)) {
+                if(message->Header.MessageType == TLMMessageTypeConst::TLM_CLOSE_REQUEST) {
+                    MessageQueue.ReleaseSlot(message);
+                    TLMErrorLog::Info("Received close permission request from "+comp.GetName());
+                    closedSockets.push_back(iSock);
+                    isClosed[iSock] = true;
+                    nClosedSock++;
+                    continue;
+                }
+                else if(CommMode == CoSimulationMode) {
+                    ProcessTimeData(message, forward);
 
-                        // Place in send buffer
-                        MessageQueue.PutWriteSlot(message);
-                    }
-                    else {
-                        // CommMode == InterfaceRequestMode
-                        UnpackAndStoreTimeData(*message);
-                        MessageQueue.ReleaseSlot(message);
+                    // Place in send buffer
+                    for(std::vector<TLMMessage*>::iterator out = forward.begin(); out != forward.end(); ++out) {
+                        MessageQueue.PutWriteSlot(*out);
                     }
+                    forward.clear();
                 }
                 else {
-                    //Socket was closed without permission
-                    nClosedSock++;
+                    // CommMode == InterfaceRequestMode
+                    UnpackAndStoreTimeData(*message);
                     MessageQueue.ReleaseSlot(message);
                 }
+                Comm.ReadDone(*it);
+            }
+            else {
+                //Socket was closed without permission
+                isClosed[iSock] = true;
+                nClosedSock++;
+                MessageQueue.ReleaseSlot(message);
             }
         }
     }
 
     TLMErrorLog::Info("Simulation complete.");
 
+    Statistics.Close();
+
     for(int iSock : closedSockets) {
       TLMMessage message;
       TLMComponentProxy& comp = TheModel.GetTLMComponentProxy(iSock);
@@ -584,22 +827,304 @@ void ManagerCommHandler::ReaderThreadRun() {
     Comm.CloseAll();
 }
 
+//! Order messages by destination socket, used with stable_sort so that
+//! the messages to one socket keep their order.
+static bool LessSocketHandle(const TLMMessage* a, const TLMMessage* b) {
+    return a->SocketHandle < b->SocketHandle;
+}
+
 void ManagerCommHandler::WriterThreadRun() {
 
+    // Max. number of messages taken from the queue at once
+    const size_t maxBatch = 256;
+
     TLMMessage* tlm_mess = 0;
+    std::vector<TLMMessage*> batch;
+    batch.reserve(maxBatch);
     TLMErrorLog::Info(string("TLM manager is ready to send messages"));
 
     while((tlm_mess = MessageQueue.GetWriteSlot()) != NULL) {
-        TLMCommUtil::SendMessage(*tlm_mess);
-        //TLMMessage &mm = *tlm_mess;
-        //TLMCommUtil::SendMessage(mm);
-        MessageQueue.ReleaseSlot(tlm_mess);
+        // Take whatever else is waiting and send it grouped by socket,
+        // one system call per destination.
+        batch.clear();
+        batch.push_back(tlm_mess);
+        while(batch.size() < maxBatch && (tlm_mess = MessageQueue.TryGetWriteSlot()) != NULL) {
+            batch.push_back(tlm_mess);
+        }
+
+        SendGrouped(batch);
     }
     
 }
 
 
+void ManagerCommHandler::SendGrouped(std::vector<TLMMessage*>& batch) {
+    if(batch.size() > 1) {
+        std::stable_sort(batch.begin(), batch.end(), LessSocketHandle);
+    }
+
+    for(size_t first = 0; first < batch.size(); ) {
+        size_t last = first + 1;
+        while(last < batch.size() && batch[last]->SocketHandle == batch[first]->SocketHandle) {
+            last++;
+        }
+        TLMCommUtil::SendMessages(&batch[first], last - first);
+        first = last;
+    }
+
+    for(size_t i = 0; i < batch.size(); i++) {
+        MessageQueue.ReleaseSlot(batch[i]);
+    }
+    batch.clear();
+}
+
+// RunWorkers starts one I/O worker per socket shard. Each worker does for its
+// components what the reader and writer threads do for all of them in the
+// normal mode. Messages to the monitors still go through the writer thread.
+void ManagerCommHandler::RunWorkers(std::vector<int>& closedComponents) {
+    int numShards = Comm.GetNumShards();
+    for(int i = 0; i < numShards; i++) {
+        Workers.push_back(new TLMWorkerShard(this, i));
+    }
+
+    TLMErrorLog::Info("Starting " + TLMErrorLog::ToStdStr(numShards) + " I/O workers");
+
+#ifdef USE_THREADS
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setscope(&attr,  PTHREAD_SCOPE_SYSTEM);
+    std::vector<pthread_t> threads(numShards);
+    for(int i = 0; i < numShards; i++) {
+        pthread_create(&threads[i], &attr, thread_WorkerThreadRun, (void*)Workers[i]);
+    }
+    for(int i = 0; i < numShards; i++) {
+        pthread_join(threads[i], NULL);
+    }
+#endif
+
+    for(int i = 0; i < numShards; i++) {
+        TLMWorkerShard& shard = *Workers[i];
+        closedComponents.insert(closedComponents.end(), shard.ClosedComponents.begin(), shard.ClosedComponents.end());
+
+        // Data for components that were already done, the writer sends
+        // it as in the normal mode.
+        TLMMessage* message;
+        while((message = shard.Inbox.Get()) != NULL) {
+            MessageQueue.PutWriteSlot(message);
+        }
+    }
+}
+
+void ManagerCommHandler::WorkerThreadRun(TLMWorkerShard& shard) {
+    int numShards = Comm.GetNumShards();
+    int nOpen = 0;
+    for(int iSock = shard.Index; iSock < TheModel.GetComponentsNum(); iSock += numShards) {
+        nOpen++;
+    }
+
+    std::vector<char> isClosed(TheModel.GetComponentsNum(), 0);
+    std::vector<TLMReadySocket> readySockets;
+    std::vector<TLMMessage*> outgoing;
+    std::vector<TLMMessage*> forward;
+    while(nOpen > 0 && !Aborted) {
+        // Announce the wait before looking at the inbox, see TLMManagerComm::WakeShard.
+        Comm.PrepareWait(shard.Index);
+        Comm.SelectReadySockets(shard.Index, readySockets, !shard.Inbox.Empty());
+
+        for(std::vector<TLMReadySocket>::iterator it = readySockets.begin(); it != readySockets.end(); ++it) {
+            int iSock = it->ComponentIndex;
+            if(iSock < 0 || isClosed[iSock]) continue;
+
+            TLMComponentProxy& comp = TheModel.GetTLMComponentProxy(iSock);
+
+            TLMMessage* message = MessageQueue.GetReadSlot();
+            message->SocketHandle = it->Socket;
+            if(!TLMCommUtil::ReceiveMessage(*message)) {
+                //Socket was closed without permission
+                isClosed[iSock] = 1;
+                nOpen--;
+                MessageQueue.ReleaseSlot(message);
+                continue;
+            }
+
+            if(message->Header.MessageType == TLMMessageTypeConst::TLM_CLOSE_REQUEST) {
+                MessageQueue.ReleaseSlot(message);
+                TLMErrorLog::Info("Received close permission request from "+comp.GetName());
+                shard.ClosedComponents.push_back(iSock);
+                isClosed[iSock] = 1;
+                nOpen--;
+                continue;
+            }
+            else {
+                ProcessTimeData(message, forward);
+                for(std::vector<TLMMessage*>::iterator out = forward.begin(); out != forward.end(); ++out) {
+                    RouteMessage(shard, *out, outgoing);
+                }
+                forward.clear();
+            }
+            Comm.ReadDone(shard.Index, *it);
+        }
+
+        // Send what we got from the other workers together with our own messages.
+        TLMMessage* message;
+        while((message = shard.Inbox.Get()) != NULL) {
+            outgoing.push_back(message);
+        }
+        SendGrouped(outgoing);
+    }
+
+    // The other workers might still have data for our components, it goes
+    // through the writer thread from now on.
+    shard.Finished.store(true);
+    TLMMessage* message;
+    while((message = shard.Inbox.Get()) != NULL) {
+        MessageQueue.PutWriteSlot(message);
+    }
+}
+
+void ManagerCommHandler::RouteMessage(TLMWorkerShard& shard, TLMMessage* message, std::vector<TLMMessage*>& outgoing) {
+    int dest = Comm.GetSocketShard(message->SocketHandle);
+    if(dest < 0) {
+        // Unconnected interface, see MarshalMessage.
+        MessageQueue.ReleaseSlot(message);
+        return;
+    }
+
+    if(dest == shard.Index) {
+        outgoing.push_back(message);
+        return;
+    }
+
+    TLMWorkerShard& destShard = *Workers[dest];
+    for(;;) {
+        if(destShard.Finished.load()) {
+            // All the components of the other worker are done, send as in the normal mode.
+            // What it left in its inbox is sent after the join, see RunWorkers.
+            MessageQueue.PutWriteSlot(message);
+            return;
+        }
+        if(destShard.Inbox.Put(message)) break;
+
+        // The other worker is behind. Keep serving our inbox meanwhile
+        // since it might be waiting for room in it.
+        Comm.WakeShard(dest);
+        TLMMessage* own;
+        while((own = shard.Inbox.Get()) != NULL) {
+            outgoing.push_back(own);
+        }
+        SendGrouped(outgoing);
+        if(Aborted) {
+            MessageQueue.ReleaseSlot(message);
+            return;
+        }
+        YieldThread();
+    }
+    Comm.WakeShard(dest);
+}
+
+void ManagerCommHandler::ProcessTimeData(TLMMessage* message, std::vector<TLMMessage*>& out) {
+    if(message->Header.MessageType != TLMMessageTypeConst::TLM_TIME_DATA_BUNDLE) {
+        ForwardTimeData(message, out);
+        return;
+    }
+
+    // The messages of a bundle are forwarded as if they came one by one,
+    // then bundled again per destination.
+    std::vector<TLMMessage*> parts;
+    size_t offset = 0;
+    TLMMessage* part = MessageQueue.GetReadSlot();
+    while(TLMCommUtil::GetBundleEntry(*message, offset, *part)) {
+        ForwardTimeData(part, parts);
+        part = MessageQueue.GetReadSlot();
+    }
+    MessageQueue.ReleaseSlot(part);
+    MessageQueue.ReleaseSlot(message);
+
+    TLM_LOG_INFO("Received a bundle of " + ToStr(int(parts.size())) + " time data messages");
+
+    BundleMessages(parts, out);
+}
+
+void ManagerCommHandler::ForwardTimeData(TLMMessage* message, std::vector<TLMMessage*>& out) {
+    const uint64_t start = TLMStatistics::Now();
+
+    int ifcID = message->Header.TLMInterfaceID;
+    TLMTraceScope trace(TLM_TRACE_FORWARD, ifcID, TLMTrace::NoTime());
+    if(message->Header.MessageType == TLMMessageTypeConst::TLM_TIME_DATA
+       && ifcID >= 0 && ifcID < (int)DirectLinked.size() && DirectLinked[ifcID]) {
+        // The data went directly to the linked component, this is the copy for monitoring.
+        TLMInterfaceProxy& src = TheModel.GetTLMInterfaceProxy(ifcID);
+        src.GetStats().MessagesReceived.Add(1);
+        src.GetStats().BytesReceived.Add(message->Header.DataSize);
+
+        message->Header.TLMInterfaceID = src.GetLinkedID();
+        ForwardToMonitor(*message);
+        MessageQueue.ReleaseSlot(message);
+        return;
+    }
+
+    TLMInterfaceStats& stats = TheModel.GetTLMInterfaceProxy(ifcID).GetStats();
+    stats.MessagesReceived.Add(1);
+    stats.BytesReceived.Add(message->Header.DataSize);
+
+    MarshalMessage(*message);
+
+    // Forward message for monitoring.
+    ForwardToMonitor(*message);
+
+    if(message->SocketHandle >= 0) {
+        stats.MessagesSent.Add(1);
+        stats.BytesSent.Add(message->Header.DataSize);
+    }
+
+    out.push_back(message);
+
+    stats.Send.Add(TLMStatistics::Now() - start);
+}
+
+bool ManagerCommHandler::AcceptsBundles(const TLMMessage& message) {
+    return message.SocketHandle >= 0 && message.Header.TLMInterfaceID >= 0
+            && (TheModel.GetTLMInterfaceProxy(message.Header.TLMInterfaceID).GetWireEncodings()
+                & TLMWireEncodingConst::TLM_ENC_BUNDLE) != 0;
+}
+
+void ManagerCommHandler::BundleMessages(std::vector<TLMMessage*>& parts, std::vector<TLMMessage*>& out) {
+    for(size_t i = 0; i < parts.size(); i++) {
+        TLMMessage* first = parts[i];
+        if(first == NULL) continue;
+        if(!AcceptsBundles(*first)) {
+            out.push_back(first);
+            continue;
+        }
+
+        // Add the later messages for the same component
+        TLMMessage* bundle = NULL;
+        for(size_t j = i + 1; j < parts.size(); j++) {
+            TLMMessage* next = parts[j];
+            if(next == NULL || next->SocketHandle != first->SocketHandle || !AcceptsBundles(*next)) continue;
+            if(bundle == NULL) {
+                bundle = MessageQueue.GetReadSlot();
+                TLMCommUtil::InitBundle(*bundle);
+                bundle->SocketHandle = first->SocketHandle;
+                TLMCommUtil::AddToBundle(*bundle, *first);
+            }
+            TLMCommUtil::AddToBundle(*bundle, *next);
+            MessageQueue.ReleaseSlot(next);
+            parts[j] = NULL;
+        }
+
+        if(bundle != NULL) {
+            MessageQueue.ReleaseSlot(first);
+            out.push_back(bundle);
+        }
+        else {
+            out.push_back(first);
+        }
+    }
+}
+
 void ManagerCommHandler::MarshalMessage(TLMMessage& message) {
+  TLMTraceScope trace(TLM_TRACE_MARSHAL, message.Header.TLMInterfaceID, TLMTrace::NoTime());
 
   TLMInterfaceProxy& src = TheModel.GetTLMInterfaceProxy(message.Header.TLMInterfaceID);
 
@@ -625,12 +1150,35 @@ void ManagerCommHandler::MarshalMessage(TLMMessage& message) {
         message.SocketHandle = destComp.GetSocketHandle();
         message.Header.TLMInterfaceID = destID;
 
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info(string("Forwarding from " +
-                                    TheModel.GetTLMComponentProxy(src.GetComponentID()).GetName() + '.'+
-                                    src.GetName()
-                                    + " to " + destComp.GetName() + '.' + dest.GetName()));
+        // The data is forwarded as is unless the receiver can't decode it.
+        int encoding = TLMCommUtil::GetEncoding(message.Header);
+        if(encoding != 0 && dest.GetDimensions() == 6 && (dest.GetWireEncodings() & encoding) != encoding) {
+            DecodeTimeData(message);
         }
+
+        TLM_LOG_INFO(string("Forwarding from " +
+                           TheModel.GetTLMComponentProxy(src.GetComponentID()).GetName() + '.'+
+                           src.GetName()
+                           + " to " + destComp.GetName() + '.' + dest.GetName()));
+    }
+}
+
+void ManagerCommHandler::DecodeTimeData(TLMMessage& message) {
+    std::vector<TLMTimeData3D> data;
+    bool switch_byte_order =
+            (TLMMessageHeader::IsBigEndianSystem != message.Header.SourceIsBigEndianSystem);
+    if(!TLMCommUtil::DecodeTimeData3D(message.Header.DataSize > 0 ? &message.Data[0] : NULL, message.Header.DataSize,
+                                      TLMCommUtil::GetEncoding(message.Header), switch_byte_order, data)) {
+        TLMErrorLog::FatalError("Wrong size of encoded 3D time data: DataSize " + ToStr(message.Header.DataSize));
+        return;
+    }
+
+    message.Header.SourceIsBigEndianSystem = TLMMessageHeader::IsBigEndianSystem;
+    TLMCommUtil::SetEncoding(message.Header, 0);
+    message.Header.DataSize = data.size() * sizeof(TLMTimeData3D);
+    message.Data.resize(message.Header.DataSize);
+    if(!data.empty()) {
+        memcpy(&message.Data[0], &data[0], message.Header.DataSize);
     }
 }
 
@@ -643,6 +1191,8 @@ void ManagerCommHandler::UnpackAndStoreTimeData(TLMMessage& message) {
     }
 
     TLMInterfaceProxy& ip = TheModel.GetTLMInterfaceProxy(message.Header.TLMInterfaceID);
+    ip.GetStats().MessagesReceived.Add(1);
+    ip.GetStats().BytesReceived.Add(message.Header.DataSize);
 
     if(ip.GetDimensions() == 6 && ip.GetCausality() == "bidirectional") {
         // since mess.Data is continious we can just convert the pointer
@@ -658,7 +1208,7 @@ void ManagerCommHandler::UnpackAndStoreTimeData(TLMMessage& message) {
         // forward the time data
         TLMTimeData3D& data = ip.getTime0Data3D();
 
-        TLMErrorLog::Info("Unpack and store 3D time data for " + ip.GetName());
+        TLM_LOG_INFO("Unpack and store 3D time data for " + ip.GetName());
         data = *Next;
     }
     else if(ip.GetDimensions() == 1 && ip.GetCausality() == "bidirectional") {
@@ -675,7 +1225,7 @@ void ManagerCommHandler::UnpackAndStoreTimeData(TLMMessage& message) {
         // forward the time data
         TLMTimeData3D& data = ip.getTime0Data3D();
 
-        TLMErrorLog::Info("Unpack and store 1D time data for " + ip.GetName());
+        TLM_LOG_INFO("Unpack and store 1D time data for " + ip.GetName());
 
         data.Position[0] = Next->Position; data.Position[1] = 0;   data.Position[2] = 0;
 
@@ -700,7 +1250,7 @@ void ManagerCommHandler::UnpackAndStoreTimeData(TLMMessage& message) {
         // forward the time data
         TLMTimeData3D& data = ip.getTime0Data3D();
 
-        TLMErrorLog::Info("Unpack and store signal time data for " + ip.GetName());
+        TLM_LOG_INFO("Unpack and store signal time data for " + ip.GetName());
 
         data.Position[0] = 1;   data.Position[1] = 0;   data.Position[2] = 0;
 
@@ -773,28 +1323,30 @@ void ManagerCommHandler::ForwardToMonitor(TLMMessage& message) {
     if(MonitorsDisconnected)
         return;
 
-    monitorMapLock.lock();
+    // Lock free snapshot of the subscriptions, replaced as a whole on updates.
+    std::shared_ptr<const multimap<int,int> > subscriptions = std::atomic_load(&monitorInterfaceMap);
 
     // We forward to the sender!
     TLMInterfaceProxy& ifc = TheModel.GetTLMInterfaceProxy(message.Header.TLMInterfaceID);
     int TLMInterfaceID = ifc.GetLinkedID();
     
-    if(monitorInterfaceMap.count(TLMInterfaceID) > 0) {
+    if(subscriptions && subscriptions->count(TLMInterfaceID) > 0) {
 
         if(message.Header.MessageType != TLMMessageTypeConst::TLM_TIME_DATA) {
             TLMErrorLog::FatalError("Unexpected message received in forward to monitor");
         }
 
+        // The payload is shared by the message and all its copies to the monitors.
+        message.SharePayload();
+
         // Forward to all connected monitoring ports
-        multimap<int,int>::iterator pos;
-        for(pos = monitorInterfaceMap.lower_bound(TLMInterfaceID);
-             pos != monitorInterfaceMap.upper_bound(TLMInterfaceID);
+        multimap<int,int>::const_iterator pos;
+        for(pos = subscriptions->lower_bound(TLMInterfaceID);
+             pos != subscriptions->upper_bound(TLMInterfaceID);
              pos++) {
             
-            if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-                TLMErrorLog::Info("Forwarding to monitor, interface " + TLMErrorLog::ToStdStr(TLMInterfaceID)
-                                  + " on socket " + TLMErrorLog::ToStdStr(pos->second));
-            }
+            TLM_LOG_INFO("Forwarding to monitor, interface " + TLMErrorLog::ToStdStr(TLMInterfaceID)
+                         + " on socket " + TLMErrorLog::ToStdStr(pos->second));
             
             int hdl = pos->second;
             
@@ -803,22 +1355,23 @@ void ManagerCommHandler::ForwardToMonitor(TLMMessage& message) {
             newMessage->SocketHandle = hdl;
             memcpy(&newMessage->Header, &message.Header, sizeof(TLMMessageHeader));
             newMessage->Header.TLMInterfaceID = TLMInterfaceID;
-
-            newMessage->Header.DataSize = message.Header.DataSize;
-            if(newMessage->Data.size() < newMessage->Header.DataSize) {
-                newMessage->Data.resize(newMessage->Header.DataSize);
-            }
-            
-            memcpy(&newMessage->Data[0], &message.Data[0], newMessage->Header.DataSize);
+            newMessage->SharedData = message.SharedData;
 
             MessageQueue.PutWriteSlot(newMessage);
         }
     }
     else {
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info("Nothing to forward for monitor interface " + TLMErrorLog::ToStdStr(TLMInterfaceID));
-        }
+        TLM_LOG_INFO("Nothing to forward for monitor interface " + TLMErrorLog::ToStdStr(TLMInterfaceID));
     }
+}
+
+void ManagerCommHandler::AddMonitorSubscription(int IfcID, int hdl) {
+    monitorMapLock.lock();
+    std::shared_ptr<const multimap<int,int> > current = std::atomic_load(&monitorInterfaceMap);
+    std::shared_ptr<multimap<int,int> > updated =
+            current ? std::make_shared<multimap<int,int> >(*current) : std::make_shared<multimap<int,int> >();
+    updated->insert(std::make_pair(IfcID, hdl));
+    std::atomic_store(&monitorInterfaceMap, std::shared_ptr<const multimap<int,int> >(updated));
     monitorMapLock.unlock();
 }
 
@@ -933,21 +1486,17 @@ void ManagerCommHandler::MonitorThreadRun() {
 
                     // NOTE, here we register interfaces first if all interfaces are monitored.
                     if(localIntMap.count(hdl) == TheModel.GetInterfacesNum()) {
-                        monitorMapLock.lock();
                         std::multimap<int,int>::iterator it;
                         for(it = localIntMap.lower_bound(hdl);
                              it != localIntMap.upper_bound(hdl);
                              it++) {
-                            monitorInterfaceMap.insert(std::make_pair(it->second, hdl));
+                            AddMonitorSubscription(it->second, hdl);
                         }
-                        monitorMapLock.unlock();
                     }
                     else {
                     }
 #else
-                    monitorMapLock.lock();
-                    monitorInterfaceMap.insert(std::make_pair(IfcID, hdl));
-                    monitorMapLock.unlock();
+                    AddMonitorSubscription(IfcID, hdl);
 #endif
 
                 }
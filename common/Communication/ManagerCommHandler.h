@@ -10,6 +10,8 @@
 
 #include <string>
 #include <map>
+#include <memory>
+#include <atomic>
 // note: <map> must be above all, because of a VC2005 bug (on _Wherenode)
 
 #include "Communication/TLMCommUtil.h"
@@ -23,6 +25,29 @@
 #include <unistd.h>
 #endif
 
+class ManagerCommHandler;
+
+//! State of one I/O worker thread in sharded mode, see ManagerCommHandler::RunWorkers.
+struct TLMWorkerShard {
+    //! The handler running the worker
+    ManagerCommHandler* Handler;
+
+    //! Shard index, same as in TLMManagerComm
+    int Index;
+
+    //! Messages from the other workers to be sent to the sockets of this shard
+    TLMMessageRing Inbox;
+
+    //! Components of this shard that asked for close permission
+    std::vector<int> ClosedComponents;
+
+    //! Set when the worker has returned, the inbox is not served any more
+    std::atomic<bool> Finished;
+
+    //! Constructor
+    TLMWorkerShard(ManagerCommHandler* handler, int index);
+};
+
 //! \class ManagerCommHandler
 //! ManagerCommHandler class implements the communication protocol 
 //! It uses the classes defined in TLMManagerComm.h
@@ -52,9 +77,11 @@ private:
     CommunicationMode CommMode;
 
     //! The multimap to store monitoring interface sockets.
-    std::multimap<int,int> monitorInterfaceMap;
+    //! Read-mostly: readers take a snapshot with std::atomic_load,
+    //! updates copy the map and publish the copy with std::atomic_store.
+    std::shared_ptr<const std::multimap<int,int> > monitorInterfaceMap;
 
-    //! The multimap mutex for synchronisation of "monitorInterfaceMap" access
+    //! The mutex serializing updates of "monitorInterfaceMap" and "DisconnectedMonitors"
     SimpleLock monitorMapLock;
 
 public:
@@ -71,6 +98,23 @@ private:
     //! Lock for setting exception message.
     SimpleLock exceptionLock;
 
+    //! Address (<host>:<port>) where each component accepts direct links,
+    //! empty if the component can't take part in direct links.
+    std::vector<std::string> DirectLinkAddress;
+
+    //! Flag per interface, true if the time data goes directly to the
+    //! linked interface. The manager only gets a copy for monitoring then.
+    std::vector<bool> DirectLinked;
+
+    //! I/O workers in sharded mode, empty otherwise.
+    std::vector<TLMWorkerShard*> Workers;
+
+    //! Set by HandleThreadException to stop the I/O workers.
+    std::atomic<bool> Aborted;
+
+    //! Statistics of the forwarded time data per interface
+    TLMStatistics Statistics;
+
 public:
     //! Constructor.
     ManagerCommHandler(omtlm_CompositeModel& Model):
@@ -84,10 +128,20 @@ public:
         monitorMapLock(),
         runningMode(StartUpMode),
         exceptionMsg(""),
-        exceptionLock()
+        exceptionLock(),
+        DirectLinkAddress(),
+        DirectLinked(),
+        Workers(),
+        Aborted(false),
+        Statistics()
     {
+        Comm.SetUseSharedMemory(Model.GetSimParams().GetSharedMemory());
+        Comm.SetUnixSocketPath(TLMCommUtil::GetUnixSocketPath(Model.GetSimParams().GetAddress()));
     }
 
+    //! Destructor
+    ~ManagerCommHandler();
+
     //! Run method executes all the protocols in the right order:
     //! Startup, Check then Simulate
     void Run(CommunicationMode CommMode_In = CoSimulationMode);
@@ -140,6 +194,10 @@ public:
 
     void ProcessRegParameterMessage(int compID, TLMMessage& mess);
 
+    //! ProcessRegBatchMessage processes the registrations in a TLM_REG_BATCH
+    //! message and replaces it with a TLM_REG_BATCH holding the replies.
+    void ProcessRegBatchMessage(int compID, TLMMessage& mess);
+
     //! ReaderThreadRun processes incomming messages and creates
     //! messages to be sent.
     void ReaderThreadRun();
@@ -177,6 +235,41 @@ public:
     //! Marshal time stamped message to the right client
     void MarshalMessage(TLMMessage& message);
 
+    //! Forward a time data message or a bundle of them from a component.
+    //! The messages to be sent are appended to "out", the others are released.
+    void ProcessTimeData(TLMMessage* message, std::vector<TLMMessage*>& out);
+
+    //! Marshal a single time data message and forward it to the monitors.
+    //! It is appended to "out" unless it was already sent on a direct link.
+    void ForwardTimeData(TLMMessage* message, std::vector<TLMMessage*>& out);
+
+    //! Check if the destination of a marshalled message accepts bundles.
+    bool AcceptsBundles(const TLMMessage& message);
+
+    //! Combine the messages that go to the same component into bundles
+    //! where the component accepts them and append the result to "out".
+    void BundleMessages(std::vector<TLMMessage*>& parts, std::vector<TLMMessage*>& out);
+
+    //! Forward start to the particular object
+    static void* thread_WorkerThreadRun(void * arg) {
+        TLMWorkerShard* shard = (TLMWorkerShard*)arg;
+        ManagerCommHandler* con = shard->Handler;
+        try {
+            con->WorkerThreadRun(*shard);
+        }
+        catch(std::string& msg) {
+            con->HandleThreadException(msg);
+        }
+        catch(...) {
+            con->HandleThreadException("Manager worker thread caught exception");
+        }
+        return NULL;
+    }
+
+    //! Receive, marshal and send the messages of one shard of the
+    //! components until they all asked for close permission.
+    void WorkerThreadRun(TLMWorkerShard& shard);
+
 
     //! Forward start to the particular object
     static void* thread_MonitorThreadRun(void * arg) {
@@ -210,10 +303,23 @@ private:
     //! Used in ProcessRegInterfaceMessage(...).
     void SetupInterfaceConnectionMessage(int IfcID, std::string& aName, TLMMessage& mess);
 
+    //! Store the direct link address sent by a client with TLM_CHECK_MODEL.
+    void ProcessCheckModelMessage(int compID, TLMMessage& mess);
+
+    //! Setup the TLM_CHECK_MODEL reply with the table of direct links
+    //! for the component. Each line reads
+    //! "<interface ID> <linked interface ID> <linked component ID> <host>:<port> <mirror>",
+    //! where mirror is 1 if the client must send a copy of the data to the manager.
+    void SetupDirectLinkMessage(int compID, TLMMessage& mess);
+
     //! Setup interface connection message for data request mode.
     //! Used in ProcessRegInterfaceMessage(...).
     void SetupInterfaceRequestMessage(TLMMessage& mess);
 
+    //! Replace compactly encoded 3D time data in the message with plain
+    //! doubles, for receivers that do not know the encoding.
+    void DecodeTimeData(TLMMessage& mess);
+
     //! Extracts the time data from message and stores it in the
     //! corresponding meta-model interface proxy.
     void UnpackAndStoreTimeData(TLMMessage& mess);
@@ -224,8 +330,25 @@ private:
     int ProcessInterfaceMonitoringMessage(TLMMessage& message);
 
     //! Forwards message to monitoring ports if necessary.
+    //! The payload is not copied, the copies share it with the message.
     void ForwardToMonitor(TLMMessage& message);
 
+    //! Subscribe the monitor socket to the data of an interface.
+    void AddMonitorSubscription(int IfcID, int hdl);
+
+    //! Run the time data exchange with one I/O worker thread per shard of
+    //! the component sockets. Returns when all workers are done, the
+    //! components that asked for close permission are added to closedComponents.
+    void RunWorkers(std::vector<int>& closedComponents);
+
+    //! Route a marshalled message from a worker: messages to the sockets of
+    //! the shard go to "outgoing", the others to the inbox of their shard.
+    void RouteMessage(TLMWorkerShard& shard, TLMMessage* message, std::vector<TLMMessage*>& outgoing);
+
+    //! Send the messages grouped by destination socket, one system call per
+    //! socket, and release them. The batch is cleared.
+    void SendGrouped(std::vector<TLMMessage*>& batch);
+
     //! Thread exception handler.
     //! Shuts down all communications and sets the exception message.
     //! Invoked by threads.
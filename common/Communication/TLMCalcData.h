@@ -11,6 +11,8 @@
 #ifndef TLMCalcData_h_
 #define TLMCalcData_h_
 
+#include <cstddef>
+
 //! TLMConnectionParams structure encapsulates the parameters of a TLM connection
 //! The data is directly transferred to a message therefore only 'double' fields
 //! with continious storage are allowed.
@@ -26,7 +28,9 @@ public:
         //RotMatrix,
         //Nom_cI_R_cX_cX,
         //Nom_cI_A_cX,
-        mode(0.0)
+        mode(0.0),
+        Encoding(0.0),
+        Interpolation(0.0)
     {
         for(int i=0; i<3; i++) {
             cX_R_cG_cG[i] = 0.0;
@@ -84,6 +88,39 @@ public:
     //! 0.0 = Real simulation
     //! 1.0 = Interface data request
     double mode;
+
+    //! Wire encoding flags (TLMWireEncodingConst) the interface uses
+    //! for its 3D time data, 0.0 for plain doubles.
+    //! Not sent to clients that do not list any encoding flags.
+    double Encoding;
+
+    //! Interpolation flags (TLMInterpolationConst) for the time data
+    //! the interface receives, 0.0 for the default interpolation.
+    //! Only sent to clients that list TLM_ENC_INTERPOLATION.
+    double Interpolation;
+};
+
+//! Size of TLMConnectionParams without the Encoding field, as
+//! expected by older clients.
+static const size_t TLM_CONNECTION_PARAMS_BASE_SIZE = offsetof(TLMConnectionParams, Encoding);
+
+//! Size of TLMConnectionParams without the Interpolation field, as
+//! expected by clients that know the wire encodings only.
+static const size_t TLM_CONNECTION_PARAMS_ENC_SIZE = offsetof(TLMConnectionParams, Interpolation);
+
+//! TLMInterpolationConst lists the flags of TLMConnectionParams::Interpolation.
+struct TLMInterpolationConst {
+    //! Orientation by spherical linear interpolation of unit quaternions
+    //! instead of the 3-2-1 Euler angles of the relative rotation
+    static const int TLM_INTERP_SLERP = 1;
+    //! Orientation by normalized linear interpolation of unit quaternions,
+    //! cheaper than slerp and as accurate for small rotations between samples
+    static const int TLM_INTERP_NLERP = 2;
+    //! Mask for the orientation flags
+    static const int TLM_INTERP_ORIENTATION = 3;
+    //! Cubic Hermite interpolation through four time points instead of
+    //! linear interpolation between two, for all interface types
+    static const int TLM_INTERP_HERMITE = 4;
 };
 
 //! Time stamped 3D data that is send over between connected TLM interfaces.
@@ -5,9 +5,11 @@
 */
 #include "Communication/TLMCommUtil.h"
 #include "Communication/TLMClientComm.h"
+#include "Communication/TLMShmTransport.h"
 #include "Logging/TLMErrorLog.h"
 #include "Interfaces/TLMInterface.h"
 #include <vector>
+#include <algorithm>
 #include <deque>
 #include <string>
 #include <cstring>
@@ -23,6 +25,7 @@ using std::string;
 
 #ifndef WIN32
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -40,9 +43,30 @@ using std::string;
 
 // Constructor
 TLMClientComm::TLMClientComm()
-    : SocketHandle(-1) {}
+    : SocketHandle(-1),
+      ShmChannel(0),
+      DirectLinkListener(-1),
+      DirectLinkSockets(),
+      UseBundles(false),
+      Bundle(),
+      BundledInterfaces(),
+      UseRegBatch(false),
+      RegReplies(),
+      Sender() {}
 
 TLMClientComm::~TLMClientComm() {
+    // The queued messages go out before the connections are closed
+    Sender.Stop();
+    if(ShmChannel) {
+        TLMShmChannel::Detach(SocketHandle);
+        TLMShmSegment* seg = &ShmChannel->GetSegment();
+        delete ShmChannel;
+        delete seg;
+    }
+    StopDirectLinkListener();
+    for(vector<int>::iterator it = DirectLinkSockets.begin(); it != DirectLinkSockets.end(); ++it) {
+        close(*it);
+    }
     if(SocketHandle != -1) {
         close(SocketHandle);
     }
@@ -58,6 +82,7 @@ void TLMClientComm::PackTimeDataMessageSignal(int InterfaceID,
     out_mess.Header.MessageType =  TLMMessageTypeConst::TLM_TIME_DATA;
     out_mess.Header.TLMInterfaceID = InterfaceID;
     out_mess.Header.SourceIsBigEndianSystem = TLMMessageHeader::IsBigEndianSystem;
+    TLMCommUtil::SetEncoding(out_mess.Header, 0);
     out_mess.Header.DataSize = Data.size() * sizeof(TLMTimeDataSignal);
     out_mess.Data.clear();
     out_mess.Data.resize(out_mess.Header.DataSize);
@@ -70,10 +95,18 @@ void TLMClientComm::PackTimeDataMessageSignal(int InterfaceID,
 //  when constructing messages with time-stamped data.
 void TLMClientComm::PackTimeDataMessage3D(int InterfaceID,
                                           std::vector<TLMTimeData3D> &Data,
-                                          TLMMessage& out_mess) {
+                                          TLMMessage& out_mess,
+                                          int encoding) {
     out_mess.Header.MessageType =  TLMMessageTypeConst::TLM_TIME_DATA;
     out_mess.Header.TLMInterfaceID = InterfaceID;
     out_mess.Header.SourceIsBigEndianSystem = TLMMessageHeader::IsBigEndianSystem;
+    encoding &= TLMWireEncodingConst::TLM_ENC_ALL;
+    TLMCommUtil::SetEncoding(out_mess.Header, encoding);
+    if(encoding != 0) {
+        TLMCommUtil::EncodeTimeData3D(Data.empty() ? NULL : &Data[0], Data.size(), encoding, out_mess.Data);
+        out_mess.Header.DataSize = out_mess.Data.size();
+        return;
+    }
     out_mess.Header.DataSize = Data.size() * sizeof(TLMTimeData3D);
     out_mess.Data.clear();
     out_mess.Data.resize(out_mess.Header.DataSize);
@@ -89,6 +122,7 @@ void TLMClientComm::PackTimeDataMessage1D(int InterfaceID,
     out_mess.Header.MessageType =  TLMMessageTypeConst::TLM_TIME_DATA;
     out_mess.Header.TLMInterfaceID = InterfaceID;
     out_mess.Header.SourceIsBigEndianSystem = TLMMessageHeader::IsBigEndianSystem;
+    TLMCommUtil::SetEncoding(out_mess.Header, 0);
     out_mess.Header.DataSize = Data.size() * sizeof(TLMTimeData1D);
     out_mess.Data.clear();
     out_mess.Data.resize(out_mess.Header.DataSize);
@@ -97,7 +131,7 @@ void TLMClientComm::PackTimeDataMessage1D(int InterfaceID,
 
 
 // Unpack TLMTimeData from TLMMessage3D into Data queue
-void TLMClientComm::UnpackTimeDataMessageSignal(TLMMessage &mess, std::deque<TLMTimeDataSignal> &Data) {
+void TLMClientComm::UnpackTimeDataMessageSignal(TLMMessage &mess, TLMTimeDataRing<TLMTimeDataSignal> &Data) {
 
     // since mess.Data is continious we can just convert the pointer
     TLMTimeDataSignal* Next = (TLMTimeDataSignal*)(&mess.Data[0]);
@@ -110,15 +144,29 @@ void TLMClientComm::UnpackTimeDataMessageSignal(TLMMessage &mess, std::deque<TLM
         TLMCommUtil::ByteSwap(Next, sizeof(double),  mess.Header.DataSize/sizeof(double));
 
     for(unsigned i = 0; i < mess.Header.DataSize/sizeof(TLMTimeDataSignal); i++, Next++) {
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-           TLMErrorLog::Info(" RECV for time= " + TLMErrorLog::ToStdStr(Next->time));
-        }
+        TLM_LOG_INFO(" RECV for time= " + TLMErrorLog::ToStdStr(Next->time));
         Data.push_back(*Next);
     }
 }
 
 // Unpack TLMTimeData from TLMMessage3D into Data queue
-void TLMClientComm::UnpackTimeDataMessage3D(TLMMessage& mess, deque<TLMTimeData3D>& Data) {
+void TLMClientComm::UnpackTimeDataMessage3D(TLMMessage& mess, TLMTimeDataRing<TLMTimeData3D>& Data) {
+
+    int encoding = TLMCommUtil::GetEncoding(mess.Header);
+    if(encoding != 0) {
+        vector<TLMTimeData3D> decoded;
+        if(!TLMCommUtil::DecodeTimeData3D(mess.Header.DataSize > 0 ? &mess.Data[0] : NULL, mess.Header.DataSize, encoding,
+                                          TLMMessageHeader::IsBigEndianSystem != mess.Header.SourceIsBigEndianSystem,
+                                          decoded)) {
+            TLMErrorLog::FatalError("Wrong size of encoded 3D time data: DataSize " + std::to_string(mess.Header.DataSize));
+            return;
+        }
+        for(vector<TLMTimeData3D>::iterator it = decoded.begin(); it != decoded.end(); ++it) {
+            TLM_LOG_INFO(" RECV for time= " + TLMErrorLog::ToStdStr(it->time));
+            Data.push_back(*it);
+        }
+        return;
+    }
 
     // since mess.Data is continious we can just convert the pointer
     TLMTimeData3D* Next = (TLMTimeData3D*)(&mess.Data[0]);
@@ -131,15 +179,13 @@ void TLMClientComm::UnpackTimeDataMessage3D(TLMMessage& mess, deque<TLMTimeData3
         TLMCommUtil::ByteSwap(Next, sizeof(double),  mess.Header.DataSize/sizeof(double));
 
     for(unsigned i = 0; i < mess.Header.DataSize/sizeof(TLMTimeData3D); i++, Next++) {
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info(" RECV for time= " + TLMErrorLog::ToStdStr(Next->time));
-        }
+        TLM_LOG_INFO(" RECV for time= " + TLMErrorLog::ToStdStr(Next->time));
         Data.push_back(*Next);
     }
 }
 
 // Unpack TLMTimeData from TLMMessage1D into Data queue
-void TLMClientComm::UnpackTimeDataMessage1D(TLMMessage& mess, deque<TLMTimeData1D>& Data) {
+void TLMClientComm::UnpackTimeDataMessage1D(TLMMessage& mess, TLMTimeDataRing<TLMTimeData1D>& Data) {
 
     // since mess.Data is continious we can just convert the pointer
     TLMTimeData1D* Next = (TLMTimeData1D*)(&mess.Data[0]);
@@ -152,17 +198,116 @@ void TLMClientComm::UnpackTimeDataMessage1D(TLMMessage& mess, deque<TLMTimeData1
         TLMCommUtil::ByteSwap(Next, sizeof(double),  mess.Header.DataSize/sizeof(double));
 
     for(unsigned i = 0; i < mess.Header.DataSize/sizeof(TLMTimeData1D); i++, Next++) {
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info(" RECV for time= " + TLMErrorLog::ToStdStr(Next->time));
-        }
+        TLM_LOG_INFO(" RECV for time= " + TLMErrorLog::ToStdStr(Next->time));
         Data.push_back(*Next);
     }
 }
 
+void TLMClientComm::Send(TLMMessage& mess) {
+    if(Sender.IsRunning()) {
+        Sender.Send(mess);
+    }
+    else {
+        TLMCommUtil::SendMessage(mess);
+    }
+}
+
+void TLMClientComm::SendToManager(TLMMessage& mess) {
+    mess.SocketHandle = SocketHandle;
+    if(!UseBundles) {
+        Send(mess);
+        return;
+    }
+
+    // A second message for the same interface belongs to the next sync point.
+    if(IsBundled(mess.Header.TLMInterfaceID)) {
+        FlushBundle();
+    }
+    if(BundledInterfaces.empty()) {
+        TLMCommUtil::InitBundle(Bundle);
+    }
+    TLMCommUtil::AddToBundle(Bundle, mess);
+    BundledInterfaces.push_back(mess.Header.TLMInterfaceID);
+}
+
+bool TLMClientComm::IsBundled(int interfaceID) const {
+    return std::find(BundledInterfaces.begin(), BundledInterfaces.end(), interfaceID) != BundledInterfaces.end();
+}
+
+void TLMClientComm::FlushBundle() {
+    if(BundledInterfaces.empty()) return;
+
+    Bundle.SocketHandle = SocketHandle;
+    if(BundledInterfaces.size() == 1) {
+        // No need for a bundle, send the plain message.
+        TLMMessage single;
+        size_t offset = 0;
+        TLMCommUtil::GetBundleEntry(Bundle, offset, single);
+        Send(single);
+    }
+    else {
+        Send(Bundle);
+    }
+    BundledInterfaces.clear();
+}
+
+void TLMClientComm::PrefetchRegistrations(const std::vector<TLMMessage>& requests) {
+    if(requests.empty()) return;
+
+    TLMMessage batch;
+    TLMCommUtil::InitBundle(batch, TLMMessageTypeConst::TLM_REG_BATCH);
+    for(vector<TLMMessage>::const_iterator it = requests.begin(); it != requests.end(); ++it) {
+        TLMCommUtil::AddToBundle(batch, *it);
+    }
+    batch.SocketHandle = SocketHandle;
+    TLMCommUtil::SendMessage(batch);
+
+    TLMCommUtil::ReceiveMessage(batch);
+    while(batch.Header.MessageType != TLMMessageTypeConst::TLM_REG_BATCH) {
+        TLMCommUtil::ReceiveMessage(batch);
+    }
+
+    size_t offset = 0;
+    TLMMessage reply;
+    while(TLMCommUtil::GetBundleEntry(batch, offset, reply)) {
+        RegReplies.push_back(reply);
+    }
+    if(RegReplies.size() != requests.size()) {
+        TLMErrorLog::FatalError("Wrong number of replies in registration batch");
+    }
+}
+
+void TLMClientComm::ExchangeRegMessage(TLMMessage& mess) {
+    char type = mess.Header.MessageType;
+
+    if(!RegReplies.empty()) {
+        if(RegReplies.front().Header.MessageType != type) {
+            TLMErrorLog::FatalError("Registration requests do not match the batch sent before");
+        }
+        int hdl = mess.SocketHandle;
+        mess = RegReplies.front();
+        mess.SocketHandle = hdl;
+        RegReplies.pop_front();
+        return;
+    }
+
+    TLMCommUtil::SendMessage(mess);
+
+    TLMCommUtil::ReceiveMessage(mess);
+    while(mess.Header.MessageType != type) {
+        TLMCommUtil::ReceiveMessage(mess);
+    }
+}
+
 // ConnectManager function tries to establish a TCP/IP connection
 // to the TLM manager.Returns socket handle on success.
 // Input: hostname (callname) & port number
 int TLMClientComm::ConnectManager(string& callname, int portnr) {
+    string path = TLMCommUtil::GetUnixSocketPath(callname);
+    if(!path.empty()) {
+        return ConnectUnixSocket(path);
+    }
+
     struct sockaddr_in sa;
     int s,count;
 
@@ -238,9 +383,58 @@ int TLMClientComm::ConnectManager(string& callname, int portnr) {
     }
 
 
+    TLMCommUtil::PrepareSocket(s);
+
+    SocketHandle = s;
+
+    return(s);
+}
+
+// ConnectUnixSocket connects to the manager on a Unix domain socket.
+// Retries like ConnectManager since the manager might not listen yet.
+int TLMClientComm::ConnectUnixSocket(const string& path) {
+#ifndef WIN32
+    TLMErrorLog::Info("Trying to connect to TLM manager at " + path);
+
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(sa.sun_path)) {
+        TLMErrorLog::FatalError("TLM: Socket path too long: " + path);
+        return -1;
+    }
+    strcpy(sa.sun_path, path.c_str());
+
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(s < 0) {
+        TLMErrorLog::FatalError("TLM: Can not contact TLM manager");
+        return -1;
+    }
+
+    int count = 0;
+    while(connect(s, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        count++;
+        TLMErrorLog::Info(string("Connection attempt ") +  TLMErrorLog::ToStdStr(count) + " failed");
+        if(count>=10) {
+            close(s);
+            TLMErrorLog::FatalError("TLM: Can not connect to manager");
+            return -1;
+        }
+
+        TLMErrorLog::Info("Pausing...");
+        usleep(count * count * 1000000); // micro seconds
+        TLMErrorLog::Info("Trying again...");
+    }
+
+    TLMCommUtil::PrepareSocket(s);
+
     SocketHandle = s;
 
     return(s);
+#else
+    TLMErrorLog::FatalError("TLM: Unix domain sockets are not supported on this platform: " + path);
+    return -1;
+#endif
 }
 
 void TLMClientComm::CreateComponentRegMessage(std::string& Name, TLMMessage& mess) {
@@ -250,6 +444,147 @@ void TLMClientComm::CreateComponentRegMessage(std::string& Name, TLMMessage& mes
     memcpy(&mess.Data[0], Name.c_str(), Name.length());
 }
 
+bool TLMClientComm::NegotiateSharedMemory(TLMMessage& mess) {
+    if(mess.Header.DataSize <= 0) return false; // no offer, e.g., disabled on the manager
+
+    string offer((const char*)&mess.Data[0], mess.Header.DataSize);
+    int slot = -1;
+    TLMShmSegment* seg = TLMShmSegment::Open(offer, slot);
+    if(!seg) return false; // probably the manager runs on another host
+
+    if(!TLMShmChannel::CanAttach(SocketHandle)) {
+        TLMErrorLog::Warning("Socket handle out of range for shared memory transport, using socket");
+        delete seg;
+        return false;
+    }
+
+    // Accept the offer. The handshake goes on the socket.
+    mess.Header.MessageType = TLMMessageTypeConst::TLM_REG_SHM;
+    mess.Header.TLMInterfaceID = slot;
+    mess.Header.DataSize = 0;
+    TLMCommUtil::SendMessage(mess);
+    TLMCommUtil::ReceiveMessage(mess);
+
+    if(mess.Header.MessageType != TLMMessageTypeConst::TLM_REG_SHM
+       || mess.Header.TLMInterfaceID != slot) {
+        TLMErrorLog::Warning("Manager refused shared memory transport, using socket");
+        delete seg;
+        return false;
+    }
+
+    ShmChannel = new TLMShmChannel(*seg, slot, SocketHandle, false);
+    if(!TLMShmChannel::Attach(SocketHandle, ShmChannel)) {
+        delete ShmChannel;
+        ShmChannel = 0;
+        delete seg;
+        return false;
+    }
+
+    TLMErrorLog::Info("Using shared memory transport, slot " + TLMErrorLog::ToStdStr(slot));
+
+    return true;
+}
+
+int TLMClientComm::StartDirectLinkListener() {
+#ifndef WIN32
+    if(DirectLinkListener != -1) StopDirectLinkListener();
+
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if(s < 0) return -1;
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    sa.sin_port = 0; // any free port
+
+    socklen_t len = sizeof(sa);
+    if(bind(s, (struct sockaddr*)&sa, sizeof(sa)) < 0
+       || listen(s, 16) < 0
+       || getsockname(s, (struct sockaddr*)&sa, &len) < 0) {
+        TLMErrorLog::Warning("Failed to open direct link listener, using the manager for all data");
+        close(s);
+        return -1;
+    }
+
+    DirectLinkListener = s;
+    return ntohs(sa.sin_port);
+#else
+    return -1;
+#endif
+}
+
+void TLMClientComm::StopDirectLinkListener() {
+    if(DirectLinkListener != -1) {
+        close(DirectLinkListener);
+        DirectLinkListener = -1;
+    }
+}
+
+int TLMClientComm::ConnectDirectLink(const std::string& address, int componentID) {
+#ifndef WIN32
+    string::size_type colPos = address.rfind(':');
+    if(colPos == string::npos) {
+        TLMErrorLog::FatalError("Direct link address expected <host>:<port>, got: " + address);
+    }
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((u_short)atoi(address.c_str() + colPos + 1));
+    sa.sin_addr.s_addr = inet_addr(address.substr(0, colPos).c_str());
+
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if(s < 0 || connect(s, (struct sockaddr*)&sa, sizeof(sa)) < 0) {
+        TLMErrorLog::FatalError("TLM: Can not connect direct link to " + address);
+    }
+
+    TLMCommUtil::PrepareSocket(s);
+    DirectLinkSockets.push_back(s);
+
+    TLMMessage hello;
+    hello.SocketHandle = s;
+    hello.Header.MessageType = TLMMessageTypeConst::TLM_DIRECT_LINK;
+    hello.Header.TLMInterfaceID = componentID;
+    hello.Header.DataSize = 0;
+    TLMCommUtil::SendMessage(hello);
+
+    TLMErrorLog::Info("Direct link to " + address + " is connected");
+
+    return s;
+#else
+    TLMErrorLog::FatalError("Direct links are not supported on this platform");
+    return -1;
+#endif
+}
+
+int TLMClientComm::AcceptDirectLink(int& componentID) {
+#ifndef WIN32
+    int s = accept(DirectLinkListener, 0, 0);
+    if(s < 0) {
+        TLMErrorLog::FatalError("TLM: Failed to accept direct link");
+    }
+
+    TLMCommUtil::PrepareSocket(s);
+    DirectLinkSockets.push_back(s);
+
+    TLMMessage hello;
+    hello.SocketHandle = s;
+    if(!TLMCommUtil::ReceiveMessage(hello)
+       || hello.Header.MessageType != TLMMessageTypeConst::TLM_DIRECT_LINK) {
+        TLMErrorLog::FatalError("Direct link registration message expected");
+    }
+    componentID = hello.Header.TLMInterfaceID;
+
+    TLMErrorLog::Info("Direct link from component " + TLMErrorLog::ToStdStr(componentID) + " is accepted");
+
+    return s;
+#else
+    TLMErrorLog::FatalError("Direct links are not supported on this platform");
+    return -1;
+#endif
+}
+
 void TLMClientComm::CreateInterfaceRegMessage(std::string& Name, int dimensions,
                                               std::string &causality, std::string domain, TLMMessage& mess) {
     mess.Header.MessageType = TLMMessageTypeConst::TLM_REG_INTERFACE;
@@ -266,6 +601,10 @@ void TLMClientComm::CreateInterfaceRegMessage(std::string& Name, int dimensions,
     mess.Header.DataSize = specification.length();
     mess.Data.resize(specification.length());
     memcpy(&mess.Data[0], specification.c_str(), specification.length());
+
+    // Tell the manager which compact encodings of time data we understand.
+    TLMCommUtil::SetEncoding(mess.Header, TLMWireEncodingConst::TLM_ENC_ALL | TLMWireEncodingConst::TLM_ENC_BUNDLE
+                                          | TLMWireEncodingConst::TLM_ENC_INTERPOLATION);
 }
 
 void TLMClientComm::CreateParameterRegMessage(std::string &Name, std::string &Value, TLMMessage &mess) {
@@ -280,7 +619,9 @@ void TLMClientComm::CreateParameterRegMessage(std::string &Name, std::string &Va
 
 void TLMClientComm::UnpackRegInterfaceMessage(TLMMessage& mess, TLMConnectionParams& param) {
     if(mess.Header.DataSize == 0) return; // non connected interface
-    if(mess.Header.DataSize != sizeof(TLMConnectionParams)) {
+    if(mess.Header.DataSize != sizeof(TLMConnectionParams)
+       && mess.Header.DataSize != (int)TLM_CONNECTION_PARAMS_ENC_SIZE
+       && mess.Header.DataSize != (int)TLM_CONNECTION_PARAMS_BASE_SIZE) {
         TLMErrorLog::FatalError("Wrong size of message in interface registration : DataSize "+
             std::to_string(mess.Header.DataSize)+
             " sizeof(TLMConnectionParams)="+
@@ -13,21 +13,57 @@
 #include <string>
 #include <cstdlib>
 #include "Communication/TLMCommUtil.h"
+#include "Communication/TLMClientSender.h"
+#include "Communication/TLMTimeDataRing.h"
 #include "Logging/TLMErrorLog.h"
 #include "common.h"
 
+class TLMShmChannel;
+
 //! Class TLMClientCommUtil contains utility functions used by
 //! TLM client applications
 class TLMClientComm {
 
     int SocketHandle;
+
+    //! Shared memory channel to the manager, NULL if the socket is used.
+    TLMShmChannel* ShmChannel;
+
+    //! Listening socket for direct links from other clients, -1 if none.
+    int DirectLinkListener;
+
+    //! Sockets of the direct links to other clients.
+    std::vector<int> DirectLinkSockets;
+
+    //! Send the time data for the manager in TLM_TIME_DATA_BUNDLE messages.
+    bool UseBundles;
+
+    //! Time data messages for the manager waiting to be sent in one bundle.
+    TLMMessage Bundle;
+
+    //! Interface IDs of the messages in Bundle.
+    std::vector<int> BundledInterfaces;
+
+    //! The manager accepts TLM_REG_BATCH registrations.
+    bool UseRegBatch;
+
+    //! Registration replies received by PrefetchRegistrations,
+    //! consumed in order by ExchangeRegMessage.
+    std::deque<TLMMessage> RegReplies;
+
+    //! Background sender, used by Send once started.
+    TLMClientSender Sender;
+
+    //! Connect to the manager listening on the Unix domain socket
+    //! with the given path. Returns the socket handle.
+    int ConnectUnixSocket(const std::string& path);
     
 public:
 
     //! Constructor
     TLMClientComm();
 
-    //! Destructor, closes socket.
+    //! Destructor, closes socket and shared memory channel.
     ~TLMClientComm();
 
     //! Fill in TLMMessage with the information from TLMTimeData vector
@@ -39,27 +75,58 @@ public:
     static void PackTimeDataMessage1D(int InterfaceID,
                                       std::vector<TLMTimeData1D> &Data,
                                       TLMMessage &out_mess);
+    //! The 3D data is sent with the wire encoding flags granted for the
+    //! interface (TLMConnectionParams::Encoding), 0 sends plain doubles.
     static void PackTimeDataMessage3D(int InterfaceID,
                                       std::vector<TLMTimeData3D> &Data,
-                                      TLMMessage& out_mess);
+                                      TLMMessage& out_mess,
+                                      int encoding = 0);
 
-    //! Unpack TLMTimeData from TLMMessage into Data queue
-    static void UnpackTimeDataMessageSignal(TLMMessage &mess, std::deque<TLMTimeDataSignal> &Data);
-    static void UnpackTimeDataMessage1D(TLMMessage &mess, std::deque<TLMTimeData1D> &Data);
-    static void UnpackTimeDataMessage3D(TLMMessage& mess, std::deque<TLMTimeData3D>& Data);
+    //! Unpack TLMTimeData from TLMMessage into Data ring.
+    //! The 3D data may come in any wire encoding.
+    static void UnpackTimeDataMessageSignal(TLMMessage &mess, TLMTimeDataRing<TLMTimeDataSignal> &Data);
+    static void UnpackTimeDataMessage1D(TLMMessage &mess, TLMTimeDataRing<TLMTimeData1D> &Data);
+    static void UnpackTimeDataMessage3D(TLMMessage& mess, TLMTimeDataRing<TLMTimeData3D>& Data);
 
 
     //! ConnectManager function tries to establish a TCP/IP connection
     //! to the TLM manager.Returns socket handle on success.
     //! Input: hostname (callname) & port number
+    //! A callname in the form unix:\<path> connects to a Unix domain
+    //! socket instead, the port number is ignored.
     int ConnectManager(std::string& callname, int portnr);
 
     //! CreateComponentRegMessage packs component name into a message
     //! to be sent to the TLM manager
     void CreateComponentRegMessage(std::string& Name, TLMMessage& mess);
 
+    //! NegotiateSharedMemory checks the component registration reply for
+    //! a shared memory offer. If the segment can be opened the offer is
+    //! accepted and all further messages use the shared memory channel.
+    //! Returns true if the shared memory transport is used.
+    bool NegotiateSharedMemory(TLMMessage& mess);
+
+    //! StartDirectLinkListener opens a socket where other clients can
+    //! connect for direct time data exchange. Returns the port number
+    //! or -1 if direct links are not available.
+    int StartDirectLinkListener();
+
+    //! StopDirectLinkListener closes the listening socket, the
+    //! established direct links stay open.
+    void StopDirectLinkListener();
+
+    //! ConnectDirectLink connects to the direct link listener of another
+    //! client at \<host>:\<port> and tells it our component ID.
+    //! Returns the socket handle.
+    int ConnectDirectLink(const std::string& address, int componentID);
+
+    //! AcceptDirectLink waits for a direct link from another client.
+    //! Returns the socket handle and the component ID of the caller.
+    int AcceptDirectLink(int& componentID);
+
     //! CreateInterfaceRegMessage packs interface name into a message
-    //! to be sent to the TLM manager
+    //! to be sent to the TLM manager. The wire encodings the client can
+    //! decode are listed in the header.
     void CreateInterfaceRegMessage(std::string& Name, int dimensions, std::string& causality, std::string domain, TLMMessage& mess);
 
     //! CreateInterfaceRegMessage packs interface name into a message
@@ -67,13 +134,60 @@ public:
     void CreateParameterRegMessage(std::string& Name, std::string& Value, TLMMessage& mess);
 
     //! UnpackRegInterfaceMessage unpacks the parameters for the connection
-    //! attached to the specified interface
+    //! attached to the specified interface. Older managers do not send
+    //! the Encoding field, it is left at 0.0 then.
     void UnpackRegInterfaceMessage(TLMMessage& mess, TLMConnectionParams& param);
 
     void UnpackRegParameterMessage(TLMMessage &mess, std::string &Value);
 
     //! GetSocketHandle returns the SocketHandle obtained after a call to ConnectManager
     int GetSocketHandle() const { return SocketHandle; }
+
+    //! Collect the time data for the manager in bundles, enabled if the
+    //! manager accepts them (TLMWireEncodingConst::TLM_ENC_BUNDLE).
+    void SetUseBundles(bool use) { UseBundles = use; }
+
+    //! Send the time data from a background thread from now on, see Send.
+    //! Returns false if threads are not available.
+    bool StartAsyncSend() { return Sender.Start(); }
+
+    //! Send the queued messages and stop the sender thread, the messages
+    //! are then written by the calling thread.
+    void StopAsyncSend() { Sender.Stop(); }
+
+    //! Send a message from the solver thread. With the asynchronous send
+    //! started it is only queued, the messages keep their order.
+    void Send(TLMMessage& mess);
+
+    //! Send a time data message to the manager. With bundles it is only
+    //! added to the pending bundle, which is sent by FlushBundle or when
+    //! the same interface sends again.
+    void SendToManager(TLMMessage& mess);
+
+    //! Check if the pending bundle has a message for the interface.
+    bool IsBundled(int interfaceID) const;
+
+    //! Check if there is a bundle waiting to be sent.
+    bool HasBundle() const { return !BundledInterfaces.empty(); }
+
+    //! Send the pending bundle to the manager.
+    void FlushBundle();
+
+    //! Enable TLM_REG_BATCH registrations, set if the component registration
+    //! reply has the TLMWireEncodingConst::TLM_ENC_REG_BATCH flag.
+    void SetUseRegBatch(bool use) { UseRegBatch = use; }
+
+    //! Check if the manager accepts TLM_REG_BATCH registrations.
+    bool CanBatchRegistrations() const { return UseRegBatch; }
+
+    //! Send the interface and parameter registration requests to the manager
+    //! in one TLM_REG_BATCH message and keep the replies for ExchangeRegMessage.
+    void PrefetchRegistrations(const std::vector<TLMMessage>& requests);
+
+    //! Send a registration request and replace it with the reply of the same
+    //! type. Replies received by PrefetchRegistrations are used first, in the
+    //! order of the requests.
+    void ExchangeRegMessage(TLMMessage& mess);
 };
 
 #endif
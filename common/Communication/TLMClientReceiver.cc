@@ -0,0 +1,258 @@
+/**
+ * File: TLMClientReceiver.cc
+ *
+ * Implementation of the background receiver for TLM clients
+ */
+#include "Communication/TLMClientReceiver.h"
+#include "Communication/TLMCommUtil.h"
+#include "Logging/TLMErrorLog.h"
+
+#if !(defined(WIN32) || defined(__MINGW32__))
+#include <sys/socket.h>
+#endif
+
+//! Number of busy polls of an empty queue before yielding.
+//! Not used on a single CPU where spinning only delays the receiver.
+static const int TLM_RECEIVER_SPIN = 200;
+
+//! Number of yields before the consumer parks on the condition.
+static const int TLM_RECEIVER_YIELD = 50;
+
+
+TLMMessageFifo::TLMMessageFifo()
+    : Head(NULL)
+    , Tail(NULL)
+    , First(NULL)
+    , HeadCopy(NULL)
+    , Pending(NULL) {
+    Node* dummy = new Node();
+    Head.store(dummy, std::memory_order_relaxed);
+    Tail = First = HeadCopy = dummy;
+}
+
+TLMMessageFifo::~TLMMessageFifo() {
+    Node* node = First;
+    while(node != NULL) {
+        Node* next = node->Next.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+    }
+    delete Pending;
+}
+
+TLMMessage& TLMMessageFifo::GetFree() {
+    if(Pending == NULL) {
+        // Reuse a node the consumer is done with, i.e., one before Head
+        if(First == HeadCopy) {
+            HeadCopy = Head.load(std::memory_order_acquire);
+        }
+        if(First != HeadCopy) {
+            Pending = First;
+            First = First->Next.load(std::memory_order_relaxed);
+        }
+        else {
+            Pending = new Node();
+        }
+    }
+    return Pending->Message;
+}
+
+void TLMMessageFifo::Put() {
+    Pending->Next.store(NULL, std::memory_order_relaxed);
+    Tail->Next.store(Pending, std::memory_order_release);
+    Tail = Pending;
+    Pending = NULL;
+}
+
+TLMMessage* TLMMessageFifo::Get() {
+    Node* head = Head.load(std::memory_order_relaxed);
+    Node* next = head->Next.load(std::memory_order_acquire);
+    if(next == NULL) return NULL;
+    Head.store(next, std::memory_order_release);
+    return &next->Message;
+}
+
+
+TLMClientReceiver::TLMClientReceiver()
+    : Sources()
+    , TimeData()
+    , Control()
+    , InterfaceIndex()
+    , Stopped(false)
+    , ParkLock()
+    , DataWait()
+    , ConsumerParked(false)
+    , SpinCount(NumCPUs() > 1 ? TLM_RECEIVER_SPIN : 0) {
+}
+
+TLMClientReceiver::~TLMClientReceiver() {
+    Stop();
+    for(std::vector<TLMMessageFifo*>::iterator it = TimeData.begin(); it != TimeData.end(); ++it) {
+        delete *it;
+    }
+}
+
+bool TLMClientReceiver::Start(const std::vector<int>& sockets, const std::map<int, int>& interfaceIndex) {
+#ifdef SKIP_PTHREADS
+    (void)sockets;
+    (void)interfaceIndex;
+    return false;
+#else
+    if(IsRunning() || sockets.empty()) return false;
+
+    InterfaceIndex = interfaceIndex;
+    for(std::map<int, int>::const_iterator it = interfaceIndex.begin(); it != interfaceIndex.end(); ++it) {
+        if(it->second >= (int)TimeData.size()) {
+            TimeData.resize(it->second + 1, NULL);
+        }
+    }
+    for(std::vector<TLMMessageFifo*>::iterator it = TimeData.begin(); it != TimeData.end(); ++it) {
+        if(*it == NULL) *it = new TLMMessageFifo();
+    }
+
+    for(std::vector<int>::const_iterator it = sockets.begin(); it != sockets.end(); ++it) {
+        Source* src = new Source(this, *it);
+        if(pthread_create(&src->Thread, NULL, ThreadRun, src) != 0) {
+            TLMErrorLog::FatalError("Failed to start the receiver thread");
+        }
+        Sources.push_back(src);
+    }
+    return true;
+#endif
+}
+
+void TLMClientReceiver::Stop() {
+    if(!IsRunning()) return;
+
+    Stopped = true;
+    for(std::vector<Source*>::iterator it = Sources.begin(); it != Sources.end(); ++it) {
+        // Wakes up a thread blocked in reading, a shared memory channel
+        // sees it as a closed peer.
+#if defined(WIN32) || defined(__MINGW32__)
+        shutdown((*it)->Socket, SD_RECEIVE);
+#else
+        shutdown((*it)->Socket, SHUT_RD);
+#endif
+    }
+    for(std::vector<Source*>::iterator it = Sources.begin(); it != Sources.end(); ++it) {
+#ifndef SKIP_PTHREADS
+        pthread_join((*it)->Thread, NULL);
+#endif
+        delete *it;
+    }
+    Sources.clear();
+}
+
+void* TLMClientReceiver::ThreadRun(void* arg) {
+    Source* src = (Source*)arg;
+    src->Owner->ReceiverRun(*src);
+    return NULL;
+}
+
+void TLMClientReceiver::ReceiverRun(Source& src) {
+    TLMMessage mess;
+    TLMMessage entry;
+    mess.SocketHandle = src.Socket;
+
+    bool more = true;
+    while(more && !Stopped) {
+        if(!TLMCommUtil::ReceiveMessage(mess)) break;
+
+        if(mess.Header.MessageType == TLMMessageTypeConst::TLM_TIME_DATA_BUNDLE) {
+            size_t offset = 0;
+            while(TLMCommUtil::GetBundleEntry(mess, offset, entry)) {
+                Route(entry);
+            }
+        }
+        else {
+            more = Route(mess);
+        }
+    }
+
+    src.Closed = true;
+    Notify();
+}
+
+bool TLMClientReceiver::Route(TLMMessage& mess) {
+    TLMMessageFifo* fifo = &Control;
+    if(mess.Header.MessageType == TLMMessageTypeConst::TLM_TIME_DATA) {
+        std::map<int, int>::const_iterator it = InterfaceIndex.find(mess.Header.TLMInterfaceID);
+        if(it == InterfaceIndex.end()) {
+            TLMErrorLog::Warning("Time data for unknown interface " + TLMErrorLog::ToStdStr(mess.Header.TLMInterfaceID));
+            return true;
+        }
+        fifo = TimeData[it->second];
+    }
+
+    // Hand over the data buffer instead of copying it
+    TLMMessage& slot = fifo->GetFree();
+    slot.SocketHandle = mess.SocketHandle;
+    slot.Header = mess.Header;
+    slot.Data.swap(mess.Data);
+    slot.SharedData.reset();
+    fifo->Put();
+
+    Notify();
+
+    // Nothing more is expected after the close permission
+    return mess.Header.MessageType != TLMMessageTypeConst::TLM_CLOSE_PERMISSION;
+}
+
+TLMMessage* TLMClientReceiver::GetTimeData(int index, int socket) {
+    return Wait(*TimeData[index], FindSource(socket));
+}
+
+TLMMessage* TLMClientReceiver::GetControlMessage() {
+    return Wait(Control, Sources.empty() ? NULL : Sources.front());
+}
+
+TLMMessage* TLMClientReceiver::Wait(TLMMessageFifo& fifo, const Source* src) {
+    for(int spin = 0; ; spin++) {
+        TLMMessage* mess = fifo.Get();
+        if(mess != NULL) return mess;
+
+        if(src == NULL || src->Closed) {
+            // The last messages might have been put just before closing
+            return fifo.Get();
+        }
+
+        if(spin < SpinCount) {
+            SpinPause();
+            continue;
+        }
+        if(spin < SpinCount + TLM_RECEIVER_YIELD) {
+            YieldThread();
+            continue;
+        }
+
+        // Nothing for a while, park until a receiver wakes us up.
+        ParkLock.lock();
+        ConsumerParked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(fifo.Empty() && !src->Closed) {
+            DataWait.wait(ParkLock);
+        }
+        ConsumerParked.store(false, std::memory_order_relaxed);
+        ParkLock.unlock();
+
+        spin = 0;
+    }
+}
+
+const TLMClientReceiver::Source* TLMClientReceiver::FindSource(int socket) const {
+    for(std::vector<Source*>::const_iterator it = Sources.begin(); it != Sources.end(); ++it) {
+        if((*it)->Socket == socket) return *it;
+    }
+    return NULL;
+}
+
+void TLMClientReceiver::Notify() {
+    // Pairs with the fence in Wait: either the consumer sees the
+    // message before parking or we see that it is parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(ConsumerParked.load(std::memory_order_relaxed)) {
+        ParkLock.lock();
+        DataWait.signal();
+        ParkLock.unlock();
+    }
+}
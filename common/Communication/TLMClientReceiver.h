@@ -0,0 +1,180 @@
+//!
+//! \file TLMClientReceiver.h
+//!
+//! Defines the background receiver used by TLM clients that overlap
+//! the network latency with the solver work.
+//!
+
+#ifndef TLMClientReceiver_h_
+#define TLMClientReceiver_h_
+
+#include <atomic>
+#include <map>
+#include <vector>
+#include "TLMThreadSynch.h"
+#include "Communication/TLMCommUtil.h"
+
+//! Class TLMMessageFifo is an unbounded lock-free queue of messages with
+//! one producer and one consumer thread. The messages are stored in the
+//! queue nodes, consumed nodes are reused by the producer so that the
+//! message buffers are allocated only while the queue grows.
+class TLMMessageFifo {
+
+    //! Queue node
+    struct Node {
+        std::atomic<Node*> Next;
+        TLMMessage Message;
+        Node() : Next(NULL), Message() {}
+    };
+
+    //! Last consumed node, its message is the one returned by Get.
+    //! Written by the consumer only.
+    std::atomic<Node*> Head;
+
+    char Pad0[64];
+
+    //! Last put node. Producer only.
+    Node* Tail;
+
+    //! Oldest node, the nodes up to HeadCopy can be reused. Producer only.
+    Node* First;
+
+    //! Copy of Head seen by the producer
+    Node* HeadCopy;
+
+    //! Node filled by the producer, not yet put.
+    Node* Pending;
+
+public:
+
+    //! Constructor
+    TLMMessageFifo();
+
+    //! Destructor, deletes all the nodes.
+    ~TLMMessageFifo();
+
+    //! Get a message buffer to be filled in by the producer and put with Put.
+    TLMMessage& GetFree();
+
+    //! Put the message obtained with GetFree at the end of the queue.
+    void Put();
+
+    //! Get the first message from the queue, NULL if it is empty.
+    //! The message stays valid until the next call.
+    TLMMessage* Get();
+
+    //! Check if the queue is empty.
+    bool Empty() const {
+        return Head.load(std::memory_order_acquire)->Next.load(std::memory_order_acquire) == NULL;
+    }
+
+private:
+    // Should never be used
+    TLMMessageFifo(const TLMMessageFifo&);
+    TLMMessageFifo& operator=(const TLMMessageFifo&);
+};
+
+//! Class TLMClientReceiver receives the messages for a TLM client in
+//! background threads, one for each connection (the manager and the
+//! direct links). Time data bundles are split and the time data is
+//! queued per interface, so that the solver thread only waits if the
+//! data it needs has not arrived yet. The solver thread unpacks the
+//! messages, the interface objects are never touched by the receivers.
+//! Other messages, e.g., the close permission, are queued separately.
+class TLMClientReceiver {
+
+    //! A connection and its receiver thread
+    struct Source {
+        TLMClientReceiver* Owner;
+        int Socket;
+        std::atomic<bool> Closed;
+#ifndef SKIP_PTHREADS
+        pthread_t Thread;
+#endif
+        Source(TLMClientReceiver* owner, int socket) : Owner(owner), Socket(socket), Closed(false) {}
+    };
+
+    //! The connections, the first one is to the manager.
+    std::vector<Source*> Sources;
+
+    //! Time data queues, indexed by InterfaceIndex.
+    std::vector<TLMMessageFifo*> TimeData;
+
+    //! Messages from the manager that are not time data.
+    TLMMessageFifo Control;
+
+    //! Maps interface IDs to the TimeData index.
+    std::map<int, int> InterfaceIndex;
+
+    //! Set by Stop
+    std::atomic<bool> Stopped;
+
+    //! Lock used together with DataWait when the consumer parks.
+    SimpleLock ParkLock;
+
+    //! The consumer waits on this when the queue is empty.
+    SimpleCond DataWait;
+
+    //! True while the consumer is parked (or about to park).
+    std::atomic<bool> ConsumerParked;
+
+    //! Number of busy polls before the consumer starts yielding.
+    int SpinCount;
+
+public:
+
+    //! Constructor
+    TLMClientReceiver();
+
+    //! Destructor, stops the threads.
+    ~TLMClientReceiver();
+
+    //! Start a receiver thread for each of the sockets, the first one is
+    //! the manager connection. interfaceIndex maps the interface IDs to
+    //! indices used with GetTimeData. Returns 'false' if threads are
+    //! not available.
+    bool Start(const std::vector<int>& sockets, const std::map<int, int>& interfaceIndex);
+
+    //! Check if the receiver threads are started.
+    bool IsRunning() const { return !Sources.empty(); }
+
+    //! Stop reading on the sockets and wait for the threads.
+    void Stop();
+
+    //! Get the next time data message for the interface with the given
+    //! index, it comes on the given socket. Waits until the message arrives,
+    //! returns NULL if the connection is closed. The message stays valid
+    //! until the next call for the same interface.
+    TLMMessage* GetTimeData(int index, int socket);
+
+    //! Get the next message from the manager that is not time data.
+    //! Waits like GetTimeData.
+    TLMMessage* GetControlMessage();
+
+private:
+
+    //! Thread function
+    static void* ThreadRun(void* arg);
+
+    //! Receive loop of a connection
+    void ReceiverRun(Source& src);
+
+    //! Queue a received message. Returns 'false' if it is the
+    //! last one expected on the connection.
+    bool Route(TLMMessage& mess);
+
+    //! Wait until the queue has a message or the source is closed.
+    TLMMessage* Wait(TLMMessageFifo& fifo, const Source* src);
+
+    //! Find the source of a socket, NULL if unknown.
+    const Source* FindSource(int socket) const;
+
+    //! Wake up the consumer if it is parked.
+    void Notify();
+
+    // Should never be used
+    TLMClientReceiver(const TLMClientReceiver&);
+    TLMClientReceiver& operator=(const TLMClientReceiver&);
+};
+
+#endif
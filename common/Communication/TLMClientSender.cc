@@ -0,0 +1,124 @@
+/**
+ * File: TLMClientSender.cc
+ *
+ * Implementation of the background sender for TLM clients
+ */
+#include "Communication/TLMClientSender.h"
+#include "Communication/TLMCommUtil.h"
+#include "Logging/TLMErrorLog.h"
+
+//! Number of busy polls of an empty queue before yielding.
+//! Not used on a single CPU where spinning only delays the solver.
+static const int TLM_SENDER_SPIN = 200;
+
+//! Number of yields before the sender parks on the condition.
+static const int TLM_SENDER_YIELD = 50;
+
+
+TLMClientSender::TLMClientSender()
+    : Queue()
+    , Stopping(false)
+    , ParkLock()
+    , DataWait()
+    , SenderParked(false)
+    , SpinCount(NumCPUs() > 1 ? TLM_SENDER_SPIN : 0)
+    , Running(false) {
+}
+
+TLMClientSender::~TLMClientSender() {
+    Stop();
+}
+
+bool TLMClientSender::Start() {
+#ifdef SKIP_PTHREADS
+    return false;
+#else
+    if(Running) return true;
+
+    Stopping = false;
+    if(pthread_create(&Thread, NULL, ThreadRun, this) != 0) {
+        TLMErrorLog::Warning("Failed to start the sender thread");
+        return false;
+    }
+    Running = true;
+    return true;
+#endif
+}
+
+void TLMClientSender::Send(const TLMMessage& mess) {
+    // Copy into a buffer the sender is done with
+    TLMMessage& slot = Queue.GetFree();
+    slot.SocketHandle = mess.SocketHandle;
+    slot.Header = mess.Header;
+    slot.SharedData.reset();
+    if(mess.Header.DataSize > 0) {
+        const unsigned char* payload = mess.GetPayload();
+        slot.Data.assign(payload, payload + mess.Header.DataSize);
+    }
+    else {
+        slot.Data.clear();
+    }
+    Queue.Put();
+
+    // Pairs with the fence in SenderRun: either the sender sees the
+    // message before parking or we see that it is parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(SenderParked.load(std::memory_order_relaxed)) {
+        ParkLock.lock();
+        DataWait.signal();
+        ParkLock.unlock();
+    }
+}
+
+void TLMClientSender::Stop() {
+    if(!Running) return;
+
+    ParkLock.lock();
+    Stopping = true;
+    DataWait.signal();
+    ParkLock.unlock();
+
+#ifndef SKIP_PTHREADS
+    pthread_join(Thread, NULL);
+#endif
+    Running = false;
+}
+
+void* TLMClientSender::ThreadRun(void* arg) {
+    ((TLMClientSender*)arg)->SenderRun();
+    return NULL;
+}
+
+void TLMClientSender::SenderRun() {
+    for(int spin = 0; ; spin++) {
+        TLMMessage* mess = Queue.Get();
+        if(mess != NULL) {
+            TLMCommUtil::SendMessage(*mess);
+            spin = 0;
+            continue;
+        }
+
+        if(Stopping && Queue.Empty()) return;
+
+        if(spin < SpinCount) {
+            SpinPause();
+            continue;
+        }
+        if(spin < SpinCount + TLM_SENDER_YIELD) {
+            YieldThread();
+            continue;
+        }
+
+        // Nothing for a while, park until the solver sends again.
+        ParkLock.lock();
+        SenderParked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(Queue.Empty() && !Stopping) {
+            DataWait.wait(ParkLock);
+        }
+        SenderParked.store(false, std::memory_order_relaxed);
+        ParkLock.unlock();
+
+        spin = 0;
+    }
+}
@@ -0,0 +1,83 @@
+//!
+//! \file TLMClientSender.h
+//!
+//! Defines the background sender used by TLM clients so that the
+//! solver does not wait for the sockets.
+//!
+
+#ifndef TLMClientSender_h_
+#define TLMClientSender_h_
+
+#include <atomic>
+#include "TLMThreadSynch.h"
+#include "Communication/TLMCommUtil.h"
+#include "Communication/TLMClientReceiver.h"
+
+//! Class TLMClientSender sends the messages of a TLM client in a
+//! background thread. The solver thread copies a message into the send
+//! queue and continues, the sender thread writes it to the socket (or
+//! shared memory channel) given by its SocketHandle. The queue nodes
+//! are reused, so in steady state the copy goes to a buffer that was
+//! sent before and nothing is allocated.
+class TLMClientSender {
+
+    //! Messages waiting to be sent
+    TLMMessageFifo Queue;
+
+    //! Set by Stop, the thread exits when the queue is empty.
+    std::atomic<bool> Stopping;
+
+    //! Lock used together with DataWait when the sender parks.
+    SimpleLock ParkLock;
+
+    //! The sender waits on this when the queue is empty.
+    SimpleCond DataWait;
+
+    //! True while the sender is parked (or about to park).
+    std::atomic<bool> SenderParked;
+
+    //! Number of busy polls before the sender starts yielding.
+    int SpinCount;
+
+    //! True while the thread runs
+    bool Running;
+
+#ifndef SKIP_PTHREADS
+    //! The sender thread
+    pthread_t Thread;
+#endif
+
+public:
+
+    //! Constructor
+    TLMClientSender();
+
+    //! Destructor, sends the queued messages and stops the thread.
+    ~TLMClientSender();
+
+    //! Start the sender thread. Returns 'false' if threads are not available.
+    bool Start();
+
+    //! Check if the sender thread is started.
+    bool IsRunning() const { return Running; }
+
+    //! Queue a copy of the message. Must be called from one thread only.
+    void Send(const TLMMessage& mess);
+
+    //! Send the queued messages and stop the thread.
+    void Stop();
+
+private:
+
+    //! Thread function
+    static void* ThreadRun(void* arg);
+
+    //! Send loop
+    void SenderRun();
+
+    // Should never be used
+    TLMClientSender(const TLMClientSender&);
+    TLMClientSender& operator=(const TLMClientSender&);
+};
+
+#endif
@@ -1,7 +1,11 @@
 #include "Communication/TLMCommUtil.h"
+#include "Communication/TLMShmTransport.h"
 #include "Logging/TLMErrorLog.h"
+#include "Logging/TLMTrace.h"
 
 #include <string>
+#include <vector>
+#include <cmath>
 
 // BZ306: due to this difficulr bug detailed loggning of each send/recv was added.
 // However for performance reasons, i.e. tp
@@ -20,108 +24,302 @@ TLMMessageHeader::TLMMessageHeader():
     MessageType(0),
     SourceIsBigEndianSystem(IsBigEndianSystem),
     DataSize(0),
-    TLMInterfaceID(-1) {
+    TLMInterfaceID(-1),
+    ComponentParameterID(0) {
     strncpy(Signature, TLMSignature, TLM_SIGNATURE_LENGTH);
 }
 
-// Send the TLMMessage pointed by mess via socket with handle SocketHandle
-void TLMCommUtil::SendMessage(TLMMessage& mess) {
+#if !(defined(WIN32) || defined(__MINGW32__))
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#endif
 
-    int DataSize = mess.Header.DataSize;
+#include <atomic>
 
-    if(doDetailedLogging) {
-        TLMErrorLog::Info("SendMessage: wants to send "+
-                         std::to_string(sizeof(TLMMessageHeader))+"+"+
-                         std::to_string(DataSize)+ " bytes ");
+#ifndef MSG_WAITALL
+#define MSG_WAITALL 0
+#endif
+// Danger : winsock2.h in
+// c:\program files\microsoft platform sdk for windows server 2003 r2\include\winsock2.h(658) 
+// previously defines it as 
+// #define MSG_WAITALL     0x8             /* do not complete until packet is completely filled */
+// And this is *not implemented* reported. 
+
+//! Size of the per socket receive buffer. Larger messages are read
+//! directly into the message data.
+static const int TLM_RECV_BUFFER_SIZE = 1 << 16;
+
+//! Max. socket handle that gets a receive buffer, others read unbuffered.
+static const int TLM_RECV_MAX_SOCKETS = 1024;
+
+//! Receive buffer for one socket. Filled with whatever is available
+//! so that several small messages can be received with one recv().
+struct TLMReceiveBuffer {
+    char Data[TLM_RECV_BUFFER_SIZE];
+    int Begin;
+    int End;
+};
+
+//! Receive buffers indexed by the socket handle, allocated on first use.
+static std::atomic<TLMReceiveBuffer*> ReceiveBuffers[TLM_RECV_MAX_SOCKETS];
+
+static TLMReceiveBuffer* GetReceiveBuffer(int socket) {
+    if(socket < 0 || socket >= TLM_RECV_MAX_SOCKETS) return NULL;
+    TLMReceiveBuffer* buf = ReceiveBuffers[socket].load();
+    if(buf == NULL) {
+        TLMReceiveBuffer* newBuf = new TLMReceiveBuffer;
+        newBuf->Begin = newBuf->End = 0;
+        if(ReceiveBuffers[socket].compare_exchange_strong(buf, newBuf)) {
+            buf = newBuf;
+        }
+        else {
+            delete newBuf;
+        }
+    }
+    return buf;
+}
+
+// Receive exactly size bytes, taking them from the receive buffer first.
+// Returns size on success, 0 if the socket was closed, -1 on error.
+static int ReceiveBytes(int socket, char* dst, int size) {
+    TLMReceiveBuffer* buf = GetReceiveBuffer(socket);
+    int received = 0;
+    while(received < size) {
+        int bcount;
+        if(buf && buf->Begin < buf->End) {
+            bcount = buf->End - buf->Begin;
+            if(bcount > size - received) bcount = size - received;
+            memcpy(dst + received, buf->Data + buf->Begin, bcount);
+            buf->Begin += bcount;
+        }
+        else if(buf && (size - received) < TLM_RECV_BUFFER_SIZE / 2) {
+            // Small read, take everything the socket has in one call.
+            bcount = recv(socket, buf->Data, TLM_RECV_BUFFER_SIZE, 0);
+            if(bcount <= 0) return bcount;
+            buf->Begin = 0;
+            buf->End = bcount;
+            continue;
+        }
+        else {
+            // Large read, avoid the extra copy.
+            bcount = recv(socket, dst + received, size - received, MSG_WAITALL);
+            if(bcount <= 0) return bcount;
+        }
+        received += bcount;
+    }
+    return received;
+}
+
+void TLMCommUtil::PrepareSocket(int socket) {
+    struct sockaddr_storage sa;
+#ifndef WIN32
+    socklen_t len = sizeof(sa);
+#else
+    int len = sizeof(sa);
+#endif
+    bool isTcp = (getsockname(socket, (struct sockaddr*)&sa, &len) != 0
+                  || sa.ss_family == AF_INET || sa.ss_family == AF_INET6);
+
+    int flag = 1;
+    if(isTcp && setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(flag)) != 0) {
+        TLMErrorLog::Warning("Failed to set TCP_NODELAY on socket "+std::to_string(socket));
+    }
+
+    // The handle might be reused after a closed socket, drop old data.
+    if(socket >= 0 && socket < TLM_RECV_MAX_SOCKETS) {
+        TLMReceiveBuffer* buf = ReceiveBuffers[socket].load();
+        if(buf) {
+            buf->Begin = buf->End = 0;
+        }
+    }
+}
+
+bool TLMCommUtil::HasBufferedData(int socket) {
+    if(socket < 0 || socket >= TLM_RECV_MAX_SOCKETS) return false;
+    TLMReceiveBuffer* buf = ReceiveBuffers[socket].load();
+    return (buf != NULL) && (buf->Begin < buf->End);
+}
+
+//! Max. number of buffers passed to one sendmsg()/WSASend() call.
+static const int TLM_SEND_MAX_PARTS = 128;
+
+// Send the buffers in order with as few system calls as possible,
+// continue on short writes.
+// Returns the number of bytes sent, or a negative value on error.
+static int SendParts(int socket, char** part, int* len, int nParts, char messageType) {
+    int sent = 0;
+    int first = 0;   // first part not completely sent
+    int offset = 0;  // bytes already sent from the first part
+    int attempts = 1;
+    while(first < nParts) {
+        int n = 0;
+#if defined(WIN32) || defined(__MINGW32__)
+        WSABUF bufs[TLM_SEND_MAX_PARTS];
+        for(int i = first; i < nParts && n < TLM_SEND_MAX_PARTS; i++) {
+            if(len[i] == 0) continue;
+            bufs[n].buf = part[i] + (i == first ? offset : 0);
+            bufs[n].len = len[i] - (i == first ? offset : 0);
+            n++;
+        }
+        DWORD sendBytes = 0;
+        int ret = 0;
+        if(n > 0) {
+            ret = (WSASend(socket, bufs, n, &sendBytes, 0, NULL, NULL) == 0) ? (int)sendBytes : -1;
+        }
+#else
+        struct iovec iov[TLM_SEND_MAX_PARTS];
+        for(int i = first; i < nParts && n < TLM_SEND_MAX_PARTS; i++) {
+            if(len[i] == 0) continue;
+            iov[n].iov_base = part[i] + (i == first ? offset : 0);
+            iov[n].iov_len = len[i] - (i == first ? offset : 0);
+            n++;
+        }
+        int ret = 0;
+        if(n > 0) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+            ret = sendmsg(socket, &msg, 0);
+        }
+#endif
+
+        if(ret < 0) {
+#ifdef  WIN32
+            int errcode = WSAGetLastError();
+            TLMErrorLog::Warning("send() SOCKET_ERROR received, error code ="+std::to_string(errcode));
+#endif
+            if(attempts >= 10) return ret;
+            // try to resend
+            TLMErrorLog::Warning("Failed to send message, will try again (code: "+std::to_string(ret)+"), type = "+std::to_string(messageType));
+            ++attempts;
+            continue;
+        }
+        sent += ret;
+
+        // Skip what is already sent
+        offset += ret;
+        while(first < nParts && offset >= len[first]) {
+            offset -= len[first];
+            first++;
+        }
     }
+    return sent;
+}
 
+// Fix the byte order of the header fields if needed and, if a shared
+// memory channel is attached to the socket, send the message on it.
+// Returns 'true' if the message is sent.
+static bool PrepareSend(TLMMessage& mess) {
     if(TLMMessageHeader::IsBigEndianSystem != mess.Header.SourceIsBigEndianSystem) {
         // switch byte order for DataSize and InterfaceID
         TLMCommUtil::ByteSwap(&mess.Header.DataSize, sizeof(mess.Header.DataSize));
         TLMCommUtil::ByteSwap(&mess.Header.TLMInterfaceID, sizeof(mess.Header.TLMInterfaceID));
     }
 
-#if defined( WIN32) || defined(__APPLE__)
-    const int MSG_MORE = 0;
-#endif
+    // Registration handshake for the shared memory transport always goes on the socket.
+    TLMShmChannel* shm = NULL;
+    if(mess.Header.MessageType != TLMMessageTypeConst::TLM_REG_SHM) {
+        shm = TLMShmChannel::Find(mess.SocketHandle);
+    }
+    if(shm) {
+        int DataSize = mess.Header.DataSize;
+        shm->Send(mess.Header, DataSize > 0 ? mess.GetPayload() : NULL, DataSize);
+        return true;
+    }
+    return false;
+}
 
-    // NOTE, "MSG_MORE" flag is important for Linux socket performance!
-    int sendBytes = send(mess.SocketHandle, (const char*)&(mess.Header) , sizeof(TLMMessageHeader), MSG_MORE);
+// Send the TLMMessage pointed by mess via socket with handle SocketHandle
+void TLMCommUtil::SendMessage(TLMMessage& mess) {
+    TLMTraceScope trace(TLM_TRACE_SEND_MESSAGE, mess.Header.TLMInterfaceID, TLMTrace::NoTime());
 
-    int attempts = 1;
-    while(attempts < 10 && sendBytes < 0) {
-        // try to resend
-        TLMErrorLog::Warning("Failed to send message header, will try again (code: "+std::to_string(sendBytes)+"), type = "+std::to_string(mess.Header.MessageType));
-        sendBytes = send(mess.SocketHandle, (const char*)&(mess.Header) , sizeof(TLMMessageHeader), MSG_MORE);
-        ++attempts;
+    int DataSize = mess.Header.DataSize;
+
+    if(doDetailedLogging) {
+        TLMErrorLog::Info("SendMessage: wants to send "+
+                         std::to_string(sizeof(TLMMessageHeader))+"+"+
+                         std::to_string(DataSize)+ " bytes ");
     }
+
+    if(PrepareSend(mess)) return;
+
+    // Header and data go out with a single system call.
+    char* part[2] = { (char*)&(mess.Header), DataSize > 0 ? (char*)mess.GetPayload() : NULL };
+    int len[2] = { (int)sizeof(TLMMessageHeader), DataSize };
+    int sendBytes = SendParts(mess.SocketHandle, part, len, 2, mess.Header.MessageType);
     if(sendBytes < 0) {
-        TLMErrorLog::FatalError("Failed to send message header. Aborting.");
+        TLMErrorLog::FatalError("Failed to send message. Aborting.");
     }
 
-#ifdef  WIN32
-    int errcode = WSAGetLastError();
-    if(errcode) TLMErrorLog::Warning("send() SOCKET_ERROR received, error code ="+std::to_string(errcode));
-#endif
-
     if(doDetailedLogging) {
-        TLMErrorLog::Info("SendMessage:send() sent "+std::to_string(sendBytes)+ " bytes ");
+        TLMErrorLog::Info("SendMessage:sendmsg() sent "+std::to_string(sendBytes)+ " bytes ");
+    }
+}
+
+// Send several messages to the same socket. All headers and data
+// go out with one system call (per TLM_SEND_MAX_PARTS buffers).
+void TLMCommUtil::SendMessages(TLMMessage** mess, int count) {
+    if(count == 1) {
+        SendMessage(*mess[0]);
+        return;
     }
 
-    if(DataSize > 0) {
-        sendBytes = send(mess.SocketHandle, (const char*)&(mess.Data[0]), DataSize, 0);
-        attempts = 1;
-        if(attempts < 10 && sendBytes < 0) {
-            // try to resend
-            TLMErrorLog::Warning("Failed to send message data, will try to continue anyway");
-            sendBytes=send(mess.SocketHandle, (const char*)&(mess.Data[0]), DataSize, 0);
-        };
-        if(sendBytes < 0) {
-            TLMErrorLog::FatalError("Failed to send message data. Aborting.");
-        }
+    TLMTraceScope trace(TLM_TRACE_SEND_MESSAGE, mess[0]->Header.TLMInterfaceID, TLMTrace::NoTime());
 
-#ifdef  WIN32
-        int errcode = WSAGetLastError();
-        if(errcode) TLMErrorLog::Warning("send() SOCKET_ERROR received, error code ="+std::to_string(errcode));
-#endif
+    std::vector<char*> part;
+    std::vector<int> len;
+    part.reserve(2*count);
+    len.reserve(2*count);
 
-        if(doDetailedLogging) {
-            TLMErrorLog::Info("SendMessage:send()(part 2) sent "+std::to_string(sendBytes)+ " bytes ");
-        }
+    for(int i = 0; i < count; i++) {
+        TLMMessage& m = *mess[i];
+        int DataSize = m.Header.DataSize;
+        if(PrepareSend(m)) continue;
 
+        part.push_back((char*)&(m.Header));
+        len.push_back(sizeof(TLMMessageHeader));
+        if(DataSize > 0) {
+            part.push_back((char*)m.GetPayload());
+            len.push_back(DataSize);
+        }
     }
 
+    if(part.empty()) return;
 
-}
+    int sendBytes = SendParts(mess[0]->SocketHandle, &part[0], &len[0], part.size(), mess[0]->Header.MessageType);
+    if(sendBytes < 0) {
+        TLMErrorLog::FatalError("Failed to send message. Aborting.");
+    }
 
-#ifndef MSG_WAITALL
-#define MSG_WAITALL 0
-#endif
-// Danger : winsock2.h in
-// c:\program files\microsoft platform sdk for windows server 2003 r2\include\winsock2.h(658) 
-// previously defines it as 
-// #define MSG_WAITALL     0x8             /* do not complete until packet is completely filled */
-// And this is *not implemented* reported. 
+    if(doDetailedLogging) {
+        TLMErrorLog::Info("SendMessages: sent "+std::to_string(count)+" messages, "+std::to_string(sendBytes)+ " bytes ");
+    }
+}
 
 // Basic receive of a TLMMessage. Insures correct signature and
 // fixes byte order for the message header if necessary.
 // Note that the actual message data is not processed, just received, 
 bool TLMCommUtil::ReceiveMessage(TLMMessage& mess) {
-    int bcount = recv(mess.SocketHandle, (char*)(&mess.Header), sizeof(TLMMessageHeader) , MSG_WAITALL);
-    while((bcount >= 0) && (bcount <  static_cast<int>(sizeof(TLMMessageHeader)))) {
-        // this should never happen, but it does...
-        TLMErrorLog::Warning("Could not receive the header, will try again");
-        bcount += recv(mess.SocketHandle,
-                       (char*)(&mess.Header) + bcount,
-                       sizeof(TLMMessageHeader) - bcount,
-                       MSG_WAITALL);
-        if(bcount == 0)
-        {
-            TLMErrorLog::Warning("Received 0 bits. Socket is probably closed.");
-            return false; // seems like on windows this may indicate "socket closed"
-        }
-    }
-    if(bcount == -1) {
+    TLMTraceScope trace(TLM_TRACE_RECEIVE_MESSAGE, -1, TLMTrace::NoTime());
+    int bcount = 0;
+    mess.SharedData.reset(); // the new data goes to mess.Data
+    TLMShmChannel* shm = TLMShmChannel::Find(mess.SocketHandle);
+    if(shm) {
+        if(!shm->ReceiveHeader(mess.Header)) {
+            TLMErrorLog::Warning("Shared memory peer is gone. Socket is probably closed.");
+            return false;
+        }
+        bcount = sizeof(TLMMessageHeader);
+    }
+    else {
+        bcount = ReceiveBytes(mess.SocketHandle, (char*)(&mess.Header), sizeof(TLMMessageHeader));
+    }
+    if(bcount == 0) {
+        TLMErrorLog::Warning("Received 0 bits. Socket is probably closed.");
+        return false; // seems like on windows this may indicate "socket closed"
+    }
+    if(bcount < 0) {
 #ifdef  WIN32
         int errcode=WSAGetLastError();
         if(errcode==WSAECONNRESET)
@@ -155,6 +353,7 @@ bool TLMCommUtil::ReceiveMessage(TLMMessage& mess) {
         TLMCommUtil::ByteSwap(&mess.Header.DataSize, sizeof(mess.Header.DataSize));
         TLMCommUtil::ByteSwap(&mess.Header.TLMInterfaceID, sizeof(mess.Header.TLMInterfaceID));
     }
+    trace.SetID(mess.Header.TLMInterfaceID);
     if(mess.Header.DataSize < 0) {
         TLMErrorLog::FatalError("Negative size of data in TLM message. Protocol error.");
     }
@@ -164,16 +363,15 @@ bool TLMCommUtil::ReceiveMessage(TLMMessage& mess) {
         if(mess.Data.size() < mess.Header.DataSize) {
             mess.Data.resize(mess.Header.DataSize);
         }
-        bcount = recv(mess.SocketHandle,(char*)&(mess.Data[0]), mess.Header.DataSize,  MSG_WAITALL);
-        while((bcount >= 0) && (bcount <  mess.Header.DataSize)) {
-            // this should never happen, but it does...
-            TLMErrorLog::Warning("Could not receive the TLM data, will try again");
-            bcount += recv(mess.SocketHandle,
-                           (char*)&(mess.Data[0]) + bcount,
-                    mess.Header.DataSize - bcount,
-                    MSG_WAITALL);
+        if(shm) {
+            if(!shm->ReceiveData(&mess.Data[0], mess.Header.DataSize)) {
+                TLMErrorLog::Warning("Shared memory peer is gone while receiving data.");
+                return false;
+            }
+            return true;
         }
-        if(bcount == -1) {
+        bcount = ReceiveBytes(mess.SocketHandle, (char*)&(mess.Data[0]), mess.Header.DataSize);
+        if(bcount <= 0) {
 
 #ifdef  WIN32
             int errcode=WSAGetLastError();
@@ -193,3 +391,224 @@ bool TLMCommUtil::ReceiveMessage(TLMMessage& mess) {
     return true;
 }
 
+
+// Wire encoding of 3D time data. Each sample is written field by field:
+// time, position, orientation, velocity and waves. With TLM_ENC_DELTA_TIME
+// the time of the first sample is a double and the others are float offsets
+// from it, so rounding errors do not add up over the message.
+
+void TLMCommUtil::MatrixToQuaternion(const double* A, double* q) {
+    double tr = A[0] + A[4] + A[8];
+    if(tr > 0) {
+        double s = 2.0 * sqrt(tr + 1.0);
+        q[0] = 0.25 * s;
+        q[1] = (A[7] - A[5]) / s;
+        q[2] = (A[2] - A[6]) / s;
+        q[3] = (A[3] - A[1]) / s;
+    }
+    else if(A[0] > A[4] && A[0] > A[8]) {
+        double s = 2.0 * sqrt(1.0 + A[0] - A[4] - A[8]);
+        q[0] = (A[7] - A[5]) / s;
+        q[1] = 0.25 * s;
+        q[2] = (A[1] + A[3]) / s;
+        q[3] = (A[2] + A[6]) / s;
+    }
+    else if(A[4] > A[8]) {
+        double s = 2.0 * sqrt(1.0 + A[4] - A[0] - A[8]);
+        q[0] = (A[2] - A[6]) / s;
+        q[1] = (A[1] + A[3]) / s;
+        q[2] = 0.25 * s;
+        q[3] = (A[5] + A[7]) / s;
+    }
+    else {
+        double s = 2.0 * sqrt(1.0 + A[8] - A[0] - A[4]);
+        q[0] = (A[3] - A[1]) / s;
+        q[1] = (A[2] + A[6]) / s;
+        q[2] = (A[5] + A[7]) / s;
+        q[3] = 0.25 * s;
+    }
+}
+
+void TLMCommUtil::QuaternionToMatrix(const double* qIn, double* A) {
+    double n = sqrt(qIn[0]*qIn[0] + qIn[1]*qIn[1] + qIn[2]*qIn[2] + qIn[3]*qIn[3]);
+    if(n == 0.0) n = 1.0;
+    double w = qIn[0]/n, x = qIn[1]/n, y = qIn[2]/n, z = qIn[3]/n;
+
+    A[0] = 1 - 2*(y*y + z*z);  A[1] = 2*(x*y - z*w);      A[2] = 2*(x*z + y*w);
+    A[3] = 2*(x*y + z*w);      A[4] = 1 - 2*(x*x + z*z);  A[5] = 2*(y*z - x*w);
+    A[6] = 2*(x*z - y*w);      A[7] = 2*(y*z + x*w);      A[8] = 1 - 2*(x*x + y*y);
+}
+
+//! Write doubles, as floats if "asFloat" is set.
+static void PutValues(unsigned char*& out, const double* v, int n, bool asFloat) {
+    for(int i = 0; i < n; i++) {
+        if(asFloat) {
+            float f = (float)v[i];
+            memcpy(out, &f, sizeof(f));
+            out += sizeof(f);
+        }
+        else {
+            memcpy(out, &v[i], sizeof(double));
+            out += sizeof(double);
+        }
+    }
+}
+
+//! Read doubles written by PutValues.
+static void GetValues(const unsigned char*& in, double* v, int n, bool asFloat, bool swapBytes) {
+    for(int i = 0; i < n; i++) {
+        if(asFloat) {
+            float f;
+            memcpy(&f, in, sizeof(f));
+            if(swapBytes) TLMCommUtil::ByteSwap(&f, sizeof(f));
+            v[i] = f;
+            in += sizeof(f);
+        }
+        else {
+            memcpy(&v[i], in, sizeof(double));
+            if(swapBytes) TLMCommUtil::ByteSwap(&v[i], sizeof(double));
+            in += sizeof(double);
+        }
+    }
+}
+
+//! Size in bytes of one sample, not counting the time stamp.
+static int SampleSize3D(int encoding) {
+    return ((encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_POSITION) ? 3*sizeof(float) : 3*sizeof(double))
+            + ((encoding & TLMWireEncodingConst::TLM_ENC_QUATERNION) ? 4*sizeof(double) : 9*sizeof(double))
+            + ((encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_VELOCITY) ? 6*sizeof(float) : 6*sizeof(double))
+            + ((encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_WAVE) ? 6*sizeof(float) : 6*sizeof(double));
+}
+
+void TLMCommUtil::EncodeTimeData3D(const TLMTimeData3D* data, int count, int encoding,
+                                   std::vector<unsigned char>& out) {
+    bool delta = (encoding & TLMWireEncodingConst::TLM_ENC_DELTA_TIME) != 0;
+
+    int size = count * (SampleSize3D(encoding) + (delta ? sizeof(float) : sizeof(double)));
+    if(delta && count > 0) size += sizeof(double) - sizeof(float);
+    out.resize(size);
+    if(size == 0) return;
+
+    unsigned char* dst = &out[0];
+    for(int i = 0; i < count; i++) {
+        const TLMTimeData3D& td = data[i];
+        if(delta && i > 0) {
+            double dt = td.time - data[0].time;
+            PutValues(dst, &dt, 1, true);
+        }
+        else {
+            PutValues(dst, &td.time, 1, false);
+        }
+
+        PutValues(dst, td.Position, 3, (encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_POSITION) != 0);
+
+        if(encoding & TLMWireEncodingConst::TLM_ENC_QUATERNION) {
+            double q[4];
+            MatrixToQuaternion(td.RotMatrix, q);
+            PutValues(dst, q, 4, false);
+        }
+        else {
+            PutValues(dst, td.RotMatrix, 9, false);
+        }
+
+        PutValues(dst, td.Velocity, 6, (encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_VELOCITY) != 0);
+        PutValues(dst, td.GenForce, 6, (encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_WAVE) != 0);
+    }
+}
+
+bool TLMCommUtil::DecodeTimeData3D(const unsigned char* in, int size, int encoding, bool swapBytes,
+                                   std::vector<TLMTimeData3D>& out) {
+    bool delta = (encoding & TLMWireEncodingConst::TLM_ENC_DELTA_TIME) != 0;
+    int sampleSize = SampleSize3D(encoding) + (delta ? sizeof(float) : sizeof(double));
+    int extra = delta ? sizeof(double) - sizeof(float) : 0;
+
+    if(size <= 0) return size == 0;
+    if(size < extra || (size - extra) % sampleSize != 0) return false;
+    int count = (size - extra) / sampleSize;
+
+    size_t first = out.size();
+    out.resize(first + count);
+    for(int i = 0; i < count; i++) {
+        TLMTimeData3D& td = out[first + i];
+        if(delta && i > 0) {
+            double dt;
+            GetValues(in, &dt, 1, true, swapBytes);
+            td.time = out[first].time + dt;
+        }
+        else {
+            GetValues(in, &td.time, 1, false, swapBytes);
+        }
+
+        GetValues(in, td.Position, 3, (encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_POSITION) != 0, swapBytes);
+
+        if(encoding & TLMWireEncodingConst::TLM_ENC_QUATERNION) {
+            double q[4];
+            GetValues(in, q, 4, false, swapBytes);
+            QuaternionToMatrix(q, td.RotMatrix);
+        }
+        else {
+            GetValues(in, td.RotMatrix, 9, false, swapBytes);
+        }
+
+        GetValues(in, td.Velocity, 6, (encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_VELOCITY) != 0, swapBytes);
+        GetValues(in, td.GenForce, 6, (encoding & TLMWireEncodingConst::TLM_ENC_FLOAT_WAVE) != 0, swapBytes);
+    }
+    return true;
+}
+
+void TLMCommUtil::InitBundle(TLMMessage& bundle, char type) {
+    bundle.Header = TLMMessageHeader();
+    bundle.Header.MessageType = type;
+    bundle.Header.DataSize = 0;
+    bundle.SharedData.reset();
+}
+
+// The headers in a bundle are stored in the byte order of their source
+// system, as they would be on the wire.
+void TLMCommUtil::AddToBundle(TLMMessage& bundle, const TLMMessage& mess) {
+    TLMMessageHeader header = mess.Header;
+    int DataSize = header.DataSize;
+    if(TLMMessageHeader::IsBigEndianSystem != header.SourceIsBigEndianSystem) {
+        ByteSwap(&header.DataSize, sizeof(header.DataSize));
+        ByteSwap(&header.TLMInterfaceID, sizeof(header.TLMInterfaceID));
+    }
+
+    size_t pos = bundle.Header.DataSize;
+    bundle.Data.resize(pos + sizeof(TLMMessageHeader) + DataSize);
+    memcpy(&bundle.Data[pos], &header, sizeof(TLMMessageHeader));
+    if(DataSize > 0) {
+        memcpy(&bundle.Data[pos + sizeof(TLMMessageHeader)], mess.GetPayload(), DataSize);
+    }
+    bundle.Header.DataSize = pos + sizeof(TLMMessageHeader) + DataSize;
+}
+
+bool TLMCommUtil::GetBundleEntry(const TLMMessage& bundle, size_t& offset, TLMMessage& out) {
+    size_t size = bundle.Header.DataSize;
+    if(offset >= size) return false;
+
+    if(offset + sizeof(TLMMessageHeader) > size) {
+        TLMErrorLog::FatalError("Truncated message in bundle. Protocol error.");
+        return false;
+    }
+    const unsigned char* in = bundle.GetPayload() + offset;
+    memcpy(&out.Header, in, sizeof(TLMMessageHeader));
+    if(TLMMessageHeader::IsBigEndianSystem != out.Header.SourceIsBigEndianSystem) {
+        ByteSwap(&out.Header.DataSize, sizeof(out.Header.DataSize));
+        ByteSwap(&out.Header.TLMInterfaceID, sizeof(out.Header.TLMInterfaceID));
+    }
+    if(out.Header.DataSize < 0 || offset + sizeof(TLMMessageHeader) + out.Header.DataSize > size) {
+        TLMErrorLog::FatalError("Wrong data size in bundle. Protocol error.");
+        return false;
+    }
+
+    out.SharedData.reset();
+    out.SocketHandle = bundle.SocketHandle;
+    if(out.Header.DataSize > 0) {
+        if(out.Data.size() < size_t(out.Header.DataSize)) {
+            out.Data.resize(out.Header.DataSize);
+        }
+        memcpy(&out.Data[0], in + sizeof(TLMMessageHeader), out.Header.DataSize);
+    }
+    offset += sizeof(TLMMessageHeader) + out.Header.DataSize;
+    return true;
+}
@@ -11,7 +11,9 @@
 #define TLMCommUtil_h_
 
 #include <vector>
+#include <memory>
 #include <cstring>
+#include <string>
 
 #include "Communication/TLMCalcData.h"
 
@@ -57,6 +59,17 @@ struct TLMMessageTypeConst {
     static const char TLM_CLOSE_REQUEST = 7;
     //! Close permission accepted
     static const char TLM_CLOSE_PERMISSION = 8;
+    //! Shared memory transport accepted by the client (always sent on the socket)
+    static const char TLM_REG_SHM = 9;
+    //! First message on a direct link between two clients,
+    //! TLMInterfaceID holds the component ID of the caller.
+    static const char TLM_DIRECT_LINK = 10;
+    //! Time stamped data of several interfaces. The data is a sequence of
+    //! complete TLM_TIME_DATA messages, each a header followed by its data.
+    static const char TLM_TIME_DATA_BUNDLE = 11;
+    //! Several TLM_REG_INTERFACE and TLM_REG_PARAMETER requests in the layout
+    //! of TLM_TIME_DATA_BUNDLE. The reply holds the replies in the same order.
+    static const char TLM_REG_BATCH = 12;
 };
 
 //! Message header used in all the messages sent between
@@ -94,10 +107,46 @@ struct TLMMessageHeader {
     //! Source interface ID (not used for registration messages)
     int  TLMInterfaceID;
 
-    //! Source parameter ID (not used for registration messages)
+    //! Source parameter ID (not used for registration messages).
+    //! In TLM_REG_INTERFACE requests and TLM_TIME_DATA messages it carries
+    //! the wire encoding flags instead, see TLMWireEncodingConst.
     int ComponentParameterID;
 };
 
+//! TLMWireEncodingConst lists the flags of the compact encoding of 3D time data.
+//! A client lists the flags it can decode in its interface registration, the
+//! manager grants an encoding per interface in TLMConnectionParams::Encoding.
+//! Every time data message tells its own encoding, so any receiver that
+//! knows the flags (including the monitors) can decode it.
+struct TLMWireEncodingConst {
+    //! Orientation as a unit quaternion (4 doubles) instead of the 3x3 matrix
+    static const int TLM_ENC_QUATERNION = 1;
+    //! Position as float32
+    static const int TLM_ENC_FLOAT_POSITION = 2;
+    //! Velocities as float32
+    static const int TLM_ENC_FLOAT_VELOCITY = 4;
+    //! Force waves as float32
+    static const int TLM_ENC_FLOAT_WAVE = 8;
+    //! Time stamps after the first one as float32 offsets from it
+    static const int TLM_ENC_DELTA_TIME = 16;
+    //! All the flags above
+    static const int TLM_ENC_ALL = 31;
+    //! Not an encoding of the data: the client accepts TLM_TIME_DATA_BUNDLE
+    //! messages. Granted if the manager accepts them from the client.
+    static const int TLM_ENC_BUNDLE = 32;
+    //! Not an encoding of the data: set by the manager in the component
+    //! registration reply if it accepts TLM_REG_BATCH messages.
+    static const int TLM_ENC_REG_BATCH = 64;
+    //! Not an encoding of the data: the client understands
+    //! TLMConnectionParams::Interpolation.
+    static const int TLM_ENC_INTERPOLATION = 128;
+    //! Tag in the upper bits of the header field, tells the flags from
+    //! whatever older peers leave in it.
+    static const int TLM_ENC_TAG = 0x454E0000;
+    //! Mask for the tag
+    static const int TLM_ENC_TAG_MASK = 0x7FFF0000;
+};
+
 //! TLMMessage structure is used to encapsulate all the TLM messages
 struct TLMMessage {
     //! source/destination socket
@@ -109,12 +158,32 @@ struct TLMMessage {
     //! Data array (contents depends on the message type)
     std::vector<unsigned char> Data;
 
+    //! Immutable payload shared by several messages, e.g., the copies
+    //! forwarded to the monitors. If set it is sent instead of Data.
+    std::shared_ptr<const std::vector<unsigned char> > SharedData;
+
     //! Constructor, initializes all attributes.
     TLMMessage()
         : SocketHandle(-1)
         , Header()
         , Data()
+        , SharedData()
     {}
+
+    //! Move the contents of Data to a shared payload, so that other
+    //! messages can reference it without copying.
+    void SharePayload() {
+        if(SharedData) return;
+        std::shared_ptr<std::vector<unsigned char> > payload = std::make_shared<std::vector<unsigned char> >();
+        payload->swap(Data);
+        SharedData = payload;
+    }
+
+    //! Get the payload to be sent, NULL if there is none.
+    const unsigned char* GetPayload() const {
+        const std::vector<unsigned char>& d = SharedData ? *SharedData : Data;
+        return d.empty() ? NULL : &d[0];
+    }
 };
 
 
@@ -147,13 +216,85 @@ public:
     //! \param  items - number of data items to be proccessed
     inline static void ByteSwap(void * Buff, size_t type_size, size_t items = 1);
 
-    //! Send the TLMMessage pointed by mess via socket with handle SocketHandle
+    //! Send the TLMMessage pointed by mess via socket with handle SocketHandle.
+    //! Header and data are sent with a single system call.
+    //! If a shared memory channel is attached to the socket it is used instead.
     static void SendMessage(TLMMessage& mess);
 
+    //! Send count messages that all go to the same socket. The headers and
+    //! data of all the messages are passed to one system call.
+    static void SendMessages(TLMMessage** mess, int count);
+
+    //! Prepare a newly connected socket: disable Nagle's algorithm
+    //! (TCP_NODELAY) on TCP sockets so that small messages go out immediately
+    //! and drop any buffered data left from a closed socket with the same handle.
+    static void PrepareSocket(int socket);
+
+    //! Get the socket path of a server address in the form unix:\<path>,
+    //! used for a Unix domain socket instead of \<host>:\<port>.
+    //! Returns an empty string for other addresses.
+    static std::string GetUnixSocketPath(const std::string& address) {
+        if(address.compare(0, 5, "unix:") != 0) return std::string();
+        return address.substr(5);
+    }
+
+    //! Check if data read ahead from the socket is waiting in the receive
+    //! buffer. Such data is not reported by select/epoll.
+    static bool HasBufferedData(int socket);
+
+    //! Get the wire encoding flags stored in the message header,
+    //! 0 if the data is plain doubles.
+    static int GetEncoding(const TLMMessageHeader& header) {
+        if((header.ComponentParameterID & TLMWireEncodingConst::TLM_ENC_TAG_MASK) != TLMWireEncodingConst::TLM_ENC_TAG) {
+            return 0;
+        }
+        return header.ComponentParameterID & (TLMWireEncodingConst::TLM_ENC_ALL
+                                              | TLMWireEncodingConst::TLM_ENC_BUNDLE
+                                              | TLMWireEncodingConst::TLM_ENC_REG_BATCH
+                                              | TLMWireEncodingConst::TLM_ENC_INTERPOLATION);
+    }
+
+    //! Store the wire encoding flags in the message header.
+    static void SetEncoding(TLMMessageHeader& header, int encoding) {
+        header.ComponentParameterID = encoding ? (TLMWireEncodingConst::TLM_ENC_TAG | encoding) : 0;
+    }
+
+    //! Convert a row-wise rotation matrix to a unit quaternion (w, x, y, z).
+    static void MatrixToQuaternion(const double* A, double* q);
+
+    //! Convert a quaternion (w, x, y, z) to a row-wise rotation matrix.
+    //! The quaternion does not need to be normalized.
+    static void QuaternionToMatrix(const double* q, double* A);
+
+    //! Encode count 3D time data samples with the given encoding flags.
+    //! The result replaces the contents of "out".
+    static void EncodeTimeData3D(const TLMTimeData3D* data, int count, int encoding,
+                                 std::vector<unsigned char>& out);
+
+    //! Decode 3D time data samples encoded by EncodeTimeData3D and append
+    //! them to "out". Byte order is switched if "swapBytes" is set.
+    //! Returns false if the size does not match the encoding.
+    static bool DecodeTimeData3D(const unsigned char* in, int size, int encoding, bool swapBytes,
+                                 std::vector<TLMTimeData3D>& out);
+
+    //! Make "bundle" an empty TLM_TIME_DATA_BUNDLE or TLM_REG_BATCH message.
+    static void InitBundle(TLMMessage& bundle, char type = TLMMessageTypeConst::TLM_TIME_DATA_BUNDLE);
+
+    //! Append the header and data of a message to a bundle.
+    static void AddToBundle(TLMMessage& bundle, const TLMMessage& mess);
+
+    //! Get the message at "offset" in a bundle and move the offset to the
+    //! next one. The header of "out" is in host byte order as after
+    //! ReceiveMessage. Returns false if there are no more messages.
+    static bool GetBundleEntry(const TLMMessage& bundle, size_t& offset, TLMMessage& out);
+
     //! Basic receive of a TLMMessage. Insures correct signature and
     //! fixes byte order for the message header if necessary.
     //! Note that the actual message data is not processed, just received,
     //! Returns 'true' on success, 'false' if socket is closed, aborts on error.
+    //! Small messages are read through a per socket buffer, so several
+    //! messages can arrive with one system call.
+    //! If a shared memory channel is attached to the socket it is used instead.
     static bool ReceiveMessage(TLMMessage& mess);
 
 };
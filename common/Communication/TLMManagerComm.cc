@@ -4,18 +4,31 @@
 * Implementation of classes used for communication with client apps by TLMManager
 */
 #include "Communication/TLMManagerComm.h"
+#include "Communication/TLMCommUtil.h"
+#include "Communication/TLMShmTransport.h"
 #include "Logging/TLMErrorLog.h"
 #include <cassert>
 #include <cstring>
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <atomic>
 
 using std::vector;
 using std::string;
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define TLM_USE_EPOLL
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE 0
+#endif
+#endif
+
 #ifndef WIN32
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -30,11 +43,56 @@ using std::string;
 #define BCloseSocket closesocket
 #endif
 
+//! Client sockets served by one thread in sharded running mode.
+struct TLMSocketShard {
+    //! Epoll set with the sockets, the wake up handle and the doorbell
+    int EventHandle;
+
+    //! Event handle written by WakeShard, -1 if not available
+    int WakeHandle;
+
+    //! Sockets of the shard that have a shared memory channel attached
+    std::vector<int> ShmSockets;
+
+    //! Ready sockets that still had data after the last read
+    std::vector<TLMReadySocket> CarryOver;
+
+    //! Set by PrepareWait, cleared by the first WakeShard or when the wait is over
+    std::atomic<int> Sleeping;
+
+    TLMSocketShard() : EventHandle(-1), WakeHandle(-1), ShmSockets(), CarryOver(), Sleeping(0) {}
+};
+
+TLMManagerComm::~TLMManagerComm() {
+    CloseShards();
+    for(std::vector<TLMSocketShard*>::iterator it = Shards.begin(); it != Shards.end(); ++it) {
+        delete *it;
+    }
+    for(std::vector<TLMShmChannel*>::iterator it = ShmChannels.begin(); it != ShmChannels.end(); ++it) {
+        delete *it;
+    }
+    delete ShmSegment;
+    RemoveUnixSocket();
+}
+
+void TLMManagerComm::RemoveUnixSocket() {
+#ifndef WIN32
+    if(!UnixSocketPath.empty() && ContactSocket != -1) {
+        unlink(UnixSocketPath.c_str());
+        UnixSocketPath.clear();
+    }
+#endif
+}
+
 // CreateServerSocket create a server TCP/IP socket
 // and start listening. Returns the socket ID.
 int TLMManagerComm::CreateServerSocket() {
     assert(ContactSocket == -1);
 
+    if(!UnixSocketPath.empty()) {
+        return CreateUnixServerSocket();
+    }
+
     struct sockaddr_in sa;  // My socket addr.
 
 #ifdef WIN32
@@ -98,10 +156,62 @@ int TLMManagerComm::CreateServerSocket() {
 
     TLMErrorLog::Info(string("TLM manager is listening on port ") + TLMErrorLog::ToStdStr(ServerPort));
 
+    if(UseSharedMemory) {
+        // Offered to the clients at registration, they fall back to the socket if they can't use it.
+        ShmSegment = TLMShmSegment::Create(NumClients, ServerPort);
+    }
+
     return theSckt;
 }
 
 
+// CreateUnixServerSocket creates a Unix domain server socket on UnixSocketPath.
+// There is no port probing, a stale socket file left by a crashed
+// manager is removed.
+int TLMManagerComm::CreateUnixServerSocket() {
+#ifndef WIN32
+    struct sockaddr_un sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if(UnixSocketPath.size() >= sizeof(sa.sun_path)) {
+        TLMErrorLog::FatalError("Create server socket - socket path too long: " + UnixSocketPath);
+        return -1;
+    }
+    strcpy(sa.sun_path, UnixSocketPath.c_str());
+
+    int theSckt = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(theSckt < 0) {
+        TLMErrorLog::FatalError("Create server socket - failed to get a socket handle");
+        return -1;
+    }
+
+    unlink(UnixSocketPath.c_str());
+    if(bind(theSckt, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        BCloseSocket(theSckt);
+        TLMErrorLog::FatalError("Create server socket - failed to bind to " + UnixSocketPath);
+        return -1;
+    }
+
+    if(listen(theSckt, NumClients) != 0) {
+        BCloseSocket(theSckt);
+        TLMErrorLog::FatalError("Crate server socket - failed in listen on the server socket.");
+    }
+
+    ContactSocket = theSckt;
+
+    TLMErrorLog::Info(string("TLM manager is listening on ") + UnixSocketPath);
+
+    if(UseSharedMemory) {
+        ShmSegment = TLMShmSegment::Create(NumClients, ServerPort);
+    }
+
+    return theSckt;
+#else
+    TLMErrorLog::FatalError("Unix domain sockets are not supported on this platform");
+    return -1;
+#endif
+}
+
 void TLMManagerComm::SelectReadSocket() {
 
     int maxFD = -1;
@@ -115,28 +225,117 @@ void TLMManagerComm::SelectReadSocket() {
 
     assert(maxFD > 0); // assert that at least one socket needs to be checked
 
+    // Data already in the receive buffers is not seen by select.
+    bool pending = false;
+    for(vector<int>::iterator it = ActiveSockets.begin(); it != ActiveSockets.end() && !pending; it++) {
+        pending = TLMCommUtil::HasBufferedData(*it);
+    }
+
+    // Shared memory channels do not wake up select, the clients write
+    // to the doorbell instead if we announce that we are about to sleep.
+    bool shmActive = (ShmSegment != 0) && !ShmSockets.empty();
+    if(shmActive) {
+        ShmSegment->SetManagerWaiting(true);
+        for(vector<int>::iterator it = ActiveSockets.begin(); it != ActiveSockets.end() && !pending; it++) {
+            TLMShmChannel* shm = TLMShmChannel::Find(*it);
+            pending = (shm != 0) && shm->HasData();
+        }
+        int bell = ShmSegment->GetDoorbellHandle();
+        FD_SET(bell, &CurFDSet);
+        if(bell > maxFD) {
+            maxFD = bell;
+        }
+    }
+
     struct timeval tv;
 
     // sock is an intialized socket handle
 
     tv.tv_sec = 0;
 
-    tv.tv_usec = 500000;
+    tv.tv_usec = pending ? 0 : 500000;
 
     /* wait 10 seconds for any data to be read from any single socket */
 
     select(maxFD + 1, &CurFDSet, NULL, NULL, &tv);
+
+    if(shmActive) {
+        ShmSegment->SetManagerWaiting(false);
+        if(FD_ISSET(ShmSegment->GetDoorbellHandle(), &CurFDSet)) {
+            ShmSegment->ClearDoorbell();
+        }
+    }
 }
 
 
 // Check if the data is pending to be read on the specified socket
 // Should be called after SelectReadSocket
 bool TLMManagerComm::HasData(int socket) {
-    bool ret = FD_ISSET(socket, &CurFDSet);
+    bool ret = FD_ISSET(socket, &CurFDSet) || TLMCommUtil::HasBufferedData(socket);
     //    if(ret) FD_CLR(socket, &CurFDSet);
+    if(!ret && !ShmSockets.empty()) {
+        TLMShmChannel* shm = TLMShmChannel::Find(socket);
+        ret = (shm != 0) && shm->HasData();
+    }
     return ret;
 }
 
+std::string TLMManagerComm::GetSharedMemoryOffer(int slot) const {
+    if(ShmSegment == 0 || slot < 0 || slot >= ShmSegment->GetNumSlots()) {
+        return string();
+    }
+    return ShmSegment->GetOffer(slot);
+}
+
+bool TLMManagerComm::AttachSharedMemory(int socket, int slot) {
+    if(ShmSegment == 0 || slot < 0 || slot >= ShmSegment->GetNumSlots()) {
+        return false;
+    }
+    TLMShmChannel* shm = new TLMShmChannel(*ShmSegment, slot, socket, true);
+    if(!TLMShmChannel::Attach(socket, shm)) {
+        delete shm;
+        return false;
+    }
+    ShmChannels.push_back(shm);
+    ShmSockets.push_back(socket);
+    return true;
+}
+
+void TLMManagerComm::UnlinkSharedMemory() {
+    if(ShmSegment) {
+        ShmSegment->Unlink();
+    }
+}
+
+void TLMManagerComm::DetachSharedMemory(int socket) {
+    vector<int>::iterator it = std::find(ShmSockets.begin(), ShmSockets.end(), socket);
+    if(it != ShmSockets.end()) {
+        TLMShmChannel::Detach(socket);
+        ShmSockets.erase(it);
+    }
+}
+
+std::string TLMManagerComm::GetPeerHost(int socket) const {
+    struct sockaddr_storage sa;
+#ifndef WIN32
+    socklen_t len = sizeof(sa);
+#else
+    int len = sizeof(sa);
+#endif
+    if(getpeername(socket, (struct sockaddr*)&sa, &len) != 0) {
+        return string();
+    }
+#ifndef WIN32
+    if(sa.ss_family == AF_UNIX) {
+        return string("127.0.0.1"); // the peer runs on this host
+    }
+#endif
+    if(sa.ss_family != AF_INET) {
+        return string();
+    }
+    return string(inet_ntoa(((struct sockaddr_in*)&sa)->sin_addr));
+}
+
 // Switch from startup mode, when
 void TLMManagerComm::SwitchToRunningMode() {
     assert(StartupMode == true);
@@ -144,6 +343,328 @@ void TLMManagerComm::SwitchToRunningMode() {
 
     ActiveSockets.clear();
     ActiveSockets = ClientSockets;
+
+#ifdef TLM_USE_EPOLL
+    EventHandle = epoll_create1(0);
+    if(EventHandle < 0) {
+        TLMErrorLog::Warning("Failed to create epoll set, using select");
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    for(vector<int>::iterator it = ActiveSockets.begin(); it != ActiveSockets.end(); it++) {
+        ev.data.fd = *it;
+        if(epoll_ctl(EventHandle, EPOLL_CTL_ADD, *it, &ev) != 0) {
+            TLMErrorLog::Warning("Failed to add socket to epoll set, using select");
+            BCloseSocket(EventHandle);
+            EventHandle = -1;
+            return;
+        }
+    }
+
+    if(ShmSegment) {
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.fd = ShmSegment->GetDoorbellHandle();
+        epoll_ctl(EventHandle, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    }
+#endif
+}
+
+void TLMManagerComm::SetSocketComponent(int socket, int compIndex) {
+    if(socket < 0) return;
+    if(socket >= (int)SocketComponent.size()) {
+        SocketComponent.resize(socket + 1, -1);
+    }
+    SocketComponent[socket] = compIndex;
+}
+
+void TLMManagerComm::AddReady(int socket, std::vector<TLMReadySocket>& ready) {
+    if(socket >= (int)InReadyList.size()) {
+        InReadyList.resize(socket + 1, 0);
+    }
+    if(InReadyList[socket]) return;
+    InReadyList[socket] = 1;
+
+    TLMReadySocket rs;
+    rs.Socket = socket;
+    rs.ComponentIndex = (socket < (int)SocketComponent.size()) ? SocketComponent[socket] : -1;
+    ready.push_back(rs);
+}
+
+// Running mode wait. With epoll only the sockets with events are visited,
+// the shared memory channels are checked without system calls.
+void TLMManagerComm::SelectReadySockets(std::vector<TLMReadySocket>& ready) {
+    for(vector<TLMReadySocket>::iterator it = ready.begin(); it != ready.end(); ++it) {
+        InReadyList[it->Socket] = 0;
+    }
+    ready.clear();
+    for(vector<TLMReadySocket>::iterator it = CarryOver.begin(); it != CarryOver.end(); ++it) {
+        AddReady(it->Socket, ready);
+    }
+    CarryOver.clear();
+
+    if(EventHandle < 0) {
+        SelectReadSocket();
+        for(vector<int>::iterator it = ActiveSockets.begin(); it != ActiveSockets.end(); it++) {
+            if(HasData(*it)) {
+                AddReady(*it, ready);
+            }
+        }
+        return;
+    }
+
+#ifdef TLM_USE_EPOLL
+    // Announce the wait before checking the rings, see SelectReadSocket.
+    bool shmActive = (ShmSegment != 0) && !ShmSockets.empty();
+    if(shmActive) {
+        ShmSegment->SetManagerWaiting(true);
+        for(vector<int>::iterator it = ShmSockets.begin(); it != ShmSockets.end(); it++) {
+            if(TLMShmChannel::Find(*it)->HasData()) {
+                AddReady(*it, ready);
+            }
+        }
+    }
+
+    const int maxEvents = 64;
+    struct epoll_event events[maxEvents];
+    int nEvents = epoll_wait(EventHandle, events, maxEvents, ready.empty() ? 500 : 0);
+
+    bool doorbell = false;
+    for(int i = 0; i < nEvents; i++) {
+        int socket = events[i].data.fd;
+        if(ShmSegment && socket == ShmSegment->GetDoorbellHandle()) {
+            doorbell = true;
+            continue;
+        }
+        if(events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            if(socket >= (int)HungUp.size()) {
+                HungUp.resize(socket + 1, 0);
+            }
+            HungUp[socket] = 1;
+        }
+        AddReady(socket, ready);
+    }
+
+    if(shmActive) {
+        ShmSegment->SetManagerWaiting(false);
+        if(doorbell) {
+            ShmSegment->ClearDoorbell();
+            for(vector<int>::iterator it = ShmSockets.begin(); it != ShmSockets.end(); it++) {
+                if(TLMShmChannel::Find(*it)->HasData()) {
+                    AddReady(*it, ready);
+                }
+            }
+        }
+    }
+#endif
+}
+
+// The epoll set is edge-triggered, so a socket that still has data
+// (or was closed by the peer) must be visited again without a new event.
+void TLMManagerComm::ReadDone(const TLMReadySocket& sock) {
+    if(EventHandle < 0) return; // select is level-triggered
+
+    if(MoreData(sock.Socket)) {
+        CarryOver.push_back(sock);
+    }
+}
+
+bool TLMManagerComm::MoreData(int socket) {
+#ifdef TLM_USE_EPOLL
+    if((socket < (int)HungUp.size()) && HungUp[socket]) {
+        return true;
+    }
+    TLMShmChannel* shm = TLMShmChannel::Find(socket);
+    if(shm) {
+        return shm->HasData();
+    }
+    if(TLMCommUtil::HasBufferedData(socket)) {
+        return true;
+    }
+    char c;
+    return (recv(socket, &c, 1, MSG_PEEK | MSG_DONTWAIT) >= 0);
+#else
+    return false;
+#endif
+}
+
+// Each shard gets its own epoll set with its sockets, an event handle used
+// to wake it up and the shared memory doorbell. The doorbell is added with
+// EPOLLEXCLUSIVE so that a ring wakes up one shard, which passes the news on.
+bool TLMManagerComm::SwitchToShardedMode(int numShards) {
+    assert(StartupMode == true);
+
+#ifdef TLM_USE_EPOLL
+    // The flags are indexed by the handle, size them now since
+    // the shard threads must not reallocate them.
+    int maxSocket = 0;
+    for(vector<int>::iterator it = ClientSockets.begin(); it != ClientSockets.end(); it++) {
+        if(*it > maxSocket) maxSocket = *it;
+    }
+    SocketShard.assign(maxSocket + 1, -1);
+    if((int)InReadyList.size() <= maxSocket) InReadyList.resize(maxSocket + 1, 0);
+    if((int)HungUp.size() <= maxSocket) HungUp.resize(maxSocket + 1, 0);
+    if((int)SocketComponent.size() <= maxSocket) SocketComponent.resize(maxSocket + 1, -1);
+
+    bool ok = true;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    for(int i = 0; i < numShards && ok; i++) {
+        TLMSocketShard* shard = new TLMSocketShard;
+        Shards.push_back(shard);
+
+        shard->EventHandle = epoll_create1(0);
+        shard->WakeHandle = eventfd(0, EFD_NONBLOCK);
+        ev.events = EPOLLIN;
+        ev.data.fd = shard->WakeHandle;
+        ok = shard->EventHandle >= 0 && shard->WakeHandle >= 0
+                && epoll_ctl(shard->EventHandle, EPOLL_CTL_ADD, shard->WakeHandle, &ev) == 0;
+
+        if(ok && ShmSegment) {
+            ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+            ev.data.fd = ShmSegment->GetDoorbellHandle();
+            ok = epoll_ctl(shard->EventHandle, EPOLL_CTL_ADD, ev.data.fd, &ev) == 0;
+        }
+    }
+
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    for(vector<int>::iterator it = ClientSockets.begin(); it != ClientSockets.end() && ok; it++) {
+        int comp = SocketComponent[*it];
+        int shardIdx = (comp < 0) ? 0 : comp % numShards;
+        TLMSocketShard* shard = Shards[shardIdx];
+
+        ev.data.fd = *it;
+        ok = epoll_ctl(shard->EventHandle, EPOLL_CTL_ADD, *it, &ev) == 0;
+
+        SocketShard[*it] = shardIdx;
+        if(std::find(ShmSockets.begin(), ShmSockets.end(), *it) != ShmSockets.end()) {
+            shard->ShmSockets.push_back(*it);
+        }
+    }
+
+    if(ok) {
+        StartupMode = false;
+        ActiveSockets.clear();
+        ActiveSockets = ClientSockets;
+        TLMErrorLog::Info("Client sockets split into " + TLMErrorLog::ToStdStr(numShards) + " shards");
+        return true;
+    }
+
+    TLMErrorLog::Warning("Failed to create the socket shards, using one reader");
+    CloseShards();
+    for(std::vector<TLMSocketShard*>::iterator it = Shards.begin(); it != Shards.end(); ++it) {
+        delete *it;
+    }
+    Shards.clear();
+    SocketShard.clear();
+#endif
+
+    SwitchToRunningMode();
+    return false;
+}
+
+void TLMManagerComm::PrepareWait(int shard) {
+    Shards[shard]->Sleeping.store(1);
+}
+
+// Sharded running mode wait. The shards share the shared memory doorbell:
+// the shard that clears it re-arms it for the shards still waiting and
+// wakes up the ones with data in their rings.
+void TLMManagerComm::SelectReadySockets(int shard, std::vector<TLMReadySocket>& ready, bool pending) {
+    TLMSocketShard& sh = *Shards[shard];
+
+    for(vector<TLMReadySocket>::iterator it = ready.begin(); it != ready.end(); ++it) {
+        InReadyList[it->Socket] = 0;
+    }
+    ready.clear();
+    for(vector<TLMReadySocket>::iterator it = sh.CarryOver.begin(); it != sh.CarryOver.end(); ++it) {
+        AddReady(it->Socket, ready);
+    }
+    sh.CarryOver.clear();
+
+#ifdef TLM_USE_EPOLL
+    bool shmActive = (ShmSegment != 0) && !sh.ShmSockets.empty();
+    if(shmActive) {
+        // Unlike in SelectReadySockets the flag is not cleared after the
+        // wait, the other shards might still rely on it.
+        ShmSegment->SetManagerWaiting(true);
+        for(vector<int>::iterator it = sh.ShmSockets.begin(); it != sh.ShmSockets.end(); it++) {
+            TLMShmChannel* shm = TLMShmChannel::Find(*it);
+            if(shm && shm->HasData()) {
+                AddReady(*it, ready);
+            }
+        }
+    }
+
+    const int maxEvents = 64;
+    struct epoll_event events[maxEvents];
+    int nEvents = epoll_wait(sh.EventHandle, events, maxEvents, (ready.empty() && !pending) ? 500 : 0);
+    sh.Sleeping.store(0);
+
+    bool doorbell = false;
+    for(int i = 0; i < nEvents; i++) {
+        int socket = events[i].data.fd;
+        if(socket == sh.WakeHandle) {
+            eventfd_t value;
+            eventfd_read(sh.WakeHandle, &value);
+            continue;
+        }
+        if(ShmSegment && socket == ShmSegment->GetDoorbellHandle()) {
+            doorbell = true;
+            continue;
+        }
+        if(events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            HungUp[socket] = 1;
+        }
+        AddReady(socket, ready);
+    }
+
+    if(doorbell) {
+        ShmSegment->ClearDoorbell();
+        ShmSegment->SetManagerWaiting(true);
+        for(vector<int>::iterator it = ShmSockets.begin(); it != ShmSockets.end(); it++) {
+            TLMShmChannel* shm = TLMShmChannel::Find(*it);
+            if(shm == 0 || !shm->HasData()) continue;
+            int owner = SocketShard[*it];
+            if(owner == shard) {
+                AddReady(*it, ready);
+            }
+            else {
+                WakeShard(owner);
+            }
+        }
+    }
+#endif
+}
+
+void TLMManagerComm::ReadDone(int shard, const TLMReadySocket& sock) {
+    if(MoreData(sock.Socket)) {
+        Shards[shard]->CarryOver.push_back(sock);
+    }
+}
+
+void TLMManagerComm::WakeShard(int shard) {
+#ifdef TLM_USE_EPOLL
+    TLMSocketShard& sh = *Shards[shard];
+    if(sh.Sleeping.exchange(0) && sh.WakeHandle >= 0) {
+        eventfd_write(sh.WakeHandle, 1);
+    }
+#endif
+}
+
+void TLMManagerComm::CloseShards() {
+    for(std::vector<TLMSocketShard*>::iterator it = Shards.begin(); it != Shards.end(); ++it) {
+        if((*it)->EventHandle >= 0) {
+            BCloseSocket((*it)->EventHandle);
+            (*it)->EventHandle = -1;
+        }
+        if((*it)->WakeHandle >= 0) {
+            BCloseSocket((*it)->WakeHandle);
+            (*it)->WakeHandle = -1;
+        }
+    }
 }
 
 int TLMManagerComm::AcceptComponentConnections() {
@@ -153,6 +674,8 @@ int TLMManagerComm::AcceptComponentConnections() {
         TLMErrorLog::FatalError("Could not accept a connection");
     }
 
+    TLMCommUtil::PrepareSocket(theCon);
+
     ClientSockets.push_back(theCon);
 
     return theCon;
@@ -160,15 +683,31 @@ int TLMManagerComm::AcceptComponentConnections() {
 
 // Add a socket handle to the active sockets set
 void TLMManagerComm::DropActiveSocket(int socket) {
+    DetachSharedMemory(socket);
+    for(vector<TLMReadySocket>::iterator it = CarryOver.begin(); it != CarryOver.end(); ++it) {
+        if(it->Socket == socket) {
+            CarryOver.erase(it);
+            break;
+        }
+    }
     BCloseSocket(socket);
     ActiveSockets.erase(std::find(ActiveSockets.begin(), ActiveSockets.end(), socket));
 }
 
 // Close all active sockets
 void TLMManagerComm::CloseAll() {
+    while(!ShmSockets.empty()) {
+        DetachSharedMemory(ShmSockets.back());
+    }
     std::vector<int>::iterator activeSockIter;
     for(activeSockIter = ActiveSockets.begin(); activeSockIter != ActiveSockets.end(); activeSockIter++) {
         BCloseSocket(*activeSockIter);
     }
     BCloseSocket(ContactSocket);
+    RemoveUnixSocket();
+    CloseShards();
+    if(EventHandle >= 0) {
+        BCloseSocket(EventHandle);
+        EventHandle = -1;
+    }
 }
@@ -9,6 +9,21 @@
 #include <winsock2.h>
 #endif
 #include <vector>
+#include <string>
+
+class TLMShmSegment;
+class TLMShmChannel;
+struct TLMSocketShard;
+
+//! A client socket with pending data and the index of
+//! the component it belongs to, returned by SelectReadySockets.
+struct TLMReadySocket {
+    //! The socket handle
+    int Socket;
+
+    //! Component index set with SetSocketComponent, -1 if unknown
+    int ComponentIndex;
+};
 
 //!
 //! TLMManagerComm is responsible for communications on the tlmmanager side
@@ -33,10 +48,67 @@ class TLMManagerComm {
 
     //! port used for CreateServerSocket
     unsigned short ServerPort;
+
+    //! Path of the Unix domain socket used by CreateServerSocket
+    //! instead of ServerPort, empty for TCP.
+    std::string UnixSocketPath;
     
     //! Number of clients processed
     const int NumClients;
 
+    //! Offer the shared memory transport to the clients
+    bool UseSharedMemory;
+
+    //! Shared memory segment with one ring buffer pair per client,
+    //! created in CreateServerSocket if UseSharedMemory is set.
+    TLMShmSegment* ShmSegment;
+
+    //! Sockets that have a shared memory channel attached
+    std::vector<int> ShmSockets;
+
+    //! All the channels created, deleted in the destructor since the
+    //! writer thread might still use a channel after it is detached.
+    std::vector<TLMShmChannel*> ShmChannels;
+
+    //! Component index for each socket handle, -1 if not a component socket
+    std::vector<int> SocketComponent;
+
+    //! Running mode event queue (epoll on Linux), -1 if select is used
+    int EventHandle;
+
+    //! Ready sockets that still had data after the last read.
+    //! They are returned by the next SelectReadySockets without waiting.
+    std::vector<TLMReadySocket> CarryOver;
+
+    //! Flags for the sockets already in the ready list, indexed by handle
+    std::vector<char> InReadyList;
+
+    //! Flags for the sockets reported as closed by the peer, indexed by handle
+    std::vector<char> HungUp;
+
+    //! Shards of the client sockets in sharded running mode,
+    //! each with its own epoll set. Empty in the other modes.
+    std::vector<TLMSocketShard*> Shards;
+
+    //! Shard index for each socket handle, -1 if not in a shard
+    std::vector<int> SocketShard;
+
+    //! Add the socket to the ready list unless it's already there.
+    void AddReady(int socket, std::vector<TLMReadySocket>& ready);
+
+    //! Check if a socket returned by SelectReadySockets must be visited
+    //! again, i.e., it still has data or was closed by the peer.
+    bool MoreData(int socket);
+
+    //! Close the epoll sets and wake up handles of the shards.
+    void CloseShards();
+
+    //! Create the server socket on UnixSocketPath.
+    int CreateUnixServerSocket();
+
+    //! Remove the socket file created by CreateUnixServerSocket.
+    void RemoveUnixSocket();
+
 public:
 
     //! Constructor for the specified number of components.
@@ -47,21 +119,65 @@ public:
           ActiveSockets(),
           StartupMode(true),
           ServerPort (portNr),
-          NumClients(numClients)
+          UnixSocketPath(),
+          NumClients(numClients),
+          UseSharedMemory(false),
+          ShmSegment(0),
+          ShmSockets(),
+          ShmChannels(),
+          SocketComponent(),
+          EventHandle(-1),
+          CarryOver(),
+          InReadyList(),
+          HungUp(),
+          Shards(),
+          SocketShard()
     {
         FD_ZERO(& CurFDSet);
     }
 
-    //! Create socket that will accept the client connections on port ServerPort
+    //! Destructor, removes the shared memory segment and the shards.
+    ~TLMManagerComm();
+
+    //! Enable/disable the shared memory transport for local clients.
+    //! Must be called before CreateServerSocket.
+    void SetUseSharedMemory(bool use) { UseSharedMemory = use; }
+
+    //! Listen on a Unix domain socket with the given path instead of
+    //! a TCP port. Must be called before CreateServerSocket.
+    void SetUnixSocketPath(const std::string& path) { UnixSocketPath = path; }
+
+    //! Create socket that will accept the client connections on port ServerPort,
+    //! or on UnixSocketPath if set.
     int CreateServerSocket();
 
-    //! Run select on the active set of sockets
+    //! Run select on the active set of sockets.
+    //! Also returns when data arrives on an attached shared memory channel.
     void SelectReadSocket();
 
     //! Check if the data is pending to be read on the specified socket
-    //! Should be called after SelectReadSocket
+    //! or its shared memory channel. Should be called after SelectReadSocket
     bool HasData(int socket);
 
+    //! Shared memory offer for the client in the given slot,
+    //! empty string if shared memory is not used.
+    std::string GetSharedMemoryOffer(int slot) const;
+
+    //! Attach the shared memory channel in the given slot to the socket
+    //! after the client accepted the offer. Returns false on failure.
+    bool AttachSharedMemory(int socket, int slot);
+
+    //! Detach and delete the shared memory channel of the socket, if any.
+    void DetachSharedMemory(int socket);
+
+    //! Remove the name of the shared memory segment once all the clients
+    //! have answered the offer, so that it is not left behind on a crash.
+    void UnlinkSharedMemory();
+
+    //! Numeric address of the client connected on the socket,
+    //! empty string on failure.
+    std::string GetPeerHost(int socket) const;
+
     //! Clear the active sockets set. Note that HasData function still
     //! checks the results of the last select.
     void ClearActiveSockets() {
@@ -79,8 +195,56 @@ public:
     //! Switch from startup mode, when components are sending registration
     //! requests and manager is accepting connections, to running mode, when
     //! manager forwards messages between components.
+    //! On Linux the client sockets are moved to an edge-triggered epoll set.
     void SwitchToRunningMode();
 
+    //! Associate a client socket with a component index. The index is
+    //! returned with the socket by SelectReadySockets.
+    void SetSocketComponent(int socket, int compIndex);
+
+    //! Running mode wait: blocks until some client sockets (or their shared
+    //! memory channels) have data and returns only those, each with its
+    //! component index. The caller must call ReadDone after reading one
+    //! message from a returned socket.
+    void SelectReadySockets(std::vector<TLMReadySocket>& ready);
+
+    //! Tell that one message was read from a ready socket. If more data is
+    //! pending the socket is returned again by the next SelectReadySockets,
+    //! which is needed since the epoll set is edge-triggered.
+    void ReadDone(const TLMReadySocket& sock);
+
+    //! Switch to running mode with the client sockets split into numShards
+    //! shards, component index modulo numShards. Each shard is served by its
+    //! own thread using the shard versions of SelectReadySockets and ReadDone.
+    //! Returns false if sharding is not available (no epoll), the manager is
+    //! then switched to the normal running mode.
+    bool SwitchToShardedMode(int numShards);
+
+    //! Number of shards, 0 if not in sharded mode.
+    int GetNumShards() const { return Shards.size(); }
+
+    //! Shard of a client socket, -1 if the socket is not in a shard.
+    int GetSocketShard(int socket) const {
+        return (socket >= 0 && socket < (int)SocketShard.size()) ? SocketShard[socket] : -1;
+    }
+
+    //! Announce that the shard thread is about to wait. Must be called
+    //! before the thread checks its other sources of work, see WakeShard.
+    void PrepareWait(int shard);
+
+    //! Sharded running mode wait, same as SelectReadySockets for the sockets
+    //! of the shard. Does not block if "pending" is set. Also returns when
+    //! the shard is woken up with WakeShard.
+    void SelectReadySockets(int shard, std::vector<TLMReadySocket>& ready, bool pending);
+
+    //! Same as ReadDone for a socket returned by the shard version of
+    //! SelectReadySockets.
+    void ReadDone(int shard, const TLMReadySocket& sock);
+
+    //! Wake up the shard thread if it waits in SelectReadySockets or is
+    //! about to. May be called from any thread.
+    void WakeShard(int shard);
+
     //! Accept a client component connection
     int AcceptComponentConnections();
 
@@ -7,34 +7,112 @@
 #include "Communication/TLMCommUtil.h"
 #include <cassert>
 
-TLMMessageQueue::~TLMMessageQueue() {
-    Terminate();
+//! Number of messages allocated up front.
+static const size_t TLM_QUEUE_PREALLOCATED = 64;
+
+//! Max. number of messages waiting to be sent. The reader waits for
+//! the writer when the send queue is full.
+static const size_t TLM_QUEUE_SEND_SIZE = 1 << 14;
+
+//! Max. number of free message buffers kept for reuse.
+static const size_t TLM_QUEUE_FREE_SIZE = 1 << 10;
+
+//! Number of busy polls of an empty send queue before yielding.
+//! Not used on a single CPU where spinning only delays the producer.
+static const int TLM_QUEUE_SPIN = 200;
 
-    SenderWait.signal(); // to be sure that no one "hangs" on it
+//! Number of yields before the writer parks on the condition.
+static const int TLM_QUEUE_YIELD = 50;
 
-    SendBufLock.lock();
-    while(!SendBuffers.empty()) {
-        SenderWait.wait(SendBufLock);
+
+TLMMessageRing::TLMMessageRing(size_t size)
+    : Cells(new Cell[size])
+    , Mask(size - 1)
+    , EnqueuePos(0)
+    , DequeuePos(0) {
+    assert(size >= 2 && (size & (size - 1)) == 0);
+    for(size_t i = 0; i < size; i++) {
+        Cells[i].Sequence.store(i, std::memory_order_relaxed);
+        Cells[i].Message = NULL;
     }
-    SendBufLock.unlock();
+}
 
-    FreeBufLock.lock();
-    while(FreeBuffers.size() > 0) {
-        delete FreeBuffers.top();
-        FreeBuffers.pop();
+TLMMessageRing::~TLMMessageRing() {
+    delete[] Cells;
+}
+
+bool TLMMessageRing::Put(TLMMessage* mess) {
+    Cell* cell;
+    size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+    for(;;) {
+        cell = &Cells[pos & Mask];
+        size_t seq = cell->Sequence.load(std::memory_order_acquire);
+        ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)pos;
+        if(dif == 0) {
+            // The cell is free on this lap, try to claim it
+            if(EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if(dif < 0) {
+            return false; // full
+        }
+        else {
+            pos = EnqueuePos.load(std::memory_order_relaxed);
+        }
     }
-    FreeBufLock.unlock();
+    cell->Message = mess;
+    cell->Sequence.store(pos + 1, std::memory_order_release);
+    return true;
 }
 
+TLMMessage* TLMMessageRing::Get() {
+    Cell* cell;
+    size_t pos = DequeuePos.load(std::memory_order_relaxed);
+    for(;;) {
+        cell = &Cells[pos & Mask];
+        size_t seq = cell->Sequence.load(std::memory_order_acquire);
+        ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+        if(dif == 0) {
+            // The cell is filled on this lap, try to claim it
+            if(DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if(dif < 0) {
+            return NULL; // empty
+        }
+        else {
+            pos = DequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    TLMMessage* mess = cell->Message;
+    cell->Sequence.store(pos + Mask + 1, std::memory_order_release);
+    return mess;
+}
 
-TLMMessage* TLMMessageQueue::GetReadSlot() {
-    TLMMessage* ret = NULL;
-    FreeBufLock.lock();
-    if(FreeBuffers.size() > 0) {
-        ret = FreeBuffers.top();
-        FreeBuffers.pop();
+
+TLMMessageQueue::TLMMessageQueue()
+    : SendBuffers(TLM_QUEUE_SEND_SIZE)
+    , FreeBuffers(TLM_QUEUE_FREE_SIZE)
+    , ParkLock()
+    , SenderWait()
+    , WriterParked(false)
+    , Terminated(false)
+    , SpinCount(NumCPUs() > 1 ? TLM_QUEUE_SPIN : 0) {
+    for(size_t i = 0; i < TLM_QUEUE_PREALLOCATED; i++) {
+        FreeBuffers.Put(new TLMMessage());
     }
-    FreeBufLock.unlock();
+}
+
+TLMMessageQueue::~TLMMessageQueue() {
+    Terminate();
+
+    // Terminate may race with late ReleaseSlot calls, clean up again.
+    TLMMessage* msg;
+    while((msg = SendBuffers.Get()) != NULL) delete msg;
+    while((msg = FreeBuffers.Get()) != NULL) delete msg;
+}
+
+
+TLMMessage* TLMMessageQueue::GetReadSlot() {
+    TLMMessage* ret = FreeBuffers.Get();
     if(ret == NULL)
         ret = new TLMMessage();
     return ret;
@@ -42,65 +120,86 @@ TLMMessage* TLMMessageQueue::GetReadSlot() {
 
 // Put the message on the message send queue
 void TLMMessageQueue::PutWriteSlot(TLMMessage* mess) {
-    if(Terminated) return;
+    if(Terminated) {
+        ReleaseSlot(mess);
+        return;
+    }
 
-    SendBufLock.lock();
-    SendBuffers.push(mess);
-    if(SendBuffers.size() == 1) {
-        SenderWait.signal();
+    // If the queue is full wait until the writer makes room.
+    while(!SendBuffers.Put(mess)) {
+        WakeWriter();
+        YieldThread();
+    }
+
+    // Pairs with the fence in GetWriteSlot: either the writer sees
+    // the message before parking or we see that it is parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(WriterParked.load(std::memory_order_relaxed)) {
+        WakeWriter();
     }
-    SendBufLock.unlock();
 }
 
 // Get the next message to be sent. May block if there are no
 // messages in the queue. Returns "NULL" if no messages to send
 // left.
 TLMMessage* TLMMessageQueue::GetWriteSlot() {
-    TLMMessage* ret = NULL;
-    SendBufLock.lock();
-    if(SendBuffers.empty() && !Terminated) {
-        SenderWait.wait(SendBufLock);
-    }
-    if(SendBuffers.size() >  0) {
-        ret = SendBuffers.front();
-        SendBuffers.pop();
-    }
-    SendBufLock.unlock();
+    for(int spin = 0; ; spin++) {
+        TLMMessage* ret = SendBuffers.Get();
+        if(ret != NULL) return ret;
+
+        if(Terminated && SendBuffers.Empty()) return NULL;
 
-    if(Terminated && (SendBuffers.size() == 0)) {
-        SenderWait.signal(); // signal destructor in case it is waiting
+        if(spin < SpinCount) {
+            SpinPause();
+            continue;
+        }
+        if(spin < SpinCount + TLM_QUEUE_YIELD) {
+            YieldThread();
+            continue;
+        }
+
+        // Nothing for a while, park until a producer wakes us up.
+        ParkLock.lock();
+        WriterParked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(SendBuffers.Empty() && !Terminated) {
+            SenderWait.wait(ParkLock);
+        }
+        WriterParked.store(false, std::memory_order_relaxed);
+        ParkLock.unlock();
+
+        spin = 0;
     }
-    return ret;
 }
 
 // Put a message back on the free slots stack.
 void TLMMessageQueue::ReleaseSlot(TLMMessage* mess) {
-    FreeBufLock.lock();
-    FreeBuffers.push(mess);
-    FreeBufLock.unlock();
+    mess->SharedData.reset(); // drop the reference to a shared payload
+    if(!FreeBuffers.Put(mess)) {
+        delete mess; // enough spare buffers
+    }
 }
 
 void TLMMessageQueue::Terminate() {
 
+    Terminated = true;
+
     //Clear free TLM messages
-    FreeBufLock.lock();
-    while(!FreeBuffers.empty()) {
-        TLMMessage *msg = FreeBuffers.top();
+    TLMMessage* msg;
+    while((msg = FreeBuffers.Get()) != NULL) {
         delete msg;
-        FreeBuffers.pop();
     }
-    FreeBufLock.unlock();
 
     //Clear messages from send queue (should probably not be any)
-    SendBufLock.lock();
-    while(!SendBuffers.empty()) {
-        TLMMessage *msg = SendBuffers.front();
+    while((msg = SendBuffers.Get()) != NULL) {
         delete msg;
-        SendBuffers.pop();
     }
-    SendBufLock.unlock();
 
-    Terminated = true;
-    
-    SenderWait.signal(); // to be sure that no one "hangs" on it
+    WakeWriter(); // to be sure that no one "hangs" on it
+}
+
+void TLMMessageQueue::WakeWriter() {
+    ParkLock.lock();
+    SenderWait.signal();
+    ParkLock.unlock();
 }
@@ -1,48 +1,112 @@
 //!
 //! \file TLMMessageQueue.h
-//! 
-//! Defines the MessageQueue thread safe class 
+//!
+//! Defines the MessageQueue thread safe class
 //!
 
 #ifndef TLMMessageQueue_h_
 #define TLMMessageQueue_h_
 
-#include <queue>
-#include <stack>
+#include <atomic>
+#include <cstddef>
 #include "TLMThreadSynch.h"
 #include "Communication/TLMCommUtil.h"
 
+//! Class TLMMessageRing is a bounded lock-free queue of message pointers.
+//! Any number of threads may put and get concurrently. Each cell carries
+//! a sequence number telling if it is free or filled for the current lap
+//! around the ring (D. Vyukov's bounded MPMC queue).
+class TLMMessageRing {
+
+    //! Ring cell
+    struct Cell {
+        std::atomic<size_t> Sequence;
+        TLMMessage* Message;
+    };
+
+    //! The cells, size is a power of two
+    Cell* Cells;
+
+    //! Number of cells minus one
+    size_t Mask;
+
+    //! Keep the positions on separate cache lines, they are
+    //! updated by different threads.
+    char Pad0[64];
+
+    //! Next position to put to
+    std::atomic<size_t> EnqueuePos;
+
+    char Pad1[64];
+
+    //! Next position to get from
+    std::atomic<size_t> DequeuePos;
+
+    char Pad2[64];
+
+public:
+
+    //! Constructor, size must be a power of two.
+    explicit TLMMessageRing(size_t size);
+
+    //! Destructor, does not delete the messages left in the ring.
+    ~TLMMessageRing();
+
+    //! Put a message at the end of the ring.
+    //! Returns 'false' if the ring is full.
+    bool Put(TLMMessage* mess);
+
+    //! Get the first message from the ring. Returns NULL if the ring
+    //! is empty or the first message is not completely put yet.
+    TLMMessage* Get();
+
+    //! Check if the ring is empty. A message that is being put
+    //! counts as present.
+    bool Empty() const {
+        return EnqueuePos.load(std::memory_order_seq_cst) == DequeuePos.load(std::memory_order_seq_cst);
+    }
+
+private:
+    // Should never be used
+    TLMMessageRing(const TLMMessageRing&);
+    TLMMessageRing& operator=(const TLMMessageRing&);
+};
+
 //! Class TLMMessageQueue is a thread-safe message queue as needed
 //! by the ManagerCommHandler class.
+//! The send queue and the free buffers are lock-free rings. The writer
+//! thread spins and yields for a while when the send queue is empty
+//! and parks on a condition only after that. The producers take the
+//! lock only to wake up a parked writer.
 class TLMMessageQueue {
 
     //! The buffers to be sent.
-    SimpleLock SendBufLock;
-    std::queue<TLMMessage*> SendBuffers;
+    TLMMessageRing SendBuffers;
 
-    //! Stack of free message buffers - to save allocations.
+    //! Free message buffers - to save allocations.
     //! Storage is messaged by this class.
-    SimpleLock FreeBufLock;
-    std::stack<TLMMessage*> FreeBuffers;
+    TLMMessageRing FreeBuffers;
+
+    //! Lock used together with SenderWait when the writer parks.
+    SimpleLock ParkLock;
 
     //! Nothing to be send. Wait on this.
     SimpleCond SenderWait;
 
+    //! True while the writer is parked (or about to park) on SenderWait.
+    std::atomic<bool> WriterParked;
+
     //! Terminated flag tells if the protocol is over and
     //! no more messages are expected in PutWriteSlot
-    bool Terminated;
+    std::atomic<bool> Terminated;
+
+    //! Number of busy polls before the writer starts yielding.
+    int SpinCount;
 
 public:
 
     //! Constructor
-    TLMMessageQueue()
-        : SendBufLock()
-        , SendBuffers()
-        , FreeBufLock()
-        , FreeBuffers()
-        , SenderWait()
-        , Terminated(false)
-    {}
+    TLMMessageQueue();
 
     //! Destructor
     ~TLMMessageQueue();
@@ -58,12 +122,21 @@ public:
     //! left.
     TLMMessage* GetWriteSlot();
 
+    //! Get the next message to be sent if there is one. Never blocks,
+    //! returns "NULL" if the queue is empty.
+    TLMMessage* TryGetWriteSlot() { return SendBuffers.Get(); }
+
     //! Put a message back on the free slots stack.
     void ReleaseSlot(TLMMessage* mess);
 
     //! Terminate function marks the end of communication protocol.
     //! It causes GetWriteSlot to return NULL.
     void Terminate();
+
+private:
+
+    //! Wake up the writer if it is parked.
+    void WakeWriter();
 };
 
 #endif
@@ -0,0 +1,527 @@
+/**
+* File: TLMShmTransport.cc
+*
+* Implementation of the shared memory transport defined in TLMShmTransport.h
+*/
+#include "Communication/TLMShmTransport.h"
+#include "Communication/TLMThreadSynch.h"
+#include "Logging/TLMErrorLog.h"
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+using std::string;
+
+#if !(defined(WIN32) || defined(__MINGW32__))
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+//! Size of each ring buffer in bytes, must be a power of two.
+static const unsigned TLM_SHM_RING_SIZE = 1 << 16;
+
+//! Magic number marking an initialized segment.
+static const unsigned TLM_SHM_MAGIC = 0x544c4d31;
+
+//! Max. socket handle that can have a channel attached.
+static const int TLM_SHM_MAX_SOCKETS = 1024;
+
+//! Time slice for blocking waits, the peer liveness is checked in between.
+static const long TLM_SHM_WAIT_NSEC = 100000000;
+
+//! Single producer, single consumer byte ring.
+//! Head and Tail are free running byte counters.
+struct TLMShmRing {
+    //! Bytes written by the producer
+    alignas(64) std::atomic<unsigned> Head;
+    //! Bytes read by the consumer
+    alignas(64) std::atomic<unsigned> Tail;
+    //! Set by the consumer before it sleeps on DataReady
+    alignas(64) std::atomic<int> ReaderWaiting;
+    //! Set by the producer before it sleeps on SpaceReady
+    std::atomic<int> WriterWaiting;
+    //! Posted when new data is published
+    sem_t DataReady;
+    //! Posted when data is consumed
+    sem_t SpaceReady;
+    //! The data
+    unsigned char Buffer[TLM_SHM_RING_SIZE];
+};
+
+//! Ring buffer pair used by one component.
+struct TLMShmSlot {
+    TLMShmRing ToManager;
+    TLMShmRing ToClient;
+};
+
+//! Segment layout: header followed by NumSlots slots.
+struct TLMShmSegmentHeader {
+    unsigned Magic;
+    unsigned NumSlots;
+    unsigned long long Token;
+    //! Set by the manager before it blocks in select
+    std::atomic<int> ManagerWaiting;
+    //! Doorbell FIFO path
+    char DoorbellPath[128];
+    alignas(64) TLMShmSlot Slots[1];
+};
+
+//! Segments created by this process and not yet unlinked.
+static std::vector<TLMShmSegment*> OwnedSegments;
+
+//! Protects OwnedSegments.
+static SimpleLock OwnedSegmentsLock;
+
+// Remove the names of the segments still linked when the manager exits,
+// e.g., on a fatal error during the startup.
+static void UnlinkOwnedSegments() {
+    std::vector<TLMShmSegment*> segments;
+    OwnedSegmentsLock.lock();
+    segments = OwnedSegments;
+    OwnedSegmentsLock.unlock();
+    for(std::vector<TLMShmSegment*>::iterator it = segments.begin(); it != segments.end(); ++it) {
+        (*it)->Unlink();
+    }
+}
+
+//! Names of the last created segment and its doorbell while they are
+//! linked, removed by UnlinkOnSignal.
+static char LinkedNames[2][160];
+
+//! Signals that terminate the manager before it gets to unlink.
+static const int CleanupSignals[] = { SIGINT, SIGTERM, SIGHUP };
+
+// Remove the names when the manager is killed during the startup, then
+// terminate as the default action would.
+static void UnlinkOnSignal(int sig) {
+    if(LinkedNames[0][0]) shm_unlink(LinkedNames[0]);
+    if(LinkedNames[1][0]) unlink(LinkedNames[1]);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static size_t SegmentSize(int numSlots) {
+    return sizeof(TLMShmSegmentHeader) + (numSlots - 1) * sizeof(TLMShmSlot);
+}
+
+// Wait on a semaphore for one time slice.
+static void TimedWait(sem_t* sem) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += TLM_SHM_WAIT_NSEC;
+    if(ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    while(sem_timedwait(sem, &ts) == -1 && errno == EINTR);
+}
+
+TLMShmSegment::TLMShmSegment()
+    : Name(),
+      DoorbellPath(),
+      Header(0),
+      Size(0),
+      DoorbellHandle(-1),
+      Owner(false) {
+}
+
+TLMShmSegment* TLMShmSegment::Create(int numSlots, unsigned short port) {
+    TLMShmSegment* seg = new TLMShmSegment;
+    seg->Owner = true;
+    seg->Name = "/omtlm_" + std::to_string(getpid()) + "_" + std::to_string(port);
+    seg->DoorbellPath = "/tmp" + seg->Name + ".bell";
+    seg->Size = SegmentSize(numSlots);
+
+    shm_unlink(seg->Name.c_str());
+    int fd = shm_open(seg->Name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0 || ftruncate(fd, seg->Size) != 0) {
+        TLMErrorLog::Warning("Failed to create shared memory segment " + seg->Name + ", using sockets");
+        if(fd >= 0) close(fd);
+        seg->Owner = false;
+        delete seg;
+        return NULL;
+    }
+
+    void* addr = mmap(NULL, seg->Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED) {
+        TLMErrorLog::Warning("Failed to map shared memory segment " + seg->Name + ", using sockets");
+        delete seg;
+        return NULL;
+    }
+    seg->Header = (TLMShmSegmentHeader*) addr;
+
+    unlink(seg->DoorbellPath.c_str());
+    if(mkfifo(seg->DoorbellPath.c_str(), 0600) != 0
+       || (seg->DoorbellHandle = open(seg->DoorbellPath.c_str(), O_RDWR | O_NONBLOCK)) < 0) {
+        TLMErrorLog::Warning("Failed to create doorbell " + seg->DoorbellPath + ", using sockets");
+        delete seg;
+        return NULL;
+    }
+
+    TLMShmSegmentHeader* hdr = seg->Header;
+    hdr->NumSlots = numSlots;
+    hdr->Token = std::random_device()();
+    hdr->Token = (hdr->Token << 32) ^ std::random_device()();
+    new (&hdr->ManagerWaiting) std::atomic<int>(0);
+    snprintf(hdr->DoorbellPath, sizeof(hdr->DoorbellPath), "%s", seg->DoorbellPath.c_str());
+
+    for(int i = 0; i < numSlots; i++) {
+        TLMShmRing* rings[2] = { &hdr->Slots[i].ToManager, &hdr->Slots[i].ToClient };
+        for(TLMShmRing* ring : rings) {
+            new (&ring->Head) std::atomic<unsigned>(0);
+            new (&ring->Tail) std::atomic<unsigned>(0);
+            new (&ring->ReaderWaiting) std::atomic<int>(0);
+            new (&ring->WriterWaiting) std::atomic<int>(0);
+            sem_init(&ring->DataReady, 1, 0);
+            sem_init(&ring->SpaceReady, 1, 0);
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    hdr->Magic = TLM_SHM_MAGIC;
+
+    OwnedSegmentsLock.lock();
+    static bool atExitSet = false;
+    if(!atExitSet) {
+        atexit(UnlinkOwnedSegments);
+        atExitSet = true;
+    }
+    OwnedSegments.push_back(seg);
+    if(!LinkedNames[0][0]) {
+        snprintf(LinkedNames[1], sizeof(LinkedNames[1]), "%s", seg->DoorbellPath.c_str());
+        snprintf(LinkedNames[0], sizeof(LinkedNames[0]), "%s", seg->Name.c_str());
+        // Don't replace the handlers installed by the application.
+        for(int sig : CleanupSignals) {
+            struct sigaction old;
+            if(sigaction(sig, NULL, &old) == 0 && old.sa_handler == SIG_DFL) {
+                signal(sig, UnlinkOnSignal);
+            }
+        }
+    }
+    OwnedSegmentsLock.unlock();
+
+    TLMErrorLog::Info("Created shared memory segment " + seg->Name);
+
+    return seg;
+}
+
+TLMShmSegment* TLMShmSegment::Open(const std::string& offer, int& slot) {
+    char name[128];
+    unsigned long long token = 0;
+    if(sscanf(offer.c_str(), "shm:%127[^:]:%d:%llu", name, &slot, &token) != 3) {
+        TLMErrorLog::Warning("Malformed shared memory offer: " + offer);
+        return NULL;
+    }
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd < 0) {
+        TLMErrorLog::Info(string("Shared memory segment ") + name + " not available, using sockets");
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(TLMShmSegmentHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    TLMShmSegment* seg = new TLMShmSegment;
+    seg->Name = name;
+    seg->Size = st.st_size;
+
+    void* addr = mmap(NULL, seg->Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED) {
+        delete seg;
+        return NULL;
+    }
+    seg->Header = (TLMShmSegmentHeader*) addr;
+
+    // Make sure this is the segment the manager offered, not a stale one
+    // with the same name.
+    TLMShmSegmentHeader* hdr = seg->Header;
+    if(hdr->Magic != TLM_SHM_MAGIC || hdr->Token != token
+       || slot < 0 || slot >= (int)hdr->NumSlots
+       || seg->Size < SegmentSize(hdr->NumSlots)) {
+        TLMErrorLog::Info(string("Shared memory segment ") + name + " does not match the offer, using sockets");
+        delete seg;
+        return NULL;
+    }
+
+    seg->DoorbellPath = hdr->DoorbellPath;
+    seg->DoorbellHandle = open(seg->DoorbellPath.c_str(), O_WRONLY | O_NONBLOCK);
+    if(seg->DoorbellHandle < 0) {
+        TLMErrorLog::Info("Doorbell " + seg->DoorbellPath + " not available, using sockets");
+        delete seg;
+        return NULL;
+    }
+
+    return seg;
+}
+
+TLMShmSegment::~TLMShmSegment() {
+    if(Header) {
+        munmap(Header, Size);
+    }
+    if(DoorbellHandle >= 0) {
+        close(DoorbellHandle);
+    }
+    Unlink();
+}
+
+void TLMShmSegment::Unlink() {
+    if(!Owner) return;
+    Owner = false;
+
+    shm_unlink(Name.c_str());
+    unlink(DoorbellPath.c_str());
+
+    AutoLock lock(OwnedSegmentsLock);
+    std::vector<TLMShmSegment*>::iterator it = std::find(OwnedSegments.begin(), OwnedSegments.end(), this);
+    if(it != OwnedSegments.end()) {
+        OwnedSegments.erase(it);
+    }
+    if(Name == LinkedNames[0]) {
+        LinkedNames[0][0] = '\0';
+        LinkedNames[1][0] = '\0';
+        for(int sig : CleanupSignals) {
+            struct sigaction old;
+            if(sigaction(sig, NULL, &old) == 0 && old.sa_handler == UnlinkOnSignal) {
+                signal(sig, SIG_DFL);
+            }
+        }
+    }
+}
+
+std::string TLMShmSegment::GetOffer(int slot) const {
+    return "shm:" + Name + ":" + std::to_string(slot) + ":" + std::to_string(Header->Token);
+}
+
+int TLMShmSegment::GetNumSlots() const {
+    return Header->NumSlots;
+}
+
+void TLMShmSegment::SetManagerWaiting(bool waiting) {
+    Header->ManagerWaiting.store(waiting ? 1 : 0);
+}
+
+void TLMShmSegment::ClearDoorbell() {
+    char buf[64];
+    while(read(DoorbellHandle, buf, sizeof(buf)) > 0);
+}
+
+void TLMShmSegment::RingDoorbell() {
+    if(Header->ManagerWaiting.exchange(0)) {
+        char c = 0;
+        if(write(DoorbellHandle, &c, 1) < 0) {
+            // The FIFO is full, the manager is awake anyway.
+        }
+    }
+}
+
+TLMShmRing* TLMShmSegment::GetRing(int slot, bool toManager) const {
+    TLMShmSlot& s = Header->Slots[slot];
+    return toManager ? &s.ToManager : &s.ToClient;
+}
+
+
+TLMShmChannel::TLMShmChannel(TLMShmSegment& segment, int slot, int socket, bool managerSide)
+    : Segment(segment),
+      In(segment.GetRing(slot, managerSide)),
+      Out(segment.GetRing(slot, !managerSide)),
+      PendingHead(0),
+      SocketHandle(socket),
+      ManagerSide(managerSide) {
+    PendingHead = Out->Head.load();
+}
+
+void TLMShmChannel::Send(const TLMMessageHeader& header, const void* data, int size) {
+    WriteBytes(&header, sizeof(TLMMessageHeader));
+    if(size > 0) {
+        WriteBytes(data, size);
+    }
+    Publish();
+}
+
+void TLMShmChannel::WriteBytes(const void* data, unsigned size) {
+    const unsigned char* src = (const unsigned char*) data;
+    while(size > 0) {
+        unsigned space = TLM_SHM_RING_SIZE - (PendingHead - Out->Tail.load(std::memory_order_acquire));
+        if(space == 0) {
+            // Let the reader drain what we have so far and wait for space.
+            Publish();
+            Out->WriterWaiting.store(1);
+            if(PendingHead - Out->Tail.load() == TLM_SHM_RING_SIZE) {
+                if(!PeerAlive()) {
+                    TLMErrorLog::FatalError("Shared memory peer closed the connection while sending");
+                    return;
+                }
+                TimedWait(&Out->SpaceReady);
+            }
+            Out->WriterWaiting.store(0);
+            continue;
+        }
+
+        unsigned chunk = (size < space) ? size : space;
+        unsigned offset = PendingHead & (TLM_SHM_RING_SIZE - 1);
+        unsigned first = TLM_SHM_RING_SIZE - offset;
+        if(first > chunk) first = chunk;
+        memcpy(Out->Buffer + offset, src, first);
+        memcpy(Out->Buffer, src + first, chunk - first);
+
+        PendingHead += chunk;
+        src += chunk;
+        size -= chunk;
+    }
+}
+
+void TLMShmChannel::Publish() {
+    Out->Head.store(PendingHead);
+    if(Out->ReaderWaiting.exchange(0)) {
+        sem_post(&Out->DataReady);
+    }
+    if(!ManagerSide) {
+        Segment.RingDoorbell();
+    }
+}
+
+bool TLMShmChannel::ReadBytes(void* data, unsigned size) {
+    unsigned char* dst = (unsigned char*) data;
+    while(size > 0) {
+        unsigned tail = In->Tail.load(std::memory_order_relaxed);
+        unsigned avail = In->Head.load(std::memory_order_acquire) - tail;
+        if(avail == 0) {
+            In->ReaderWaiting.store(1);
+            if(In->Head.load() == tail) {
+                if(!PeerAlive()) {
+                    In->ReaderWaiting.store(0);
+                    return false;
+                }
+                TimedWait(&In->DataReady);
+            }
+            In->ReaderWaiting.store(0);
+            continue;
+        }
+
+        unsigned chunk = (size < avail) ? size : avail;
+        unsigned offset = tail & (TLM_SHM_RING_SIZE - 1);
+        unsigned first = TLM_SHM_RING_SIZE - offset;
+        if(first > chunk) first = chunk;
+        memcpy(dst, In->Buffer + offset, first);
+        memcpy(dst + first, In->Buffer, chunk - first);
+
+        In->Tail.store(tail + chunk);
+        if(In->WriterWaiting.exchange(0)) {
+            sem_post(&In->SpaceReady);
+        }
+
+        dst += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool TLMShmChannel::ReceiveHeader(TLMMessageHeader& header) {
+    return ReadBytes(&header, sizeof(TLMMessageHeader));
+}
+
+bool TLMShmChannel::ReceiveData(void* data, int size) {
+    return ReadBytes(data, size);
+}
+
+bool TLMShmChannel::HasData() const {
+    return In->Head.load(std::memory_order_acquire) != In->Tail.load(std::memory_order_relaxed);
+}
+
+// The socket carries no data once the channel is attached,
+// so readable means closed (or broken).
+bool TLMShmChannel::PeerAlive() const {
+    struct pollfd pfd;
+    pfd.fd = SocketHandle;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if(poll(&pfd, 1, 0) <= 0) {
+        return true;
+    }
+    if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        return false;
+    }
+    char c;
+    return recv(SocketHandle, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 0;
+}
+
+//! Channels attached to socket handles, indexed by the handle.
+static std::atomic<TLMShmChannel*> AttachedChannels[TLM_SHM_MAX_SOCKETS];
+
+bool TLMShmChannel::CanAttach(int socket) {
+    return socket >= 0 && socket < TLM_SHM_MAX_SOCKETS;
+}
+
+bool TLMShmChannel::Attach(int socket, TLMShmChannel* channel) {
+    if(!CanAttach(socket)) {
+        TLMErrorLog::Warning("Socket handle out of range for shared memory transport, using sockets");
+        return false;
+    }
+    AttachedChannels[socket].store(channel);
+    return true;
+}
+
+TLMShmChannel* TLMShmChannel::Detach(int socket) {
+    if(socket < 0 || socket >= TLM_SHM_MAX_SOCKETS) return NULL;
+    return AttachedChannels[socket].exchange(NULL);
+}
+
+TLMShmChannel* TLMShmChannel::Find(int socket) {
+    if(socket < 0 || socket >= TLM_SHM_MAX_SOCKETS) return NULL;
+    return AttachedChannels[socket].load(std::memory_order_acquire);
+}
+
+#else
+
+// No shared memory transport on Windows, everything goes through the sockets.
+
+TLMShmSegment::TLMShmSegment()
+    : Name(), DoorbellPath(), Header(0), Size(0), DoorbellHandle(-1), Owner(false) {}
+TLMShmSegment* TLMShmSegment::Create(int, unsigned short) { return NULL; }
+TLMShmSegment* TLMShmSegment::Open(const std::string&, int&) { return NULL; }
+TLMShmSegment::~TLMShmSegment() {}
+void TLMShmSegment::Unlink() {}
+std::string TLMShmSegment::GetOffer(int) const { return string(); }
+int TLMShmSegment::GetNumSlots() const { return 0; }
+void TLMShmSegment::SetManagerWaiting(bool) {}
+void TLMShmSegment::ClearDoorbell() {}
+void TLMShmSegment::RingDoorbell() {}
+TLMShmRing* TLMShmSegment::GetRing(int, bool) const { return NULL; }
+
+TLMShmChannel::TLMShmChannel(TLMShmSegment& segment, int, int socket, bool managerSide)
+    : Segment(segment), In(NULL), Out(NULL), PendingHead(0), SocketHandle(socket), ManagerSide(managerSide) {}
+void TLMShmChannel::Send(const TLMMessageHeader&, const void*, int) {}
+bool TLMShmChannel::ReceiveHeader(TLMMessageHeader&) { return false; }
+bool TLMShmChannel::ReceiveData(void*, int) { return false; }
+bool TLMShmChannel::HasData() const { return false; }
+void TLMShmChannel::WriteBytes(const void*, unsigned) {}
+void TLMShmChannel::Publish() {}
+bool TLMShmChannel::ReadBytes(void*, unsigned) { return false; }
+bool TLMShmChannel::PeerAlive() const { return false; }
+bool TLMShmChannel::CanAttach(int) { return false; }
+bool TLMShmChannel::Attach(int, TLMShmChannel*) { return false; }
+TLMShmChannel* TLMShmChannel::Detach(int) { return NULL; }
+TLMShmChannel* TLMShmChannel::Find(int) { return NULL; }
+
+#endif
@@ -0,0 +1,172 @@
+//!
+//! \file TLMShmTransport.h
+//!
+//! Shared memory transport used between TLM clients and the TLM manager
+//! running on the same host.
+//!
+//! The manager creates one POSIX shared memory segment with a pair of
+//! ring buffers (one per direction) for every component. A client that
+//! accepts the offer sent in the component registration reply routes all
+//! further messages through its ring pair instead of the socket. The
+//! messages keep the TLMMessageHeader framing used on the sockets.
+//! The socket stays open, it is used for the handshake and to detect
+//! that the peer went away.
+//!
+//! On Windows the transport is not available, the factory functions
+//! return NULL and all the traffic stays on the sockets.
+//!
+#ifndef TLMShmTransport_h_
+#define TLMShmTransport_h_
+
+#include <string>
+#include "Communication/TLMCommUtil.h"
+
+struct TLMShmSegmentHeader;
+struct TLMShmRing;
+
+//! TLMShmSegment is a mapping of the shared memory segment created by
+//! the manager. The manager owns the segment and removes its names with
+//! Unlink once the clients have opened it, at the latest on destruction
+//! or at exit.
+class TLMShmSegment {
+public:
+
+    //! Create a new segment with numSlots ring buffer pairs.
+    //! The port is used to make the segment name unique.
+    //! Returns NULL if shared memory is not available.
+    static TLMShmSegment* Create(int numSlots, unsigned short port);
+
+    //! Open the segment described by an offer string created with GetOffer.
+    //! Returns NULL if the segment can't be opened, e.g., when the
+    //! manager runs on another host.
+    static TLMShmSegment* Open(const std::string& offer, int& slot);
+
+    //! Destructor, unmaps the segment, removes it if we are the owner.
+    ~TLMShmSegment();
+
+    //! Remove the names of the segment and the doorbell FIFO. The mappings
+    //! and handles already open stay valid, but no more clients can open
+    //! the segment. Manager side only.
+    void Unlink();
+
+    //! Offer string sent to the client owning the given slot.
+    std::string GetOffer(int slot) const;
+
+    //! Number of ring buffer pairs in the segment
+    int GetNumSlots() const;
+
+    //! Handle that becomes readable when a client writes to a ring
+    //! while the manager is waiting. Manager side only.
+    int GetDoorbellHandle() const { return DoorbellHandle; }
+
+    //! Tell the clients that the manager is going to wait on the doorbell.
+    void SetManagerWaiting(bool waiting);
+
+    //! Drain the doorbell after a wake up. Manager side only.
+    void ClearDoorbell();
+
+    //! Wake up the manager if it is waiting. Client side only.
+    void RingDoorbell();
+
+    //! Ring buffer for the given slot and direction.
+    TLMShmRing* GetRing(int slot, bool toManager) const;
+
+private:
+
+    //! Use Create or Open
+    TLMShmSegment();
+
+    //! Name of the shared memory object
+    std::string Name;
+
+    //! Path of the doorbell FIFO
+    std::string DoorbellPath;
+
+    //! Mapped segment
+    TLMShmSegmentHeader* Header;
+
+    //! Size of the mapping in bytes
+    size_t Size;
+
+    //! Doorbell FIFO handle
+    int DoorbellHandle;
+
+    //! True for the manager that created the segment
+    bool Owner;
+};
+
+//! TLMShmChannel sends and receives TLM messages over a ring buffer pair.
+//! Channels are attached to the socket handle of the connection and
+//! picked up by TLMCommUtil::SendMessage and TLMCommUtil::ReceiveMessage.
+class TLMShmChannel {
+public:
+
+    //! Constructor. The socket is only used to detect a closed peer.
+    TLMShmChannel(TLMShmSegment& segment, int slot, int socket, bool managerSide);
+
+    //! Write header and data to the outgoing ring and wake up the reader.
+    void Send(const TLMMessageHeader& header, const void* data, int size);
+
+    //! Read a message header from the incoming ring.
+    //! Returns 'false' if the peer has closed the connection.
+    bool ReceiveHeader(TLMMessageHeader& header);
+
+    //! Read size bytes of message data from the incoming ring.
+    //! Returns 'false' if the peer has closed the connection.
+    bool ReceiveData(void* data, int size);
+
+    //! Check if there is pending data in the incoming ring.
+    bool HasData() const;
+
+    //! Get the segment this channel belongs to.
+    TLMShmSegment& GetSegment() { return Segment; }
+
+    //! Attach a channel to a socket handle. The messages sent to or
+    //! received from this handle will use the channel from now on.
+    //! Returns 'false' if the handle can't have a channel attached,
+    //! the connection keeps using the socket then.
+    static bool Attach(int socket, TLMShmChannel* channel);
+
+    //! Check if a channel can be attached to the socket handle.
+    static bool CanAttach(int socket);
+
+    //! Detach and return the channel attached to the socket (or NULL).
+    static TLMShmChannel* Detach(int socket);
+
+    //! Return the channel attached to the socket, NULL if none.
+    static TLMShmChannel* Find(int socket);
+
+private:
+
+    //! Copy bytes to the outgoing ring, publish only when the ring is full.
+    void WriteBytes(const void* data, unsigned size);
+
+    //! Make the written bytes visible and wake up the reader.
+    void Publish();
+
+    //! Copy bytes from the incoming ring, blocks until all are available.
+    bool ReadBytes(void* data, unsigned size);
+
+    //! Check that the peer still keeps the socket open.
+    bool PeerAlive() const;
+
+    //! The segment
+    TLMShmSegment& Segment;
+
+    //! Incoming ring
+    TLMShmRing* In;
+
+    //! Outgoing ring
+    TLMShmRing* Out;
+
+    //! Written but not yet published position in the outgoing ring
+    unsigned PendingHead;
+
+    //! Socket of the connection
+    int SocketHandle;
+
+    //! True on the manager side
+    bool ManagerSide;
+};
+
+#endif
@@ -13,10 +13,23 @@
 
 #ifndef SKIP_PTHREADS
 #include <pthread.h>
+#include <chrono>
+#include <stdint.h>
 #else
 #include <stdlib.h>
 #endif
 
+#if defined(WIN32) || defined(__MINGW32__)
+#include <winsock2.h>
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sched.h>
+#include <unistd.h>
+#endif
+
 #ifdef DEBUG_TQ_VER_FLG
 #include <assert.h>
 #define DBG_VALIDATE(F_) assert(F_ == 0)
@@ -98,6 +111,9 @@ public:
     //! Wait on the condition using the specified mutex.
     inline void wait(SimpleLock& lock);
 
+    //! Wait on the condition for at most the given time in seconds.
+    inline void timed_wait(SimpleLock& lock, double seconds);
+
     //! Signal on the condition.
     void signal()
     {
@@ -224,6 +240,58 @@ inline void SimpleCond::wait(SimpleLock& lock) {
 #endif
 }
 
+// Wait on the condition using the specified mutex, give up after the time.
+inline void SimpleCond::timed_wait(SimpleLock& lock, double seconds) {
+#ifdef DEBUG_TQ_VER_FLG
+    pthread_t savedID = lock.ownerThreadID;
+    lock.ownerThreadID = 777;
+#endif
+#ifndef SKIP_PTHREADS
+    // The time-out is an absolute time of the real time clock
+    const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count() + int64_t(seconds * 1e9);
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    pthread_cond_timedwait(&the_cond, &(lock.the_lock), &ts);
+#else
+    (void)lock; // does nothing, just to avoid warning.
+    (void)seconds;
+#endif
+#ifdef DEBUG_TQ_VER_FLG
+    lock.ownerThreadID = savedID;
+#endif
+}
+
+//! Give the CPU to another thread.
+inline void YieldThread() {
+#if defined(WIN32) || defined(__MINGW32__)
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+//! Number of online CPUs. Spin-wait loops don't spin on a single CPU.
+inline int NumCPUs() {
+#if defined(WIN32) || defined(__MINGW32__)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+#endif
+}
+
+//! Tell the CPU that we are in a spin-wait loop.
+inline void SpinPause() {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(_MSC_VER)
+    YieldProcessor();
+#endif
+}
 
 
 #endif
@@ -0,0 +1,214 @@
+//!
+//! \file TLMTimeDataRing.h
+//!
+//! Defines the ring buffer used by the TLM interfaces to keep the history
+//! of the time stamped data.
+//!
+
+#ifndef TLMTimeDataRing_h_
+#define TLMTimeDataRing_h_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(WIN32) || defined(__MINGW32__)
+#include <malloc.h>
+#endif
+
+//! Class TLMTimeDataRing stores time stamped data (TLMTimeData3D,
+//! TLMTimeData1D or TLMTimeDataSignal) ordered by the time field.
+//! New data is added at the back and old data is removed from the front
+//! in constant time. The capacity is a power of two and the storage is
+//! aligned to the cache line, it only grows (by doubling) if more data
+//! than reserved is kept, so in steady state nothing is allocated.
+//! The interpolation interval for a time is found by binary search,
+//! starting with the interval found the last time since the requested
+//! times usually move forward slowly.
+template<class T>
+class TLMTimeDataRing {
+
+    //! Alignment of the storage, the size of a cache line
+    enum { ALIGNMENT = 64 };
+
+    //! The storage, Capacity elements
+    T* Buffer;
+
+    //! Number of elements in Buffer, a power of two
+    size_t Capacity;
+
+    //! Position of the first element in Buffer
+    size_t First;
+
+    //! Number of stored elements
+    size_t Size;
+
+    //! The interval found by the last FindInterval call
+    mutable size_t LastInterval;
+
+public:
+
+    //! Constructor
+    TLMTimeDataRing()
+        : Buffer(NULL)
+        , Capacity(0)
+        , First(0)
+        , Size(0)
+        , LastInterval(0) {
+    }
+
+    //! Destructor
+    ~TLMTimeDataRing() {
+        Release(Buffer, Capacity);
+    }
+
+    //! Number of stored elements
+    size_t size() const { return Size; }
+
+    //! Check if the ring is empty
+    bool empty() const { return Size == 0; }
+
+    //! Number of elements that can be stored without growing
+    size_t capacity() const { return Capacity; }
+
+    //! Element i counting from the oldest one
+    T& operator[](size_t i) { return Buffer[(First + i) & (Capacity - 1)]; }
+    const T& operator[](size_t i) const { return Buffer[(First + i) & (Capacity - 1)]; }
+
+    //! The oldest element
+    T& front() { return (*this)[0]; }
+    const T& front() const { return (*this)[0]; }
+
+    //! The newest element
+    T& back() { return (*this)[Size - 1]; }
+    const T& back() const { return (*this)[Size - 1]; }
+
+    //! Add an element at the back, grows the storage if it is full.
+    void push_back(const T& item) {
+        if(Size == Capacity) {
+            Grow(Capacity == 0 ? 16 : 2 * Capacity);
+        }
+        (*this)[Size] = item;
+        Size++;
+    }
+
+    //! Remove the n oldest elements.
+    void pop_front(size_t n = 1) {
+        if(n > Size) n = Size;
+        First = (First + n) & (Capacity - 1);
+        Size -= n;
+        LastInterval = LastInterval > n ? LastInterval - n : 0;
+    }
+
+    //! Remove all the elements, the storage is kept.
+    void clear() {
+        First = 0;
+        Size = 0;
+        LastInterval = 0;
+    }
+
+    //! Make sure that at least n elements can be stored without growing.
+    void reserve(size_t n) {
+        if(n <= Capacity) return;
+        size_t cap = 16;
+        while(cap < n) cap *= 2;
+        Grow(cap);
+    }
+
+    //! Index of the first element with time not before the given time,
+    //! size() if there is no such element.
+    size_t LowerBound(double time) const {
+        size_t lo = 0;
+        size_t hi = Size;
+        while(lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if((*this)[mid].time < time) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    //! Find the interpolation interval for the given time, i.e., the
+    //! index i such that element i is at or before the time and element i+1
+    //! is after it. The time must be within [front().time, back().time).
+    size_t FindInterval(double time) const {
+        // Try the last interval and the next one first
+        size_t i = LastInterval;
+        if(i + 1 < Size && (*this)[i].time <= time) {
+            if(time < (*this)[i + 1].time) return i;
+            if(i + 2 < Size && time < (*this)[i + 2].time) {
+                LastInterval = i + 1;
+                return i + 1;
+            }
+        }
+
+        // The last element at or before the time
+        size_t lo = 0;
+        size_t hi = Size - 1;
+        while(hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if((*this)[mid].time <= time) {
+                lo = mid;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        LastInterval = lo;
+        return lo;
+    }
+
+private:
+
+    //! Move the data to a new storage of the given capacity.
+    void Grow(size_t cap) {
+        T* buf = Allocate(cap);
+        for(size_t i = 0; i < Size; i++) {
+            buf[i] = (*this)[i];
+        }
+        Release(Buffer, Capacity);
+        Buffer = buf;
+        Capacity = cap;
+        First = 0;
+    }
+
+    //! Allocate aligned storage for n elements and construct them.
+    static T* Allocate(size_t n) {
+        void* mem = NULL;
+#if defined(WIN32) || defined(__MINGW32__)
+        mem = _aligned_malloc(n * sizeof(T), ALIGNMENT);
+#else
+        if(posix_memalign(&mem, ALIGNMENT, n * sizeof(T)) != 0) mem = NULL;
+#endif
+        if(mem == NULL) throw std::bad_alloc();
+
+        T* buf = static_cast<T*>(mem);
+        for(size_t i = 0; i < n; i++) {
+            new(buf + i) T();
+        }
+        return buf;
+    }
+
+    //! Destroy the elements and free the storage.
+    static void Release(T* buf, size_t n) {
+        if(buf == NULL) return;
+        for(size_t i = 0; i < n; i++) {
+            buf[i].~T();
+        }
+#if defined(WIN32) || defined(__MINGW32__)
+        _aligned_free(buf);
+#else
+        free(buf);
+#endif
+    }
+
+    // Should never be used
+    TLMTimeDataRing(const TLMTimeDataRing&);
+    TLMTimeDataRing& operator=(const TLMTimeDataRing&);
+};
+
+#endif
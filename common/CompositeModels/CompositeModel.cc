@@ -33,7 +33,10 @@ string SimulationParams::GetServerName() const {
 #define MAXHOSTNAME 1024
 
     char Buf[MAXHOSTNAME + 50];
-    if(Address == "") {
+    if(!TLMCommUtil::GetUnixSocketPath(Address).empty()) {
+        return Address; // Unix domain socket, no port
+    }
+    else if(Address == "") {
         gethostname(Buf, MAXHOSTNAME); // this sometimes return unreliable (short) names
 
         // getting IP
@@ -78,6 +81,7 @@ TLMInterfaceProxy::TLMInterfaceProxy(int CompID, int IfcID, string& aName, int a
     Causality(aCausality),
     Domain(aDomain),
     Connected(false),
+    WireEncodings(0),
     time0Data3D() {}
 
 
@@ -195,13 +199,13 @@ bool omtlm_CompositeModel::CheckTheModel()
         int from = Connections.at(i)->GetFromID();
         int to = Connections.at(i)->GetToID();
 
-        TLMInterfaceProxy fromProxy = GetTLMInterfaceProxy(from);
+        TLMInterfaceProxy& fromProxy = GetTLMInterfaceProxy(from);
         std::string fromInterfaceName = fromProxy.GetName();
         int fromComponent = fromProxy.GetComponentID();
         std::string fromComponentName = GetTLMComponentProxy(fromComponent).GetName();
         std::string fromName = fromComponentName+"."+fromInterfaceName;
 
-        TLMInterfaceProxy toProxy = GetTLMInterfaceProxy(to);
+        TLMInterfaceProxy& toProxy = GetTLMInterfaceProxy(to);
         std::string toInterfaceName = toProxy.GetName();
         int toComponent = fromProxy.GetComponentID();
         std::string toComponentName = GetTLMComponentProxy(toComponent).GetName();
@@ -107,6 +107,17 @@ public:
         return Connected;
     }
 
+    //! Set the wire encoding flags the simulating component can decode.
+    void SetWireEncodings(int flags) {
+        WireEncodings = flags;
+    }
+
+    //! Wire encoding flags the simulating component can decode,
+    //! 0 if it only understands plain doubles.
+    int GetWireEncodings() const {
+        return WireEncodings;
+    }
+
     //    TLMTimeDataSignal& getTime0DataSignal() {
     //        return time0DataSignal;
     //    }
@@ -120,6 +131,11 @@ public:
         return time0Data3D;
     }
 
+    //! Statistics of the time data forwarded for this interface
+    TLMInterfaceStats& GetStats() {
+        return Stats;
+    }
+
 private:
 
     //! Set the interface connected to this one with TLMConnection
@@ -154,11 +170,17 @@ private:
     //! Flag telling if the simulating component is connected to the proxy.
     bool Connected;
 
+    //! Wire encoding flags reported by the component at registration
+    int WireEncodings;
+
     //! Data at simulation start time.
     //! Used for data interface data request mode.
     //    TLMTimeData3D time0DataSignal;
     //    TLMTimeData3D time0Data1D;
     TLMTimeData3D time0Data3D;
+
+    //! Message counts and forwarding times
+    TLMInterfaceStats Stats;
 };
 
 
@@ -417,10 +439,22 @@ class SimulationParams {
     //! Connection timeout in seconds used by server
     int Timeout;
 
+    //! Offer the shared memory transport to clients on the same host
+    bool SharedMemory;
+
+    //! Let connected clients exchange time data directly
+    bool DirectLinks;
+
+    //! Number of manager threads serving the client sockets in co-simulation
+    int IOWorkers;
+
+    //! File the interface statistics are written to, empty for none
+    std::string StatisticsFile;
+
 public:
 
     //! Constructor
-    SimulationParams() {
+    SimulationParams() : SharedMemory(true), DirectLinks(false), IOWorkers(1), StatisticsFile() {
         Set("127.0.0.1", 11111, 0.0, 1.0, 12111);
     }
 
@@ -440,6 +474,13 @@ public:
         return Port;
     }
 
+    //! Get the server address, either a host, empty for this host,
+    //! or unix:\<path> for a Unix domain socket.
+    const std::string& GetAddress() const {
+        return Address;
+    }
+
+    //! Set the server address
     void SetAddress(std::string address) {
         Address = address;
     }
@@ -493,12 +534,39 @@ public:
         return std::string(Buf);
     }
 
-    //! Get server name & port number in the form \<server>:\<port>
+    //! Get server name & port number in the form \<server>:\<port>,
+    //! or the address unchanged if it is unix:\<path>.
     std::string GetServerName() const;
 
     //! Returns communication timeout in seconds.
     int GetTimeout() { return Timeout; }
 
+    //! Returns true if the shared memory transport is offered to the clients.
+    bool GetSharedMemory() const { return SharedMemory; }
+
+    //! Enable/disable the shared memory transport.
+    void SetSharedMemory(bool use) { SharedMemory = use; }
+
+    //! Returns true if the clients are told to send time data directly to each other.
+    bool GetDirectLinks() const { return DirectLinks; }
+
+    //! Enable/disable direct links between the clients.
+    void SetDirectLinks(bool use) { DirectLinks = use; }
+
+    //! Returns the number of I/O worker threads used by the manager.
+    int GetIOWorkers() const { return IOWorkers; }
+
+    //! Set the number of I/O worker threads. With more than one worker
+    //! the client sockets are split into shards, one per worker.
+    void SetIOWorkers(int n) { IOWorkers = (n > 0) ? n : 1; }
+
+    //! Returns the interface statistics file, CSV if its name ends with
+    //! ".csv" and JSON otherwise, empty if disabled.
+    const std::string& GetStatisticsFile() const { return StatisticsFile; }
+
+    //! Set the interface statistics file, empty to disable it.
+    void SetStatisticsFile(const std::string& file) { StatisticsFile = file; }
+
     //! Returns write time step.
     double GetWriteTimeStep() { return WriteTimeStep; }
 
@@ -7,6 +7,7 @@
 #include "CompositeModels/CompositeModelReader.h"
 #include "Logging/TLMErrorLog.h"
 #include "Interfaces/TLMInterface.h"
+#include "Communication/TLMCommUtil.h"
 #include "double3.h"
 #include "double33.h"
 #include <string>
@@ -310,6 +311,66 @@ xmlNode* CompositeModelReader::FindAttributeByName(xmlNode* node, const char* na
     return NULL;
 }
 
+// ParseWireEncoding translates the "Encoding" attribute of a connection, a list of
+// encoding names separated by commas or spaces, into TLMWireEncodingConst flags.
+static int ParseWireEncoding(const string& attr) {
+    int encoding = 0;
+    string token;
+    std::istringstream in(attr);
+    while(std::getline(in, token, ',')) {
+        std::istringstream words(token);
+        string word;
+        while(words >> word) {
+            if(word == "none") continue;
+            else if(word == "quaternion") encoding |= TLMWireEncodingConst::TLM_ENC_QUATERNION;
+            else if(word == "float-position") encoding |= TLMWireEncodingConst::TLM_ENC_FLOAT_POSITION;
+            else if(word == "float-velocity") encoding |= TLMWireEncodingConst::TLM_ENC_FLOAT_VELOCITY;
+            else if(word == "float-wave") encoding |= TLMWireEncodingConst::TLM_ENC_FLOAT_WAVE;
+            else if(word == "delta-time") encoding |= TLMWireEncodingConst::TLM_ENC_DELTA_TIME;
+            else if(word == "compact") encoding |= TLMWireEncodingConst::TLM_ENC_QUATERNION
+                                                 | TLMWireEncodingConst::TLM_ENC_FLOAT_VELOCITY
+                                                 | TLMWireEncodingConst::TLM_ENC_FLOAT_WAVE
+                                                 | TLMWireEncodingConst::TLM_ENC_DELTA_TIME;
+            else TLMErrorLog::Warning("Unknown wire encoding \"" + word + "\" ignored");
+        }
+    }
+    return encoding;
+}
+
+// ParseInterpolation translates the "Interpolation" attribute of a connection,
+// a list of method names separated by commas or spaces, into
+// TLMInterpolationConst flags.
+static int ParseInterpolation(const string& attr) {
+    int interpolation = 0;
+    string token;
+    std::istringstream in(attr);
+    while(std::getline(in, token, ',')) {
+        std::istringstream words(token);
+        string word;
+        while(words >> word) {
+            if(word == "default" || word == "euler") {
+                interpolation &= ~TLMInterpolationConst::TLM_INTERP_ORIENTATION;
+            }
+            else if(word == "slerp") {
+                interpolation = (interpolation & ~TLMInterpolationConst::TLM_INTERP_ORIENTATION)
+                                | TLMInterpolationConst::TLM_INTERP_SLERP;
+            }
+            else if(word == "nlerp") {
+                interpolation = (interpolation & ~TLMInterpolationConst::TLM_INTERP_ORIENTATION)
+                                | TLMInterpolationConst::TLM_INTERP_NLERP;
+            }
+            else if(word == "linear") {
+                interpolation &= ~TLMInterpolationConst::TLM_INTERP_HERMITE;
+            }
+            else if(word == "hermite") {
+                interpolation |= TLMInterpolationConst::TLM_INTERP_HERMITE;
+            }
+            else TLMErrorLog::Warning("Unknown interpolation \"" + word + "\" ignored");
+        }
+    }
+    return interpolation;
+}
+
 // ReadTLMConnectionNode method processes an TLM connection definition in XML file.
 // The definition is submitted as xmlNode* and is registered in TheModel as a 
 // result of the method.
@@ -385,6 +446,22 @@ void CompositeModelReader::ReadTLMConnectionNode(xmlNode* node) {
                     TLMErrorLog::Info("alpha = "+TLMErrorLog::ToStdStr(conParam.alpha));
                 }
 
+                // Optional compact encoding of the 3D time data on the wire
+                if(fromIfc.GetCausality() == "bidirectional" && fromIfc.GetDimensions() == 6) {
+                    curAttr = FindAttributeByName(curNode, "Encoding", false);
+                    if(curAttr) {
+                        conParam.Encoding = ParseWireEncoding((const char*)curAttr->content);
+                        TLMErrorLog::Info("Encoding = "+TLMErrorLog::ToStdStr(int(conParam.Encoding)));
+                    }
+                }
+
+                // Optional interpolation method for the received time data
+                curAttr = FindAttributeByName(curNode, "Interpolation", false);
+                if(curAttr) {
+                    conParam.Interpolation = ParseInterpolation((const char*)curAttr->content);
+                    TLMErrorLog::Info("Interpolation = "+TLMErrorLog::ToStdStr(int(conParam.Interpolation)));
+                }
+
                 int conID = TheModel.RegisterTLMConnection(fromID, toID, conParam);
                 TLMConnection& con = TheModel.GetTLMConnection(conID);
 
@@ -0,0 +1,133 @@
+/**
+ * File: TLMFrameTransform.cc
+ *
+ * Implementation of the connection frame transformation of 3D time data
+ */
+#include "Interfaces/TLMFrameTransform.h"
+#include "Communication/TLMCalcData.h"
+
+// SSE2 is part of x86-64, so no run-time check is needed
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TLM_FRAME_SSE2
+#include <emmintrin.h>
+#endif
+
+// Apply treats the rotation matrix, the velocities and the forces as one
+// array of rows with three values each.
+static_assert(offsetof(TLMTimeData3D, Velocity) == offsetof(TLMTimeData3D, RotMatrix) + 9 * sizeof(double) &&
+              offsetof(TLMTimeData3D, GenForce) == offsetof(TLMTimeData3D, Velocity) + 6 * sizeof(double),
+              "TLMTimeData3D::RotMatrix, Velocity and GenForce must be consecutive");
+
+//! Number of rows from TLMTimeData3D::RotMatrix to the end of GenForce
+static const int TLM_FRAME_ROWS = 7;
+
+//! RowMatrix multiplies row vectors with a 3x3 matrix that is kept in
+//! registers. The sums are taken in the order of double3 * double33.
+class RowMatrix {
+#ifdef TLM_FRAME_SSE2
+    //! The first two columns of the matrix rows
+    __m128d A0, A1, A2;
+    //! The third column
+    double C0, C1, C2;
+#else
+    double M[9];
+#endif
+
+public:
+
+    //! Load the row-wise matrix A.
+    explicit RowMatrix(const double* A) {
+#ifdef TLM_FRAME_SSE2
+        A0 = _mm_loadu_pd(A);
+        A1 = _mm_loadu_pd(A + 3);
+        A2 = _mm_loadu_pd(A + 6);
+        C0 = A[2];
+        C1 = A[5];
+        C2 = A[8];
+#else
+        for(int i = 0; i < 9; i++) M[i] = A[i];
+#endif
+    }
+
+    //! out = v * A, out may be v.
+    void Mul(const double* v, double* out) const {
+#ifdef TLM_FRAME_SSE2
+        const double v0 = v[0];
+        const double v1 = v[1];
+        const double v2 = v[2];
+        __m128d xy = _mm_mul_pd(_mm_set1_pd(v0), A0);
+        xy = _mm_add_pd(xy, _mm_mul_pd(_mm_set1_pd(v1), A1));
+        xy = _mm_add_pd(xy, _mm_mul_pd(_mm_set1_pd(v2), A2));
+        double z = v0 * C0;
+        z += v1 * C1;
+        z += v2 * C2;
+        _mm_storeu_pd(out, xy);
+        out[2] = z;
+#else
+        const double v0 = v[0];
+        const double v1 = v[1];
+        const double v2 = v[2];
+        for(int j = 0; j < 3; j++) {
+            double x = v0 * M[j];
+            x += v1 * M[j + 3];
+            x += v2 * M[j + 6];
+            out[j] = x;
+        }
+#endif
+    }
+};
+
+
+TLMFrameTransform::TLMFrameTransform()
+    : Identity(true) {
+    R[0] = R[1] = R[2] = 0.0;
+    for(int i = 0; i < 9; i++) {
+        A[i] = (i % 4 == 0) ? 1.0 : 0.0;
+    }
+}
+
+void TLMFrameTransform::Set(const double* aR, const double* aA) {
+    Identity = true;
+    for(int i = 0; i < 3; i++) {
+        R[i] = aR[i];
+        if(R[i] != 0.0) Identity = false;
+    }
+    for(int i = 0; i < 9; i++) {
+        A[i] = aA[i];
+        if(A[i] != ((i % 4 == 0) ? 1.0 : 0.0)) Identity = false;
+    }
+}
+
+void TLMFrameTransform::Apply(TLMTimeData3D* data, size_t n) const {
+    if(Identity) return;
+
+    const RowMatrix M(A);
+    for(size_t k = 0; k < n; k++) {
+        TLMTimeData3D& item = data[k];
+
+        double p[3];
+        M.Mul(item.Position, p);
+        item.Position[0] = R[0] + p[0];
+        item.Position[1] = R[1] + p[1];
+        item.Position[2] = R[2] + p[2];
+
+        double* rows = item.RotMatrix;
+        for(int i = 0; i < TLM_FRAME_ROWS; i++) {
+            M.Mul(rows + 3 * i, rows + 3 * i);
+        }
+    }
+}
+
+void TLMFrameTransform::ApplyPose(const double* aR, const double* aA, double* ROut, double* AOut) const {
+    const RowMatrix M(A);
+
+    double p[3];
+    M.Mul(aR, p);
+    ROut[0] = R[0] + p[0];
+    ROut[1] = R[1] + p[1];
+    ROut[2] = R[2] + p[2];
+
+    for(int i = 0; i < 3; i++) {
+        M.Mul(aA + 3 * i, AOut + 3 * i);
+    }
+}
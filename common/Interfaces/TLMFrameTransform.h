@@ -0,0 +1,54 @@
+//!
+//! \file TLMFrameTransform.h
+//!
+//! Provides the transformation of 3D time data from the connection frame
+//! of a TLM interface to the global frame
+//!
+
+#ifndef TLMFrameTransform_h_
+#define TLMFrameTransform_h_
+
+#include <cstddef>
+
+class TLMTimeData3D;
+
+//! TLMFrameTransform keeps the position cX_R_cG_cG and the row-wise rotation
+//! matrix cX_A_cG of the connection frame cX relative the global frame cG
+//! and transforms 3D time data from cX to cG. The frame is set once per
+//! interface. The common case of the identity frame is detected, the
+//! transformation then does nothing.
+class TLMFrameTransform {
+public:
+
+    //! Constructor, the identity frame
+    TLMFrameTransform();
+
+    //! Set the frame from the position R and the row-wise rotation matrix A.
+    void Set(const double* R, const double* A);
+
+    //! Check if the frame is the identity, i.e., the transformation does nothing.
+    bool IsIdentity() const { return Identity; }
+
+    //! Transform the n time data items in place. The position is
+    //! cX_R_cG_cG + ci_R_cX_cX * cX_A_cG, the rotation matrix ci_A_cX * cX_A_cG,
+    //! velocities and forces are rotated by cX_A_cG. The results match the
+    //! double3/double33 operators bit by bit.
+    void Apply(TLMTimeData3D* data, size_t n) const;
+
+    //! Transform a single pose, position R and rotation matrix A (both
+    //! relative cX), into ROut and AOut relative cG.
+    void ApplyPose(const double* R, const double* A, double* ROut, double* AOut) const;
+
+private:
+
+    //! Position of cX in cG
+    double R[3];
+
+    //! Rotation matrix cX_A_cG, row-wise
+    double A[9];
+
+    //! Set if R is zero and A is the identity matrix
+    bool Identity;
+};
+
+#endif
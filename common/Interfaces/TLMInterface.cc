@@ -27,31 +27,37 @@ omtlm_TLMInterface::omtlm_TLMInterface(TLMClientComm& theComm, std::string& aNam
     LastSendTime(StartTime),
     NextRecvTime(0.0),
     Params(),
-    CurrentIntervalIndex(0),
     Name(aName),
     Comm(theComm),
     InterfaceID(-1),
+    DirectSocket(-1),
+    DirectLinkedID(-1),
+    DirectMirror(false),
     waitForShutdownFlg(false),
     Dimensions(dimensions),
     Causality(causality),
-    Domain(domain) {
+    Domain(domain),
+    CausalityType(ParseCausality(causality)),
+    Kind(dimensions == 6 ? TLM_INTERFACE_3D :
+         CausalityType == TLM_CAUSALITY_INPUT ? TLM_INTERFACE_INPUT :
+         CausalityType == TLM_CAUSALITY_OUTPUT ? TLM_INTERFACE_OUTPUT : TLM_INTERFACE_1D) {
 
     Message = new TLMMessage();
     Comm.CreateInterfaceRegMessage(aName, Dimensions, Causality, Domain, *Message);
     Message->SocketHandle = Comm.GetSocketHandle();
 
-    TLMCommUtil::SendMessage(*Message);
+    Comm.ExchangeRegMessage(*Message);
 
-    TLMCommUtil::ReceiveMessage(*Message);
-    while(Message->Header.MessageType != TLMMessageTypeConst::TLM_REG_INTERFACE) {
-        TLMCommUtil::ReceiveMessage(*Message);
-    }
     InterfaceID =  Message->Header.TLMInterfaceID;
 
     TLMErrorLog::Info(std::string("Interface ") + GetName() + " got ID " + TLMErrorLog::ToStdStr(InterfaceID));
 
     Comm.UnpackRegInterfaceMessage(*Message, Params);
 
+    if(int(Params.Interpolation) & TLMInterpolationConst::TLM_INTERP_HERMITE) {
+        TLMErrorLog::Info(std::string("Interface ") + GetName() + " uses cubic Hermite interpolation");
+    }
+
     NextRecvTime = StartTime + Params.Delay;
 }
 
@@ -62,6 +68,40 @@ omtlm_TLMInterface::~omtlm_TLMInterface()
 }
 
 
+TLMCausality omtlm_TLMInterface::ParseCausality(const std::string& causality) {
+    if(causality == "input") return TLM_CAUSALITY_INPUT;
+    if(causality == "output") return TLM_CAUSALITY_OUTPUT;
+    return TLM_CAUSALITY_BIDIRECTIONAL;
+}
+
+
+void omtlm_TLMInterface::SetDirectLink(int socket, int linkedID, bool mirror) {
+    DirectSocket = socket;
+    DirectLinkedID = linkedID;
+    DirectMirror = mirror;
+
+    TLMErrorLog::Info(std::string("Interface ") + GetName() + " sends data directly to interface "
+                      + TLMErrorLog::ToStdStr(linkedID));
+}
+
+
+void omtlm_TLMInterface::SendTimeDataMessage() {
+    if(DirectSocket < 0) {
+        Comm.SendToManager(*Message);
+        return;
+    }
+
+    if(DirectMirror) {
+        Comm.SendToManager(*Message);
+    }
+
+    // The receiver expects its own interface ID, as if the manager forwarded the data
+    Message->SocketHandle = DirectSocket;
+    Message->Header.TLMInterfaceID = DirectLinkedID;
+    Comm.Send(*Message);
+}
+
+
 // Hermite cubic interpolation. For the given 4 data points t[i], f[i] and time,
 // such that t[0]<t[1]<time<t[2]<t[3], returns f(time). .
 double omtlm_TLMInterface::InterpolateHermite(double time, double t[4], double f[4]) {
@@ -88,6 +128,22 @@ double omtlm_TLMInterface::InterpolateHermite(double time, double t[4], double f
 }
 
 
+// EstimateHistorySize returns the number of time data points kept by the
+// interface. The received data spans from one delay back (cleaned in
+// SetTimeData) to one delay ahead, the damped data a few delays more.
+size_t omtlm_TLMInterface::EstimateHistorySize(double maxStep) const {
+    const size_t minSize = 16;
+    const size_t maxSize = 4096;
+
+    if(maxStep <= 0.0 || Params.Delay <= 0.0) return minSize;
+
+    double n = 4 * Params.Delay / maxStep + 4;
+    if(n < minSize) return minSize;
+    if(n > maxSize) return maxSize;
+    return size_t(n);
+}
+
+
 
 
 
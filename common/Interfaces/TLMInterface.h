@@ -14,8 +14,26 @@
 #include <string>
 #include "Communication/TLMCommUtil.h"
 #include "Communication/TLMClientComm.h"
+#include "Logging/TLMStatistics.h"
 #include "common.h"
 
+//! TLMInterfaceKind tells the concrete class of a TLM interface, so that
+//! the plugin can use it without RTTI.
+enum TLMInterfaceKind {
+    TLM_INTERFACE_3D,           //!< TLMInterface3D
+    TLM_INTERFACE_1D,           //!< TLMInterface1D
+    TLM_INTERFACE_INPUT,        //!< TLMInterfaceInput
+    TLM_INTERFACE_OUTPUT        //!< TLMInterfaceOutput
+};
+
+//! TLMCausality is the causality of a TLM interface, kept next to the
+//! string given at registration so that it can be tested cheaply.
+enum TLMCausality {
+    TLM_CAUSALITY_BIDIRECTIONAL,
+    TLM_CAUSALITY_INPUT,
+    TLM_CAUSALITY_OUTPUT
+};
+
 //!
 //! TLMInterface provides the client side functionality for a single TLM interface
 //!
@@ -41,6 +59,15 @@ public:
     //! Get causality of the interface
     const std::string& GetCausality() const {return Causality; }
 
+    //! Get causality of the interface as enum
+    TLMCausality GetCausalityType() const { return CausalityType; }
+
+    //! Get the concrete class of the interface
+    TLMInterfaceKind GetKind() const { return Kind; }
+
+    //! Get the causality for the given name ("input", "output" or else bidirectional)
+    static TLMCausality ParseCausality(const std::string& causality);
+
     //! Send out motion data from the DataToSend vector
     virtual void SendAllData() = 0;
 
@@ -59,6 +86,27 @@ public:
     //! Get parameters for the TLM connection attached to the interface
     const TLMConnectionParams& GetConnParams() const { return Params; }
 
+    //! Send the time data directly to the linked interface on the given socket.
+    //! If mirror is set a copy is still sent to the manager for monitoring.
+    void SetDirectLink(int socket, int linkedID, bool mirror);
+
+    //! Check if the interface sends its data through the manager.
+    bool SendsToManager() const { return CausalityType != TLM_CAUSALITY_INPUT && (DirectSocket < 0 || DirectMirror); }
+
+    //! Check if SetTimeData for the given time would send the data.
+    bool IsSendDue(double time) const { return time >= LastSendTime + Params.Delay / 2 || Params.mode > 0.0; }
+
+    //! Get the socket where the time data for this interface arrives,
+    //! either a direct link or the manager connection.
+    int GetRecvSocket() const { return DirectSocket >= 0 ? DirectSocket : Comm.GetSocketHandle(); }
+
+    //! Reserve the storage for the time data history, the solver takes
+    //! steps of at most maxStep (0 if unknown).
+    virtual void ReserveTimeData(double maxStep) = 0;
+
+    //! Get the statistics of this interface
+    TLMInterfaceStats& GetStats() { return Stats; }
+
 protected:
 
     //! Linear interpolation (can be used for linear extrapolation as well)
@@ -74,6 +122,14 @@ protected:
     //! such that t[0]<t[1]<time<t[2]<t[3], returns f(time). .
     static double InterpolateHermite(double time, double t[4], double f[4]);
 
+    //! Estimate the number of time data points kept by the interface when
+    //! the solver takes steps of maxStep.
+    size_t EstimateHistorySize(double maxStep) const;
+
+    //! Send the time data packed in Message, to the linked interface if
+    //! there is a direct link and to the manager otherwise.
+    void SendTimeDataMessage();
+
     //! Last time when the data was sent
     double LastSendTime;
 
@@ -87,10 +143,6 @@ protected:
     //! Parameters of the TLM connection attached to this interface
     TLMConnectionParams Params;
 
-    //! CurrentIntervalIndex is the last offset in TimeData deque used for
-    //! interpolation. It is used to speedup search in deque.
-    int CurrentIntervalIndex;
-
     //! Name of this TLM interface
     std::string Name;
 
@@ -100,6 +152,16 @@ protected:
     //! TLM ID of this interface as received from the TLM manager
     int InterfaceID;
 
+    //! Socket of the direct link to the linked interface, -1 if the
+    //! data goes through the manager
+    int DirectSocket;
+
+    //! TLM ID of the linked interface on the other end of the direct link
+    int DirectLinkedID;
+
+    //! Send a copy of the data to the manager when a direct link is used
+    bool DirectMirror;
+
     //! Indecates that the interface is finished and waits for shutdown.
     //! This is use for interface request mode and not simulation mode.
     bool waitForShutdownFlg;
@@ -107,5 +169,14 @@ protected:
     int Dimensions;
     std::string Causality;
     std::string Domain;
+
+    //! The causality, given by the Causality string
+    TLMCausality CausalityType;
+
+    //! The concrete class, given by the dimensions and the causality
+    TLMInterfaceKind Kind;
+
+    //! Message counts, wait and send times of this interface
+    TLMInterfaceStats Stats;
 };
 #endif
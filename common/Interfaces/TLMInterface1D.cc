@@ -1,7 +1,8 @@
 #include "Interfaces/TLMInterface1D.h"
+#include "Interfaces/TLMInterpolation.h"
 #include "Communication/TLMCommUtil.h"
 #include "Plugin/TLMPlugin.h"
-#include <deque>
+#include <cstddef>
 #include <string>
 #include "double33.h"
 
@@ -9,25 +10,13 @@
 //TODO: This is used both by 1D and 3D, should probably be defined in one place. /robbr
 static const double TLM_DAMP_DELAY = 1.5;
 
-TLMInterface1D::TLMInterface1D(TLMClientComm &theComm, std::string &aName, double StartTime, std::string Domain)
-    : omtlm_TLMInterface(theComm, aName, StartTime, 1, "bidirectional", Domain) {}
-
-TLMInterface1D::~TLMInterface1D() {
-    if(DataToSend.size() != 0) {
-        TLMErrorLog::Info(std::string("Interface ") + GetName() + " sends rest of data for time= " +
-                         TLMErrorLog::ToStdStr(DataToSend.back().time));
-
-        Comm.PackTimeDataMessage1D(InterfaceID, DataToSend, *Message);
-        TLMCommUtil::SendMessage(*Message);
-    }
-}
-
+// InterpolateHermite treats the position, velocity and force as one array
+static_assert(offsetof(TLMTimeData1D, Velocity) == offsetof(TLMTimeData1D, Position) + sizeof(double) &&
+              offsetof(TLMTimeData1D, GenForce) == offsetof(TLMTimeData1D, Velocity) + sizeof(double),
+              "TLMTimeData1D::Position, Velocity and GenForce must be consecutive");
 
-void TLMInterface1D::UnpackTimeData(TLMMessage &mess) {
-    Comm.UnpackTimeDataMessage1D(mess, TimeData);
-
-    NextRecvTime =  TimeData.back().time + Params.Delay;
-}
+TLMInterface1D::TLMInterface1D(TLMClientComm &theComm, std::string &aName, double StartTime, std::string Domain)
+    : TLMInterfaceT<TLMTimeData1D, 1>(theComm, aName, StartTime, "bidirectional", Domain) {}
 
 
 
@@ -45,83 +34,10 @@ void TLMInterface1D::GetTimeData(TLMTimeData1D& Instance) {
     }
 }
 
-// The GetTimeData methods read the Instance.time field and fills in
-// the other field by interpolating/extrapolating the available data.
-void TLMInterface1D::GetTimeData(TLMTimeData1D& Instance, std::deque<TLMTimeData1D>& Data, bool OnlyForce) {
-    double time = Instance.time;
+void TLMInterface1D::SetStartupData(TLMTimeData1D& Instance) {
+    Instance.GenForce = 0.0;
 
-    // find the appropriate time interval in the Data vector
-    const int size = Data.size();
-
-    if(size == 0) { // no data so far. Simulation startup
-        // The time before data is received is a problem:
-        // no way to handle simulation restart in a good way.
-        // We always assume no waves initially.
-        Instance.GenForce = 0.0;
-
-        Instance.Position = Params.cX_R_cG_cG[0]+Params.Nom_cI_R_cX_cX[0];  //TODO: TLMConnectionParams are hard-coded for 3D. How to solve this? //robbr
-
-        Instance.time = TLMPlugin::TIME_WITHOUT_DATA;
-
-        return;
-    }
-
-    // CurrentIntervalIndex is used to improve the speed of search in Data
-    if(CurrentIntervalIndex >= size) {
-        CurrentIntervalIndex =  size - 1;
-    }
-    if((time >= Data[0].time) && (time < Data[size-1].time)) {
-        // the desired time is in the Data boundaries
-        // find interpolation spot in data
-        while(Data[CurrentIntervalIndex].time < time)
-            CurrentIntervalIndex++;
-        while(Data[CurrentIntervalIndex].time > time)
-            CurrentIntervalIndex--;
-
-#if 0
-        // linear interpolation with Newton interpolation polynomial
-        if((CurrentIntervalIndex > 1) && (CurrentIntervalIndex < size - 2)) {
-            // we use cubic interpolation with 4 points if possible
-            deque<TLMTimeData>::iterator it(Data.begin() + (CurrentIntervalIndex-1));
-            hermite_interpolate(Instance, it, OnlyForce);
-        }
-        else
-#endif
-        {
-            // linear interpolation
-            InterpolateLinear(Instance, Data[CurrentIntervalIndex], Data[CurrentIntervalIndex+1],OnlyForce);
-        }
-    }
-    else {
-        if(time <= Data[0].time) {
-            if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Warning) {
-                TLMErrorLog::Warning(std::string("Interface ") + GetName() + " needs to extrapolate back time= " +
-                                     TLMErrorLog::ToStdStr(time));
-            }
-            Instance = Data[0];
-        }
-        else {
-            //Tolerance for fuzzy equal
-            double tol = 1e-10;
-            if(time <= Data[size-1].time+tol) {
-                Instance = Data[size-1];
-            }
-            else {
-                double terror = fabs(time-Data[size-1].time);
-                if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Warning) {
-                    TLMErrorLog::Warning(std::string("Interface ") + GetName() + " needs to extrapolate forward time= " +
-                                         TLMErrorLog::ToStdStr(time)+", time error = "+TLMErrorLog::ToStdStr(terror));
-                }
-                if(size > 1) {
-                    // linear extrapolation
-                    InterpolateLinear(Instance, Data[size-2], Data[size-1], OnlyForce);
-                }
-                else {
-                    Instance = Data[0];
-                }
-            }
-        }
-    }
+    Instance.Position = Params.cX_R_cG_cG[0]+Params.Nom_cI_R_cX_cX[0];  //TODO: TLMConnectionParams are hard-coded for 3D. How to solve this? //robbr
 }
 
 
@@ -143,11 +59,9 @@ void TLMInterface1D::GetForce(double time,
         TLMPlugin::GetForce1D(speed, request, Params, force);
     }
 
-    if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Warning) {
-        TLMErrorLog::Warning("Time = "+std::to_string(time)+
-                             ", GetForce(speed="+std::to_string(speed)+
-                             ") returns force="+std::to_string(*force));
-    }
+    TLM_LOG_DEBUG("Time = "+std::to_string(time)+
+                  ", GetForce(speed="+std::to_string(speed)+
+                  ") returns force="+std::to_string(*force));
 }
 
 void TLMInterface1D::GetWave(double time, double *wave) {
@@ -206,10 +120,8 @@ void TLMInterface1D::SetTimeData(double time,
         item.GenForce   = -item.GenForce   +  Params.Zf * speed;
     }
 
-    if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-        TLMErrorLog::Info(std::string("Interface ") + GetName() +
-                          " SET for time= " + TLMErrorLog::ToStdStr(time));
-    }
+    TLM_LOG_INFO(std::string("Interface ") + GetName() +
+                 " SET for time= " + TLMErrorLog::ToStdStr(time));
 
     // Send the data if we past the synchronization point or are in data request mode.
     if(time >= LastSendTime + Params.Delay / 2 || Params.mode > 0.0) {
@@ -223,22 +135,6 @@ void TLMInterface1D::SetTimeData(double time,
 }
 
 
-void TLMInterface1D::SendAllData() {
-    LastSendTime = DataToSend.back().time;
-
-    if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-        TLMErrorLog::Info(std::string("Interface ") + GetName() + " sends data for time= " +
-                          TLMErrorLog::ToStdStr(LastSendTime));
-    }
-
-    Comm.PackTimeDataMessage1D(InterfaceID, DataToSend, *Message);
-    TLMCommUtil::SendMessage(*Message);
-    DataToSend.resize(0);
-
-    // In data request mode we shutdown after sending the first data package.
-    if(Params.mode > 0.0) waitForShutdownFlg = true;
-}
-
 void TLMInterface1D::SetInitialForce(double force)
 {
   InitialForce = force;
@@ -249,6 +145,13 @@ void TLMInterface1D::SetInitialFlow(double flow)
   InitialFlow = flow;
 }
 
+void TLMInterface1D::ReserveTimeData(double maxStep)
+{
+  size_t n = EstimateHistorySize(maxStep);
+  TimeData.reserve(n);
+  if(Params.alpha > 0) DampedTimeData.reserve(n);
+}
+
 
 // linear_interpolate is called with a vector containing 2 points
 // computes the interpolation (or extrapolation) point with the the linear
@@ -276,8 +179,30 @@ void TLMInterface1D::InterpolateLinear(TLMTimeData1D& Instance, TLMTimeData1D& p
 }
 
 
-void TLMInterface1D::CleanTimeQueue(std::deque<TLMTimeData1D>& Data, double CleanTime) {
-    while((Data.size() > 3) && (CleanTime > Data[2].time)) {
-        Data.pop_front();
+void TLMInterface1D::InterpolateHermite(TLMTimeData1D& Instance, TLMTimeDataRing<TLMTimeData1D>& Data, int first, bool OnlyForce) {
+    TLMTimeData1D* p[4]; // pointers to the four data points
+    p[0] = &Data[first];
+    p[1] = &Data[first+1];
+    p[2] = &Data[first+2];
+    p[3] = &Data[first+3];
+
+    double time = Instance.time; // needed time point
+    double t[4]; // buffer for the four time points
+
+    int i = 4;
+    while(i-- > 0) t[i] = p[i]->time; // get the times
+
+    if(OnlyForce) {
+        // interpolate force "wave"
+        TLMInterpolation::Hermite(time, t, &p[0]->GenForce, &p[1]->GenForce,
+                                  &p[2]->GenForce, &p[3]->GenForce, &Instance.GenForce, 1);
+        return;
     }
+
+    // interpolate position, velocity and force "wave" at once
+    TLMInterpolation::Hermite(time, t, &p[0]->Position, &p[1]->Position,
+                              &p[2]->Position, &p[3]->Position, &Instance.Position, 3);
 }
+
+
+template class TLMInterfaceT<TLMTimeData1D, 1>;
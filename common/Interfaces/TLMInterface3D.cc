@@ -1,7 +1,7 @@
 #include "Interfaces/TLMInterface3D.h"
 #include "Communication/TLMCommUtil.h"
 #include "Plugin/TLMPlugin.h"
-#include <deque>
+#include <cstddef>
 #include <string>
 #include "double33.h"
 #include "double3.h"
@@ -9,25 +9,33 @@
 //TODO: This is used both by 1D and 3D, should probably be defined in one place. /robbr
 static const double TLM_DAMP_DELAY = 1.5;
 
+// InterpolateLinear treats the velocity and the force as one array
+static_assert(offsetof(TLMTimeData3D, GenForce) == offsetof(TLMTimeData3D, Velocity) + 6 * sizeof(double),
+              "TLMTimeData3D::GenForce must follow TLMTimeData3D::Velocity");
+
 TLMInterface3D::TLMInterface3D(TLMClientComm &theComm, std::string &aName, double StartTime, std::string Domain)
-    : omtlm_TLMInterface(theComm, aName, StartTime, 6, "bidirectional", Domain) {}
+    : TLMInterfaceT<TLMTimeData3D, 6>(theComm, aName, StartTime, "bidirectional", Domain) {
+    // The connection frame is known once the interface is registered
+    ToCG.Set(Params.cX_R_cG_cG, Params.cX_A_cG);
 
-TLMInterface3D::~TLMInterface3D() {
-    if(DataToSend.size() != 0) {
-        TLMErrorLog::Info(std::string("Interface ") + GetName() + " sends rest of data for time= " +
-                         TLMErrorLog::ToStdStr(DataToSend.back().time));
+    double ci_A_cG[9];
+    ToCG.ApplyPose(Params.Nom_cI_R_cX_cX, Params.Nom_cI_A_cX, NominalPosition, ci_A_cG);
 
-        Comm.PackTimeDataMessage3D(InterfaceID, DataToSend, *Message);
-        TLMCommUtil::SendMessage(*Message);
+    // The nominal orientation is reported column-wise
+    for(int i = 0; i < 9; i++) {
+        NominalRotMatrix[i] = ci_A_cG[3*(i%3) + i/3];
     }
-}
 
+    int method = int(Params.Interpolation) & TLMInterpolationConst::TLM_INTERP_ORIENTATION;
+    if(method != 0) {
+        TLMErrorLog::Info(std::string("Interface ") + GetName() + " interpolates the orientation by " +
+                          (method == TLMInterpolationConst::TLM_INTERP_SLERP ? "slerp" : "nlerp"));
+    }
+}
 
-void TLMInterface3D::UnpackTimeData(TLMMessage &mess) {
-    TLMErrorLog::Info(std::string("Interface ") + GetName());
-    Comm.UnpackTimeDataMessage3D(mess, TimeData);
-
-    NextRecvTime =  TimeData.back().time + Params.Delay;
+TLMInterface3D::~TLMInterface3D() {
+    // The base class sends the rest of the data, in cG as all the other data
+    TransformTimeDataToCG(DataToSend);
 }
 
 
@@ -51,105 +59,13 @@ void TLMInterface3D::GetTimeData(TLMTimeData3D& Instance) {
     }
 }
 
-// The GetTimeData methods read the Instance.time field and fills in
-// the other field by interpolating/extrapolating the available data.
-void TLMInterface3D::GetTimeData(TLMTimeData3D& Instance, std::deque<TLMTimeData3D>& Data, bool OnlyForce) {
-    double time = Instance.time;
-
-    // find the appropriate time interval in the Data vector
-    const int size = Data.size();
-
-    if(size == 0) { // no data so far. Simulation startup
-        // The time before data is received is a problem:
-        // no way to handle simulation restart in a good way.
-        // We always assume no waves initially.
-        int i = 0;
-        while(i < 6) {
-            Instance.GenForce[i++] = 0.0;
-        }
-
-        double3 ci_R_cX_cX(Params.Nom_cI_R_cX_cX[0], Params.Nom_cI_R_cX_cX[1], Params.Nom_cI_R_cX_cX[2]);
-        double33 ci_A_cX(Params.Nom_cI_A_cX[0], Params.Nom_cI_A_cX[1], Params.Nom_cI_A_cX[2],
-                Params.Nom_cI_A_cX[3], Params.Nom_cI_A_cX[4], Params.Nom_cI_A_cX[5],
-                Params.Nom_cI_A_cX[6], Params.Nom_cI_A_cX[7], Params.Nom_cI_A_cX[8]);
-
-        double3 cX_R_cG_cG(Params.cX_R_cG_cG[0], Params.cX_R_cG_cG[1], Params.cX_R_cG_cG[2]);
-        double33 cX_A_cG(Params.cX_A_cG[0], Params.cX_A_cG[1], Params.cX_A_cG[2],
-                Params.cX_A_cG[3], Params.cX_A_cG[4], Params.cX_A_cG[5],
-                Params.cX_A_cG[6], Params.cX_A_cG[7], Params.cX_A_cG[8]);
-
-        double33 ci_A_cG =  ci_A_cX*cX_A_cG;
-        double3 ci_R_cG_cG = cX_R_cG_cG + ci_R_cX_cX*cX_A_cG;
-
-        i = 0;
-        while(i < 3) {
-            Instance.Position[i] = ci_R_cG_cG(i+1);
-            i++;
-        }
-
-        i = 0;
-        while(i < 9) {
-            Instance.RotMatrix[i] = ci_A_cG((i%3)+1,(i/3)+1);
-            i++;
-        }
-
-        Instance.time = TLMPlugin::TIME_WITHOUT_DATA;
-
-        return;
+void TLMInterface3D::SetStartupData(TLMTimeData3D& Instance) {
+    for(int i = 0; i < 6; i++) {
+        Instance.GenForce[i] = 0.0;
     }
 
-    // CurrentIntervalIndex is used to improve the speed of search in Data
-    if(CurrentIntervalIndex >= size) {
-        CurrentIntervalIndex =  size - 1;
-    }
-    if((time >= Data[0].time) && (time < Data[size-1].time)) {
-        // the desired time is in the Data boundaries
-        // find interpolation spot in data
-        while(Data[CurrentIntervalIndex].time < time)
-            CurrentIntervalIndex++;
-        while(Data[CurrentIntervalIndex].time > time)
-            CurrentIntervalIndex--;
-
-#if 0
-        // linear interpolation with Newton interpolation polynomial
-        if((CurrentIntervalIndex > 1) && (CurrentIntervalIndex < size - 2)) {
-            // we use cubic interpolation with 4 points if possible
-            deque<TLMTimeData>::iterator it(Data.begin() + (CurrentIntervalIndex-1));
-            hermite_interpolate(Instance, it, OnlyForce);
-        }
-        else
-#endif
-        {
-            // linear interpolation
-            InterpolateLinear(Instance,
-                              Data[CurrentIntervalIndex], Data[CurrentIntervalIndex+1],OnlyForce);
-        }
-    }
-    else {
-        if(time <= Data[0].time) {
-            TLMErrorLog::Warning(std::string("Interface ") + GetName() + " needs to extrapolate back time= " +
-                                 TLMErrorLog::ToStdStr(time));
-            Instance = Data[0];
-        }
-        else {
-            //Tolerance for fuzzy equal
-            double tol = 1e-10;
-            if(time <= Data[size-1].time+tol) {
-                Instance = Data[size-1];
-            }
-            else {
-                TLMErrorLog::Warning(std::string("Interface ") + GetName() + " needs to extrapolate forward time= " +
-                                     TLMErrorLog::ToStdStr(time));
-                if(size > 1) {
-                    // linear extrapolation
-                    InterpolateLinear(Instance, Data[size-2], Data[size-1], OnlyForce);
-                }
-                else {
-                    Instance = Data[0];
-                }
-            }
-        }
-    }
+    memcpy(Instance.Position, NominalPosition, 3*sizeof(double));
+    memcpy(Instance.RotMatrix, NominalRotMatrix, 9*sizeof(double));
 }
 
 
@@ -240,23 +156,21 @@ void TLMInterface3D::SetTimeData(double time,
         item.GenForce[i+3] = -item.GenForce[i+3] +  Params.Zfr * ang_speed[i];
     }
 
-    if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-        TLMErrorLog::Info(std::string("Interface ") + GetName() +
-                         " SET for time= " + TLMErrorLog::ToStdStr(time)
-                         //  		     + " force:"
-                         //  		     + TLMErrorLog::ToStdStr(item.GenForce[0])+ ", "
-                         //  		     + TLMErrorLog::ToStdStr(item.GenForce[1])+ ", "
-                         //  		     + TLMErrorLog::ToStdStr(item.GenForce[2])+ ", "
-                         //  		     + " position:"
-                         //  		     + TLMErrorLog::ToStdStr(item.Position[0])+ ", "
-                         //  		     + TLMErrorLog::ToStdStr(item.Position[1])+ ", "
-                         //  		     + TLMErrorLog::ToStdStr(item.Position[2])+ ", "
-                         // 		     + "torque: "
-                         // 		     + TLMErrorLog::ToStdStr(item.GenForce[3])+ ", "
-                         // 		     + TLMErrorLog::ToStdStr(item.GenForce[4])+ ", "
-                         // 		     + TLMErrorLog::ToStdStr(item.GenForce[5]));
-                        );
-    }
+    TLM_LOG_INFO(std::string("Interface ") + GetName() +
+                " SET for time= " + TLMErrorLog::ToStdStr(time)
+                //  		     + " force:"
+                //  		     + TLMErrorLog::ToStdStr(item.GenForce[0])+ ", "
+                //  		     + TLMErrorLog::ToStdStr(item.GenForce[1])+ ", "
+                //  		     + TLMErrorLog::ToStdStr(item.GenForce[2])+ ", "
+                //  		     + " position:"
+                //  		     + TLMErrorLog::ToStdStr(item.Position[0])+ ", "
+                //  		     + TLMErrorLog::ToStdStr(item.Position[1])+ ", "
+                //  		     + TLMErrorLog::ToStdStr(item.Position[2])+ ", "
+                // 		     + "torque: "
+                // 		     + TLMErrorLog::ToStdStr(item.GenForce[3])+ ", "
+                // 		     + TLMErrorLog::ToStdStr(item.GenForce[4])+ ", "
+                // 		     + TLMErrorLog::ToStdStr(item.GenForce[5]));
+               );
 
     // Send the data if we past the synchronization point or are in data request mode.
     if(time >= LastSendTime + Params.Delay / 2 || Params.mode > 0.0) {
@@ -270,66 +184,17 @@ void TLMInterface3D::SetTimeData(double time,
 }
 
 
-void TLMInterface3D::TransformTimeDataToCG(std::vector<TLMTimeData3D>& timeData, TLMConnectionParams& params) {
-    std::vector<TLMTimeData3D>::iterator iter;
-    for(iter=timeData.begin(); iter!=timeData.end(); iter++) {
-        TLMTimeData3D& data = *iter;
-
-        double3 ci_R_cX_cX(data.Position[0], data.Position[1], data.Position[2]);
-        double33 ci_A_cX(data.RotMatrix[0], data.RotMatrix[1], data.RotMatrix[2],
-                data.RotMatrix[3], data.RotMatrix[4], data.RotMatrix[5],
-                data.RotMatrix[6], data.RotMatrix[7], data.RotMatrix[8]);
-
-        double3 cX_R_cG_cG(params.cX_R_cG_cG[0], params.cX_R_cG_cG[1], params.cX_R_cG_cG[2]);
-        double33 cX_A_cG(params.cX_A_cG[0], params.cX_A_cG[1], params.cX_A_cG[2],
-                params.cX_A_cG[3], params.cX_A_cG[4], params.cX_A_cG[5],
-                params.cX_A_cG[6], params.cX_A_cG[7], params.cX_A_cG[8]);
-
-        double33 ci_A_cG =  ci_A_cX*cX_A_cG;
-        double3 ci_R_cG_cG = cX_R_cG_cG + ci_R_cX_cX*cX_A_cG;
-
-        // Transform force and moment
-        double3 F_cG(data.GenForce[0], data.GenForce[1], data.GenForce[2]);
-        double3 M_cG(data.GenForce[3], data.GenForce[4], data.GenForce[5]);
-        F_cG = F_cG*cX_A_cG;
-        M_cG = M_cG*cX_A_cG;
-
-        // Transform velocity and angular-velocity
-        double3 vR_cG(data.Velocity[0], data.Velocity[1], data.Velocity[2]);
-        double3 Omega_cG(data.Velocity[3], data.Velocity[4], data.Velocity[5]);
-        vR_cG = vR_cG*cX_A_cG;
-        Omega_cG = Omega_cG*cX_A_cG;
-
-        // Store data
-        memcpy(data.Position, &ci_R_cG_cG(1), 3*sizeof(double));
-        memcpy(data.RotMatrix, &ci_A_cG(1,1), 9*sizeof(double));
-
-        memcpy(&data.GenForce[0], &F_cG(1), 3*sizeof(double));
-        memcpy(&data.GenForce[3], &M_cG(1), 3*sizeof(double));
-
-        memcpy(&data.Velocity[0], &vR_cG(1), 3*sizeof(double));
-        memcpy(&data.Velocity[3], &Omega_cG(1), 3*sizeof(double));
-    }
+void TLMInterface3D::TransformTimeDataToCG(std::vector<TLMTimeData3D>& timeData) {
+    if(timeData.empty()) return;
+    ToCG.Apply(&timeData[0], timeData.size());
 }
 
 
 void TLMInterface3D::SendAllData() {
-    LastSendTime = DataToSend.back().time;
-
-    if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-        TLMErrorLog::Info(std::string("Interface ") + GetName() + " sends data for time= " +
-                         TLMErrorLog::ToStdStr(LastSendTime));
-    }
-
     // Transform to global inertial system cG ans send
-    TransformTimeDataToCG(DataToSend, Params);
-
-    Comm.PackTimeDataMessage3D(InterfaceID, DataToSend, *Message);
-    TLMCommUtil::SendMessage(*Message);
-    DataToSend.resize(0);
+    TransformTimeDataToCG(DataToSend);
 
-    // In data request mode we shutdown after sending the first data package.
-    if(Params.mode > 0.0) waitForShutdownFlg = true;
+    TLMInterfaceT<TLMTimeData3D, 6>::SendAllData();
 }
 
 void TLMInterface3D::SetInitialForce(double f1, double f2, double f3, double t1, double t2, double t3)
@@ -352,6 +217,13 @@ void TLMInterface3D::SetInitialFlow(double v1, double v2, double v3, double w1,
   InitialFlow[5] = w3;
 }
 
+void TLMInterface3D::ReserveTimeData(double maxStep)
+{
+  size_t n = EstimateHistorySize(maxStep);
+  TimeData.reserve(n);
+  if(Params.alpha > 0) DampedTimeData.reserve(n);
+}
+
 
 // linear_interpolate is called with a vector containing 2 points
 // computes the interpolation (or extrapolation) point with the the linear
@@ -364,28 +236,19 @@ void TLMInterface3D::InterpolateLinear(TLMTimeData3D& Instance, TLMTimeData3D& p
     const double t0 = p0.time;
     const double t1 = p1.time;
 
-    int   j = 6;
-
-    while(j-- > 0) { // interpolate force "wave"
-        Instance.GenForce[j] =
-                omtlm_TLMInterface::linear_interpolate(time, t0, t1, p0.GenForce[j], p1.GenForce[j]);
+    if(OnlyForce) {
+        // interpolate force "wave"
+        TLMInterpolation::Linear(time, t0, t1, p0.GenForce, p1.GenForce, Instance.GenForce, 6);
+        return;
     }
 
-    if(OnlyForce) return;
-
-    // The rest is optional
+    // interpolate velocity and force "wave" in one go
+    TLMInterpolation::Linear(time, t0, t1, p0.Velocity, p1.Velocity, Instance.Velocity, 12);
 
-    j = 3;
-    while(j-- > 0) { // interpolate position
-        Instance.Position[j] =
-                omtlm_TLMInterface::linear_interpolate(time, t0, t1, p0.Position[j], p1.Position[j]);
-    }
+    // interpolate position
+    TLMInterpolation::Linear(time, t0, t1, p0.Position, p1.Position, Instance.Position, 3);
 
-    j = 6;
-    while(j-- > 0) { // interpolate velocity
-        Instance.Velocity[j] =
-                omtlm_TLMInterface::linear_interpolate(time, t0, t1, p0.Velocity[j], p1.Velocity[j]);
-    }
+    if(InterpolateQuaternion(Instance, p0, p1)) return;
 
     // interpolation of angles require special treatment.
     // We start by introducing relative angles between
@@ -405,7 +268,7 @@ void TLMInterface3D::InterpolateLinear(TLMTimeData3D& Instance, TLMTimeData3D& p
     A1 = A0.T() * A1;
     double3 phi = ATophi321(A1);
 
-    j = 4;
+    int j = 4;
     while(--j > 0) {
         phi(j) = omtlm_TLMInterface::linear_interpolate(time, t0, t1, 0.0, phi(j));
     }
@@ -423,18 +286,14 @@ void TLMInterface3D::InterpolateLinear(TLMTimeData3D& Instance, TLMTimeData3D& p
 // computes the interpolation point with the the polynomial that
 // interpolates point 2 and 3 and have the derivative in these points
 // equal to the center difference approximation at these points.
-// The points are submitted using the iterator 'it' giving the
-// first point in the sequence. The desired time is given
+// The points are Data[first] to Data[first+3]. The desired time is given
 // by the Instance.time. Results are stored in Instance
-void TLMInterface3D::InterpolateHermite(TLMTimeData3D& Instance, std::deque<TLMTimeData3D>::iterator& it, bool OnlyForce) {
-    TLMTimeData3D* p[4]; // pointers to the four data points, get them from iterators
-    p[0] = &(*it);
-    ++it;
-    p[1] = &(*it);
-    ++it;
-    p[2] = &(*it);
-    ++it;
-    p[3] = &(*it);
+void TLMInterface3D::InterpolateHermite(TLMTimeData3D& Instance, TLMTimeDataRing<TLMTimeData3D>& Data, int first, bool OnlyForce) {
+    TLMTimeData3D* p[4]; // pointers to the four data points
+    p[0] = &Data[first];
+    p[1] = &Data[first+1];
+    p[2] = &Data[first+2];
+    p[3] = &Data[first+3];
 
     double time = Instance.time; // needed time point
     double t[4]; // buffer for the four time points
@@ -443,28 +302,24 @@ void TLMInterface3D::InterpolateHermite(TLMTimeData3D& Instance, std::deque<TLMT
     int i = 4;
     while(i-- > 0) t[i] = p[i]->time; // get the times
 
-    int
-            j = 6;
-    while(j-- > 0) { // interpolate force "wave"
-        i = 4;
-        while(i-- > 0) {
-            f[i] = p[i]->GenForce[j];
-        }
-        Instance.GenForce[j] = omtlm_TLMInterface::InterpolateHermite(time, t, f);
+    if(OnlyForce) {
+        // interpolate force "wave"
+        TLMInterpolation::Hermite(time, t, p[0]->GenForce, p[1]->GenForce,
+                                  p[2]->GenForce, p[3]->GenForce, Instance.GenForce, 6);
+        return;
     }
 
-    if(OnlyForce) return;
-
     // The rest is optional
 
-    j = 3;
-    while(j-- > 0) { // interpolate position
-        i = 4;
-        while(i-- > 0) {
-            f[i] = p[i]->Position[j];
-        }
-        Instance.Position[j] = omtlm_TLMInterface::InterpolateHermite(time, t, f);
-    }
+    // Velocity and GenForce are contiguous, interpolate all 12 values at once
+    TLMInterpolation::Hermite(time, t, p[0]->Velocity, p[1]->Velocity,
+                              p[2]->Velocity, p[3]->Velocity, Instance.Velocity, 12);
+
+    // interpolate position
+    TLMInterpolation::Hermite(time, t, p[0]->Position, p[1]->Position,
+                              p[2]->Position, p[3]->Position, Instance.Position, 3);
+
+    if(InterpolateQuaternion(Instance, *p[1], *p[2])) return;
 
     // interpolation of angles require special treatment.
     // We start by introducing relative angles between
@@ -491,7 +346,7 @@ void TLMInterface3D::InterpolateHermite(TLMTimeData3D& Instance, std::deque<TLMT
 
     // interpolate angles
     double3 phi_out;
-    j = 4;
+    int j = 4;
     while(--j > 0) {
         i = 4;
         while(i-- > 0) {
@@ -509,8 +364,14 @@ void TLMInterface3D::InterpolateHermite(TLMTimeData3D& Instance, std::deque<TLMT
 }
 
 
-void TLMInterface3D::CleanTimeQueue(std::deque<TLMTimeData3D>& Data, double CleanTime) {
-    while((Data.size() > 3) && (CleanTime > Data[2].time)) {
-        Data.pop_front();
-    }
+bool TLMInterface3D::InterpolateQuaternion(TLMTimeData3D& Instance, TLMTimeData3D& p0, TLMTimeData3D& p1) {
+    int method = int(Params.Interpolation) & TLMInterpolationConst::TLM_INTERP_ORIENTATION;
+    if(method == 0) return false;
+
+    Orientation.Set(p0.time, p0.RotMatrix, p1.time, p1.RotMatrix);
+    Orientation.Interpolate(Instance.time, method == TLMInterpolationConst::TLM_INTERP_SLERP, Instance.RotMatrix);
+    return true;
 }
+
+
+template class TLMInterfaceT<TLMTimeData3D, 6>;
@@ -10,75 +10,88 @@
 #ifndef TLMINTERFACE3D_H
 #define TLMINTERFACE3D_H
 
-#include "Interfaces/TLMInterface.h"
+#include "Interfaces/TLMInterfaceT.h"
+#include "Interfaces/TLMInterpolation.h"
+#include "Interfaces/TLMFrameTransform.h"
 
 class TLMTimeData3D;
 
 //!
-//! TLMInterface1D provides the client side functionality for a single TLM interface of three dimensions
+//! TLMInterface3D provides the client side functionality for a single TLM interface of three dimensions
 //!
-class TLMInterface3D : public omtlm_TLMInterface {
+class TLMInterface3D : public TLMInterfaceT<TLMTimeData3D, 6> {
 public:
+    //! The kind of this interface class
+    static const TLMInterfaceKind KIND = TLM_INTERFACE_3D;
+
     TLMInterface3D(TLMClientComm& theComm, std::string& aName, double StartTime, std::string Domain="mechanical");
 
-    //! Destructor. Sends the rest of the data if necessary.
+    //! Destructor. Transforms the rest of the data that the base class sends.
     ~TLMInterface3D();
 
-    //!  TimeData is the deque of data received from the coupled simulation.
-    //!  The data is "pushed back" when received and "poped front" when the
-    //!  time goes forward more than  TLM delay and old data is not needed any longer.
-    std::deque<TLMTimeData3D> TimeData;
-
-    //!  DampedTimeData is the deque of data computed using damping coefficient alfa
+    //!  DampedTimeData is the ring of data computed using damping coefficient alfa
     //!  from TimeData.
     //!  The data is "pushed back" when computed and "poped front" when the
     //!  time goes forward more than TLM delay and old data is not needed any longer.
-    std::deque<TLMTimeData3D> DampedTimeData;
-
-    //!  DataToSend stores the motion data from the interface. The data is sent
-    //! in packet for a time period of [half] TLM delay [depends on solver type]
-    std::vector<TLMTimeData3D> DataToSend;
+    TLMTimeDataRing<TLMTimeData3D> DampedTimeData;
 
     double InitialForce[6] = {0,0,0,0,0,0};
     double InitialFlow[6]  = {0,0,0,0,0,0};
 
-    //! Evaluate the data from deque for the time specified by this Instance
-    //! If OnleForce is set, then the position and velocity are not computed.
-    void GetTimeData(TLMTimeData3D& Instance, std::deque<TLMTimeData3D>&  Data, bool OnlyForce);
+    using TLMInterfaceT<TLMTimeData3D, 6>::GetTimeData;
 
+    //! Evaluate the damped data for the time specified by this Instance
     void GetTimeData(TLMTimeData3D &Instance);
 
+    //! Fill in the data used before anything is received: no waves and
+    //! the nominal position.
+    void SetStartupData(TLMTimeData3D& Instance);
+
     void GetForce(double time, double position[], double orientation[], double speed[], double ang_speed[], double *force);
     void GetWave(double time, double *wave);
     void SetTimeData(double time, double position[], double orientation[], double speed[], double ang_speed[]);
-    void TransformTimeDataToCG(std::vector<TLMTimeData3D> &timeData, TLMConnectionParams &params);
+    //! Transform the time data from the connection frame cX to the global frame cG.
+    void TransformTimeDataToCG(std::vector<TLMTimeData3D> &timeData);
     void SendAllData();
     void SetInitialForce(double f1, double f2, double f3, double t1, double t2, double t3);
     void SetInitialFlow(double v1, double v2, double v3, double w1, double w2, double w3);
+    void ReserveTimeData(double maxStep);
 
     //! linear_interpolate is called with a vector containing 2 points
     //! computes the interpolation (or extrapolation) point with the the linear
     //! interpolation (extrapolation) The points are submitted using the p0 & p1
     //!  The desired time is given by the Instance.time. Results are stored in Instance.
     //! If OnleForce is set, then the position and velocity are not computed.
-    static void InterpolateLinear(TLMTimeData3D& Instance, TLMTimeData3D& p0, TLMTimeData3D& p1, bool OnlyForce);
+    //! The orientation is interpolated as selected in Params.Interpolation.
+    void InterpolateLinear(TLMTimeData3D& Instance, TLMTimeData3D& p0, TLMTimeData3D& p1, bool OnlyForce);
 
 
     //! hermite_interpolate is called with a vector containing 4 points
     //! computes the interpolation point with the the polynomial that
     //! interpolates point 2 and 3 and have the derivative in these points
     //! equal to the center difference approximation at these points.
-    //! The points are submitted using the iterator 'it' giving the
-    //! first point in the sequence. The desired time is given
+    //! The points are Data[first] to Data[first+3]. The desired time is given
     //! by the Instance.time. Results are stored in Instance.
     //! If OnleForce is set, then the position and velocity are not computed.
-    static void InterpolateHermite(TLMTimeData3D& Instance, std::deque<TLMTimeData3D>::iterator& it, bool OnlyForce);
-    void UnpackTimeData(TLMMessage &mess);
+    //! With quaternions the orientation is interpolated between points 2 and 3.
+    void InterpolateHermite(TLMTimeData3D& Instance, TLMTimeDataRing<TLMTimeData3D>& Data, int first, bool OnlyForce);
+
+private:
+
+    //! Interpolate the orientation between p0 and p1 with quaternions if
+    //! the connection asks for it. Returns 'false' for the default method.
+    bool InterpolateQuaternion(TLMTimeData3D& Instance, TLMTimeData3D& p0, TLMTimeData3D& p1);
+
+    //! The interval used last for the quaternion interpolation
+    TLMQuaternionInterval Orientation;
 
+    //! Transformation from the connection frame cX to cG, set from Params
+    TLMFrameTransform ToCG;
 
-    // Remove the data that is not needed (Simulation time moved forward)
-    // We leave two time points intact, so that interpolation work
-    static void CleanTimeQueue(std::deque<TLMTimeData3D> &Data, double CleanTime);
+    //! Nominal position and rotation matrix of the interface in cG,
+    //! reported before any data is received
+    double NominalPosition[3];
+    double NominalRotMatrix[9];
 };
 
 #endif // TLMINTERFACE3D_H
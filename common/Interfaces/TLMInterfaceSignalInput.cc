@@ -10,7 +10,7 @@
 static const double TLM_DAMP_DELAY = 1.5;
 
 TLMInterfaceInput::TLMInterfaceInput(TLMClientComm &theComm, std::string &aName, double StartTime, std::string Domain)
-    : TLMInterfaceSignal(theComm, aName, StartTime, 1, "input", Domain) {}
+    : TLMInterfaceSignal(theComm, aName, StartTime, "input", Domain) {}
 
 TLMInterfaceInput::~TLMInterfaceInput() {}
 
@@ -21,6 +21,10 @@ void TLMInterfaceInput::GetValue( double time,
     request.time = time - Params.Delay;
     GetTimeData(request);
 
+    // Remove the data that is not needed, leave a margin of one delay
+    // since the solver might step back.
+    CleanTimeQueue(TimeData, request.time - Params.Delay);
+
     //Default value is the initial value
     (*value)=InitialValue;
 
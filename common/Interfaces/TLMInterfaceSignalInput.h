@@ -17,6 +17,9 @@
 //!
 class TLMInterfaceInput : public TLMInterfaceSignal {
 public:
+  //! The kind of this interface class
+  static const TLMInterfaceKind KIND = TLM_INTERFACE_INPUT;
+
   TLMInterfaceInput(TLMClientComm &theComm, std::string &aName, double StartTime, std::string Domain="signal");
 
   //! Destructor. Sends the rest of the data if necessary.
@@ -10,19 +10,9 @@
 static const double TLM_DAMP_DELAY = 1.5;
 
 TLMInterfaceOutput::TLMInterfaceOutput(TLMClientComm &theComm, std::string &aName, double StartTime, std::string Domain)
-    : TLMInterfaceSignal(theComm, aName, StartTime, 1, "output", Domain) {}
+    : TLMInterfaceSignal(theComm, aName, StartTime, "output", Domain) {}
 
-TLMInterfaceOutput::~TLMInterfaceOutput() {
-    if(DataToSend.size() != 0) {
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info(std::string("Interface ") + GetName() + " sends rest of data for time= " +
-                              TLMErrorLog::ToStdStr(DataToSend.back().time));
-        }
-
-        Comm.PackTimeDataMessageSignal(InterfaceID, DataToSend, *Message);
-        TLMCommUtil::SendMessage(*Message);
-    }
-}
+TLMInterfaceOutput::~TLMInterfaceOutput() {}
 
 
 // Set motion data and communicate if necessary.
@@ -35,10 +25,8 @@ void TLMInterfaceOutput::SetTimeData(double time,
     item.time = time;
     item.Value = value;
 
-    if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-        TLMErrorLog::Info(std::string("Interface ") + GetName() +
-                          " SET for time= " + TLMErrorLog::ToStdStr(time));
-    }
+    TLM_LOG_INFO(std::string("Interface ") + GetName() +
+                 " SET for time= " + TLMErrorLog::ToStdStr(time));
 
     // Send the data if we past the synchronization point or are in data request mode.
     if(time >= LastSendTime + Params.Delay / 2 || Params.mode > 0.0 ) {
@@ -17,9 +17,12 @@
 //!
 class TLMInterfaceOutput : public TLMInterfaceSignal {
 public:
+  //! The kind of this interface class
+  static const TLMInterfaceKind KIND = TLM_INTERFACE_OUTPUT;
+
   TLMInterfaceOutput(TLMClientComm &theComm, std::string &aName, double StartTime, std::string Domain="signal");
 
-  //! Destructor. Sends the rest of the data if necessary.
+  //! Destructor. The base class sends the rest of the data if necessary.
   ~TLMInterfaceOutput();
 
   void SetTimeData(double time, double value);
@@ -0,0 +1,242 @@
+//!
+//! \file TLMInterfaceT.h
+//!
+//! Provides the TLMInterfaceT template with the time data handling shared
+//! by the 3D, 1D and signal interfaces
+//!
+
+#ifndef TLMInterfaceT_h_
+#define TLMInterfaceT_h_
+
+#include <cmath>
+#include <vector>
+#include "Interfaces/TLMInterface.h"
+#include "Communication/TLMTimeDataRing.h"
+#include "Logging/TLMTrace.h"
+#include "Plugin/TLMPlugin.h"
+
+class TLMInterface3D;
+class TLMInterface1D;
+class TLMInterfaceSignal;
+
+//! TLMTimeDataTraits tells TLMInterfaceT how to handle a time data type:
+//! the interface class using it and the message packing.
+template<class Payload>
+struct TLMTimeDataTraits;
+
+template<>
+struct TLMTimeDataTraits<TLMTimeData3D> {
+    typedef TLMInterface3D Interface;
+
+    static void Pack(int id, std::vector<TLMTimeData3D>& data, TLMMessage& mess, int encoding) {
+        TLMClientComm::PackTimeDataMessage3D(id, data, mess, encoding);
+    }
+    static void Unpack(TLMMessage& mess, TLMTimeDataRing<TLMTimeData3D>& data) {
+        TLMClientComm::UnpackTimeDataMessage3D(mess, data);
+    }
+};
+
+template<>
+struct TLMTimeDataTraits<TLMTimeData1D> {
+    typedef TLMInterface1D Interface;
+
+    static void Pack(int id, std::vector<TLMTimeData1D>& data, TLMMessage& mess, int) {
+        TLMClientComm::PackTimeDataMessage1D(id, data, mess);
+    }
+    static void Unpack(TLMMessage& mess, TLMTimeDataRing<TLMTimeData1D>& data) {
+        TLMClientComm::UnpackTimeDataMessage1D(mess, data);
+    }
+};
+
+template<>
+struct TLMTimeDataTraits<TLMTimeDataSignal> {
+    typedef TLMInterfaceSignal Interface;
+
+    static void Pack(int id, std::vector<TLMTimeDataSignal>& data, TLMMessage& mess, int) {
+        TLMClientComm::PackTimeDataMessageSignal(id, data, mess);
+    }
+    static void Unpack(TLMMessage& mess, TLMTimeDataRing<TLMTimeDataSignal>& data) {
+        TLMClientComm::UnpackTimeDataMessageSignal(mess, data);
+    }
+};
+
+//!
+//! TLMInterfaceT keeps the received and the outgoing time data of a TLM
+//! interface with Dim dimensions and implements what does not depend on
+//! the data type: receiving, sending, the history cleanup and the search
+//! for the interpolation interval. The interpolation itself is done by the
+//! interface class given by TLMTimeDataTraits<Payload>::Interface, which
+//! provides (without virtual calls):
+//!  - SetStartupData(Payload& Instance), the data before anything is received
+//!  - InterpolateLinear(Payload& Instance, Payload& p0, Payload& p1, bool OnlyForce)
+//!  - InterpolateHermite(Payload& Instance, TLMTimeDataRing<Payload>& Data, int first, bool OnlyForce)
+//!
+template<class Payload, int Dim>
+class TLMInterfaceT : public omtlm_TLMInterface {
+public:
+
+    //! The interface class of the time data
+    typedef typename TLMTimeDataTraits<Payload>::Interface Interface;
+
+    //! Constructor, registers the interface at the TLM manager.
+    TLMInterfaceT(TLMClientComm& theComm, std::string& aName, double StartTime,
+                  std::string causality, std::string domain)
+        : omtlm_TLMInterface(theComm, aName, StartTime, Dim, causality, domain) {}
+
+    //! Destructor. Sends the rest of the data if necessary.
+    ~TLMInterfaceT();
+
+    //!  TimeData is the ring of data received from the coupled simulation.
+    //!  The data is "pushed back" when received and "poped front" when the
+    //!  time goes forward more than  TLM delay and old data is not needed any longer.
+    TLMTimeDataRing<Payload> TimeData;
+
+    //!  DataToSend stores the data from the interface. The data is sent
+    //! in packet for a time period of [half] TLM delay [depends on solver type]
+    std::vector<Payload> DataToSend;
+
+    //! Unpack time data from a message into TimeData.
+    void Unpack(TLMMessage& mess) {
+        Stats.MessagesReceived.Add(1);
+        Stats.BytesReceived.Add(mess.Header.DataSize);
+        TLMTimeDataTraits<Payload>::Unpack(mess, TimeData);
+        NextRecvTime = TimeData.back().time + Params.Delay;
+    }
+
+    //! Unpack time data from a Message
+    void UnpackTimeData(TLMMessage& mess) { Unpack(mess); }
+
+    //! Send out the data from the DataToSend vector
+    void SendAllData();
+
+    //! Evaluate the data from the ring for the time specified by this Instance
+    //! If OnleForce is set, then the position and velocity are not computed.
+    void GetTimeData(Payload& Instance, TLMTimeDataRing<Payload>& Data, bool OnlyForce);
+
+    // Remove the data that is not needed (Simulation time moved forward)
+    // We leave two time points intact, so that interpolation work
+    static void CleanTimeQueue(TLMTimeDataRing<Payload>& Data, double CleanTime);
+
+protected:
+
+    //! Pack DataToSend into Message and send it.
+    void SendDataToSend() {
+        TLMTraceScope trace(TLM_TRACE_SEND_TIME_DATA, InterfaceID, DataToSend.back().time);
+        const uint64_t start = TLMStatistics::Now();
+        TLMTimeDataTraits<Payload>::Pack(InterfaceID, DataToSend, *Message, int(Params.Encoding));
+        Stats.MessagesSent.Add(1);
+        Stats.BytesSent.Add(Message->Header.DataSize);
+        SendTimeDataMessage();
+        Stats.Send.Add(TLMStatistics::Now() - start);
+    }
+
+private:
+
+    //! The interface class of this object
+    Interface& Self() { return static_cast<Interface&>(*this); }
+};
+
+
+template<class Payload, int Dim>
+TLMInterfaceT<Payload, Dim>::~TLMInterfaceT() {
+    if(DataToSend.size() != 0) {
+        TLM_LOG_INFO(std::string("Interface ") + GetName() + " sends rest of data for time= " +
+                     TLMErrorLog::ToStdStr(DataToSend.back().time));
+
+        SendDataToSend();
+    }
+}
+
+template<class Payload, int Dim>
+void TLMInterfaceT<Payload, Dim>::SendAllData() {
+    LastSendTime = DataToSend.back().time;
+
+    TLM_LOG_INFO(std::string("Interface ") + GetName() + " sends data for time= " +
+                 TLMErrorLog::ToStdStr(LastSendTime));
+
+    SendDataToSend();
+    DataToSend.resize(0);
+
+    // In data request mode we shutdown after sending the first data package.
+    if(Params.mode > 0.0) waitForShutdownFlg = true;
+}
+
+// The GetTimeData methods read the Instance.time field and fills in
+// the other field by interpolating/extrapolating the available data.
+template<class Payload, int Dim>
+void TLMInterfaceT<Payload, Dim>::GetTimeData(Payload& Instance, TLMTimeDataRing<Payload>& Data, bool OnlyForce) {
+    double time = Instance.time;
+
+    // find the appropriate time interval in the Data vector
+    const int size = Data.size();
+
+    if(size == 0) { // no data so far. Simulation startup
+        // The time before data is received is a problem:
+        // no way to handle simulation restart in a good way.
+        // We always assume no waves initially.
+        Self().SetStartupData(Instance);
+
+        Instance.time = TLMPlugin::TIME_WITHOUT_DATA;
+
+        return;
+    }
+
+    if((time >= Data[0].time) && (time < Data[size-1].time)) {
+        // the desired time is in the Data boundaries
+        // find interpolation spot in data
+        const int i = Data.FindInterval(time);
+
+        if((int(Params.Interpolation) & TLMInterpolationConst::TLM_INTERP_HERMITE)
+           && (i > 0) && (i < size - 2)) {
+            // cubic Hermite interpolation with 4 points if possible
+            Self().InterpolateHermite(Instance, Data, i-1, OnlyForce);
+        }
+        else {
+            // linear interpolation
+            Self().InterpolateLinear(Instance, Data[i], Data[i+1], OnlyForce);
+        }
+    }
+    else {
+        if(time <= Data[0].time) {
+            Stats.ExtrapolationsBack.Add(1);
+            TLM_LOG_WARNING(std::string("Interface ") + GetName() + " needs to extrapolate back time= " +
+                            TLMErrorLog::ToStdStr(time));
+            Instance = Data[0];
+        }
+        else {
+            //Tolerance for fuzzy equal
+            double tol = 1e-10;
+            if(time <= Data[size-1].time+tol) {
+                Instance = Data[size-1];
+            }
+            else {
+                Stats.ExtrapolationsForward.Add(1);
+                TLM_LOG_WARNING(std::string("Interface ") + GetName() + " needs to extrapolate forward time= " +
+                                TLMErrorLog::ToStdStr(time) + ", time error = " +
+                                TLMErrorLog::ToStdStr(fabs(time-Data[size-1].time)));
+                if(size > 1) {
+                    // linear extrapolation
+                    Self().InterpolateLinear(Instance, Data[size-2], Data[size-1], OnlyForce);
+                }
+                else {
+                    Instance = Data[0];
+                }
+            }
+        }
+    }
+}
+
+template<class Payload, int Dim>
+void TLMInterfaceT<Payload, Dim>::CleanTimeQueue(TLMTimeDataRing<Payload>& Data, double CleanTime) {
+    // Keep two points before CleanTime and at least three points
+    size_t n = Data.LowerBound(CleanTime);
+    if(n > Data.size() - 1) n = Data.size() - 1;
+    if(n > 2) Data.pop_front(n - 2);
+}
+
+// The interface classes instantiate their base in their source files
+extern template class TLMInterfaceT<TLMTimeData3D, 6>;
+extern template class TLMInterfaceT<TLMTimeData1D, 1>;
+extern template class TLMInterfaceT<TLMTimeDataSignal, 1>;
+
+#endif
@@ -0,0 +1,276 @@
+/**
+ * File: TLMInterpolation.cc
+ *
+ * Implementation of the interpolation kernels, the CPU dispatch and
+ * the quaternion interpolation
+ */
+#include "Interfaces/TLMInterpolation.h"
+#include "Communication/TLMCommUtil.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TLM_INTERPOLATION_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// The SIMD kernels are compiled for their instruction set only, the rest
+// of the code keeps the default target.
+#if defined(__GNUC__)
+#define TLM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define TLM_TARGET(isa)
+#endif
+
+//! Name of the selected kernels
+static const char* SelectedKernel = "scalar";
+
+//! Plain C++ kernel
+static void LinearScalar(double time, double t0, double t1,
+                         const double* f0, const double* f1, double* out, int n) {
+    const double a = time - t0;
+    const double b = time - t1;
+    const double d = t1 - t0;
+    for(int k = 0; k < n; k++) {
+        out[k] = (a * f1[k] - b * f0[k]) / d;
+    }
+}
+
+//! Plain C++ Hermite kernel
+static void HermiteScalar(const double c[4],
+                          const double* f0, const double* f1, const double* f2, const double* f3,
+                          double* out, int n) {
+    for(int k = 0; k < n; k++) {
+        out[k] = c[0] * f1[k] + c[1] * f2[k] + c[2] * (f2[k] - f0[k]) - c[3] * (f3[k] - f1[k]);
+    }
+}
+
+#ifdef TLM_INTERPOLATION_X86
+
+//! SSE2 kernel, two values at a time
+TLM_TARGET("sse2")
+static void LinearSSE2(double time, double t0, double t1,
+                       const double* f0, const double* f1, double* out, int n) {
+    const __m128d a = _mm_set1_pd(time - t0);
+    const __m128d b = _mm_set1_pd(time - t1);
+    const __m128d d = _mm_set1_pd(t1 - t0);
+
+    int k = 0;
+    for(; k + 2 <= n; k += 2) {
+        __m128d v = _mm_sub_pd(_mm_mul_pd(a, _mm_loadu_pd(f1 + k)),
+                               _mm_mul_pd(b, _mm_loadu_pd(f0 + k)));
+        _mm_storeu_pd(out + k, _mm_div_pd(v, d));
+    }
+    if(k < n) {
+        __m128d v = _mm_sub_sd(_mm_mul_sd(a, _mm_load_sd(f1 + k)),
+                               _mm_mul_sd(b, _mm_load_sd(f0 + k)));
+        _mm_store_sd(out + k, _mm_div_sd(v, d));
+    }
+}
+
+//! SSE2 Hermite kernel
+TLM_TARGET("sse2")
+static void HermiteSSE2(const double c[4],
+                       const double* f0, const double* f1, const double* f2, const double* f3,
+                       double* out, int n) {
+    const __m128d ca = _mm_set1_pd(c[0]);
+    const __m128d cb = _mm_set1_pd(c[1]);
+    const __m128d cpa = _mm_set1_pd(c[2]);
+    const __m128d cpb = _mm_set1_pd(c[3]);
+
+    int k = 0;
+    for(; k + 2 <= n; k += 2) {
+        __m128d v0 = _mm_loadu_pd(f0 + k);
+        __m128d v1 = _mm_loadu_pd(f1 + k);
+        __m128d v2 = _mm_loadu_pd(f2 + k);
+        __m128d v3 = _mm_loadu_pd(f3 + k);
+        __m128d v = _mm_add_pd(_mm_mul_pd(ca, v1), _mm_mul_pd(cb, v2));
+        v = _mm_add_pd(v, _mm_mul_pd(cpa, _mm_sub_pd(v2, v0)));
+        v = _mm_sub_pd(v, _mm_mul_pd(cpb, _mm_sub_pd(v3, v1)));
+        _mm_storeu_pd(out + k, v);
+    }
+    for(; k < n; k++) {
+        out[k] = c[0] * f1[k] + c[1] * f2[k] + c[2] * (f2[k] - f0[k]) - c[3] * (f3[k] - f1[k]);
+    }
+}
+
+//! AVX kernel, four values at a time
+TLM_TARGET("avx")
+static void LinearAVX(double time, double t0, double t1,
+                      const double* f0, const double* f1, double* out, int n) {
+    const __m256d a = _mm256_set1_pd(time - t0);
+    const __m256d b = _mm256_set1_pd(time - t1);
+    const __m256d d = _mm256_set1_pd(t1 - t0);
+
+    int k = 0;
+    for(; k + 4 <= n; k += 4) {
+        __m256d v = _mm256_sub_pd(_mm256_mul_pd(a, _mm256_loadu_pd(f1 + k)),
+                                  _mm256_mul_pd(b, _mm256_loadu_pd(f0 + k)));
+        _mm256_storeu_pd(out + k, _mm256_div_pd(v, d));
+    }
+    if(k + 2 <= n) {
+        __m128d v = _mm_sub_pd(_mm_mul_pd(_mm256_castpd256_pd128(a), _mm_loadu_pd(f1 + k)),
+                               _mm_mul_pd(_mm256_castpd256_pd128(b), _mm_loadu_pd(f0 + k)));
+        _mm_storeu_pd(out + k, _mm_div_pd(v, _mm256_castpd256_pd128(d)));
+        k += 2;
+    }
+    if(k < n) {
+        __m128d v = _mm_sub_sd(_mm_mul_sd(_mm256_castpd256_pd128(a), _mm_load_sd(f1 + k)),
+                               _mm_mul_sd(_mm256_castpd256_pd128(b), _mm_load_sd(f0 + k)));
+        _mm_store_sd(out + k, _mm_div_sd(v, _mm256_castpd256_pd128(d)));
+    }
+}
+
+//! AVX Hermite kernel
+TLM_TARGET("avx")
+static void HermiteAVX(const double c[4],
+                      const double* f0, const double* f1, const double* f2, const double* f3,
+                      double* out, int n) {
+    const __m256d ca = _mm256_set1_pd(c[0]);
+    const __m256d cb = _mm256_set1_pd(c[1]);
+    const __m256d cpa = _mm256_set1_pd(c[2]);
+    const __m256d cpb = _mm256_set1_pd(c[3]);
+
+    int k = 0;
+    for(; k + 4 <= n; k += 4) {
+        __m256d v0 = _mm256_loadu_pd(f0 + k);
+        __m256d v1 = _mm256_loadu_pd(f1 + k);
+        __m256d v2 = _mm256_loadu_pd(f2 + k);
+        __m256d v3 = _mm256_loadu_pd(f3 + k);
+        __m256d v = _mm256_add_pd(_mm256_mul_pd(ca, v1), _mm256_mul_pd(cb, v2));
+        v = _mm256_add_pd(v, _mm256_mul_pd(cpa, _mm256_sub_pd(v2, v0)));
+        v = _mm256_sub_pd(v, _mm256_mul_pd(cpb, _mm256_sub_pd(v3, v1)));
+        _mm256_storeu_pd(out + k, v);
+    }
+    for(; k < n; k++) {
+        out[k] = c[0] * f1[k] + c[1] * f2[k] + c[2] * (f2[k] - f0[k]) - c[3] * (f3[k] - f1[k]);
+    }
+}
+
+//! Check which instruction sets the CPU and the OS support.
+static void DetectCPU(bool& sse2, bool& avx) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    sse2 = (info[3] & (1 << 26)) != 0;
+    // AVX needs the OS to save the YMM registers
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    avx = osxsave && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+#elif defined(__GNUC__)
+    __builtin_cpu_init();
+    sse2 = __builtin_cpu_supports("sse2");
+    avx = __builtin_cpu_supports("avx");
+#else
+    sse2 = false;
+    avx = false;
+#endif
+}
+
+#endif
+
+TLMInterpolation::LinearKernel TLMInterpolation::LinearFunc = LinearScalar;
+TLMInterpolation::HermiteKernel TLMInterpolation::HermiteFunc = HermiteScalar;
+bool TLMInterpolation::Selected = TLMInterpolation::SelectKernels();
+
+bool TLMInterpolation::SelectKernels() {
+#ifdef TLM_INTERPOLATION_X86
+    bool sse2 = false;
+    bool avx = false;
+    DetectCPU(sse2, avx);
+
+    if(avx) {
+        SelectedKernel = "AVX";
+        LinearFunc = LinearAVX;
+        HermiteFunc = HermiteAVX;
+        return true;
+    }
+    if(sse2) {
+        SelectedKernel = "SSE2";
+        LinearFunc = LinearSSE2;
+        HermiteFunc = HermiteSSE2;
+        return true;
+    }
+#endif
+    SelectedKernel = "scalar";
+    LinearFunc = LinearScalar;
+    HermiteFunc = HermiteScalar;
+    return true;
+}
+
+void TLMInterpolation::Hermite(double time, const double t[4],
+                               const double* f0, const double* f1, const double* f2, const double* f3,
+                               double* out, int n) {
+    const double ta = t[1];
+    const double tb = t[2];
+    const double bma = tb - ta;
+    const double xa = (time - ta) / bma;
+    const double bx = (tb - time) / bma;
+
+    // Weights of the values and of the central differences at ta and tb
+    double c[4];
+    c[0] = (1 + 2*xa) * bx * bx;
+    c[1] = (1 + 2*bx) * xa * xa;
+    c[2] = xa * bx * (tb - time) / (t[2] - t[0]);
+    c[3] = xa * bx * (time - ta) / (t[3] - t[1]);
+
+    HermiteFunc(c, f0, f1, f2, f3, out, n);
+}
+
+const char* TLMInterpolation::KernelName() {
+    return SelectedKernel;
+}
+
+
+//! Below this angle between the quaternions slerp is replaced by nlerp,
+//! the two agree to rounding and slerp would divide by a tiny sine.
+static const double TLM_SLERP_MIN_ANGLE = 1e-6;
+
+TLMQuaternionInterval::TLMQuaternionInterval()
+    : T0(0.0)
+    , T1(0.0)
+    , Theta(0.0)
+    , SinTheta(0.0) {
+    Q0[0] = Q1[0] = 1.0;
+    Q0[1] = Q0[2] = Q0[3] = 0.0;
+    Q1[1] = Q1[2] = Q1[3] = 0.0;
+}
+
+void TLMQuaternionInterval::Set(double t0, const double* A0, double t1, const double* A1) {
+    if(t0 == T0 && t1 == T1 && T0 != T1) return;
+
+    TLMCommUtil::MatrixToQuaternion(A0, Q0);
+    TLMCommUtil::MatrixToQuaternion(A1, Q1);
+
+    // q and -q are the same rotation, take the shorter way
+    double dot = Q0[0]*Q1[0] + Q0[1]*Q1[1] + Q0[2]*Q1[2] + Q0[3]*Q1[3];
+    if(dot < 0.0) {
+        for(int i = 0; i < 4; i++) Q1[i] = -Q1[i];
+        dot = -dot;
+    }
+    if(dot > 1.0) dot = 1.0;
+
+    Theta = acos(dot);
+    SinTheta = sin(Theta);
+    T0 = t0;
+    T1 = t1;
+}
+
+void TLMQuaternionInterval::Interpolate(double time, bool spherical, double* A) const {
+    const double s = (time - T0) / (T1 - T0);
+
+    double w0 = 1.0 - s;
+    double w1 = s;
+    if(spherical && Theta > TLM_SLERP_MIN_ANGLE) {
+        w0 = sin((1.0 - s) * Theta) / SinTheta;
+        w1 = sin(s * Theta) / SinTheta;
+    }
+
+    // QuaternionToMatrix normalizes, which makes the linear blend an nlerp
+    double q[4];
+    for(int i = 0; i < 4; i++) {
+        q[i] = w0 * Q0[i] + w1 * Q1[i];
+    }
+    TLMCommUtil::QuaternionToMatrix(q, A);
+}
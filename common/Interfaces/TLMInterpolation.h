@@ -0,0 +1,91 @@
+//!
+//! \file TLMInterpolation.h
+//!
+//! Provides vectorized interpolation kernels and the quaternion
+//! interpolation of orientations for the TLM interfaces
+//!
+
+#ifndef TLMInterpolation_h_
+#define TLMInterpolation_h_
+
+//! TLMInterpolation interpolates arrays of doubles with the best kernels
+//! the CPU supports (AVX, SSE2 or plain C++). The kernels are chosen once,
+//! when the library is loaded. All kernels of a method do the same
+//! operations, so the results do not depend on the CPU. The linear ones
+//! match omtlm_TLMInterface::linear_interpolate.
+class TLMInterpolation {
+public:
+
+    //! Linear interpolation (or extrapolation) of n values,
+    //! out[k] = ((time - t0) * f1[k] - (time - t1) * f0[k]) / (t1 - t0)
+    static void Linear(double time, double t0, double t1,
+                       const double* f0, const double* f1, double* out, int n) {
+        LinearFunc(time, t0, t1, f0, f1, out, n);
+    }
+
+    //! Cubic Hermite interpolation of n values given at the four time
+    //! points t[0] < t[1] <= time <= t[2] < t[3]. The polynomial
+    //! interpolates the values at t[1] and t[2], the derivatives there are
+    //! the central differences, as in omtlm_TLMInterface::InterpolateHermite.
+    static void Hermite(double time, const double t[4],
+                        const double* f0, const double* f1, const double* f2, const double* f3,
+                        double* out, int n);
+
+    //! Name of the kernels in use, for logging.
+    static const char* KernelName();
+
+private:
+
+    //! Signature of the linear interpolation kernels
+    typedef void (*LinearKernel)(double time, double t0, double t1,
+                                 const double* f0, const double* f1, double* out, int n);
+
+    //! Signature of the Hermite kernels, out[k] = c[0] * f1[k] + c[1] * f2[k]
+    //! + c[2] * (f2[k] - f0[k]) - c[3] * (f3[k] - f1[k])
+    typedef void (*HermiteKernel)(const double c[4],
+                                  const double* f0, const double* f1, const double* f2, const double* f3,
+                                  double* out, int n);
+
+    //! The kernels in use
+    static LinearKernel LinearFunc;
+    static HermiteKernel HermiteFunc;
+
+    //! Set when the kernels are selected
+    static bool Selected;
+
+    //! Select the kernels for this CPU.
+    static bool SelectKernels();
+};
+
+//! TLMQuaternionInterval interpolates the orientation between two time
+//! points with unit quaternions, either by slerp or by nlerp. The
+//! quaternions and the angle between them are kept, so that the many
+//! time instances requested within the same interval only pay for the
+//! interpolation itself.
+class TLMQuaternionInterval {
+public:
+
+    //! Constructor
+    TLMQuaternionInterval();
+
+    //! Set the interval between the row-wise rotation matrices A0 at t0
+    //! and A1 at t1. Does nothing if it is the current interval.
+    void Set(double t0, const double* A0, double t1, const double* A1);
+
+    //! Interpolate (or extrapolate) the rotation matrix at the given time
+    //! into A, by slerp if "spherical" is set and by nlerp otherwise.
+    void Interpolate(double time, bool spherical, double* A) const;
+
+private:
+
+    //! Time points of the interval, T0 == T1 if no interval is set.
+    double T0, T1;
+
+    //! Unit quaternions at T0 and T1, Q1 is on the same hemisphere as Q0.
+    double Q0[4], Q1[4];
+
+    //! Angle between Q0 and Q1 (half the rotation angle) and its sine
+    double Theta, SinTheta;
+};
+
+#endif
@@ -5,7 +5,9 @@
 */
 
 #include "Logging/TLMErrorLog.h"
+#include "Logging/TLMLogSink.h"
 #include "Communication/TLMThreadSynch.h"
+#include <atomic>
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
@@ -49,17 +51,92 @@ bool  TLMErrorLog::LogTimeOn = false;
 std::ostream* TLMErrorLog::outStream = NULL;
 SimpleLock TLMErrorLog::LogStreamLock = SimpleLock();
 
+//! Number of log lines the background writer may lag behind
+static const size_t TLM_LOG_RING_SIZE = 1 << 12;
+
+//! The background writer, created by Open() and never deleted, so that
+//! it outlives the static objects that log in their destructors.
+static std::atomic<TLMLogSink*> Sink(NULL);
+
+//! Write the queued lines at exit, the lines logged later are written
+//! directly.
+static void StopSink() {
+    Sink.load()->Suspend();
+}
+
+//! Write the queued lines and keep the writer stopped until ResumeSink,
+//! so that the caller can use the stream alone with LogStreamLock.
+static void SuspendSink() {
+    TLMLogSink* sink = Sink.load(std::memory_order_acquire);
+    if(sink != NULL) sink->Suspend();
+}
+
+static void ResumeSink() {
+    TLMLogSink* sink = Sink.load(std::memory_order_acquire);
+    if(sink != NULL) sink->Resume();
+}
+
+#if !defined(SKIP_PTHREADS) && !(defined(WIN32) || defined(__MINGW32__))
+//! Write the queued lines before fork(), the child would otherwise
+//! write the stream buffer a second time.
+static void SinkBeforeFork() {
+    TLMErrorLog::Flush();
+}
+
+//! The writer thread is not copied by fork().
+static void SinkAfterFork() {
+    Sink.load()->AfterFork();
+}
+#endif
+
 void TLMErrorLog::Open() {
+    // The sink is created last, outStream is read under LogStreamLock only
+    if(Sink.load(std::memory_order_acquire) != NULL) return;
+
     LogStreamLock.lock();
     if(TLMErrorLog::outStream==NULL) {
         TLMErrorLog::outStream=new std::ofstream("TLMlogfile.log");
         *outStream << TimeStr() << " Starting log" << std::endl;
     }
+    if(Sink.load(std::memory_order_relaxed) == NULL) {
+        Sink.store(new TLMLogSink(TLM_LOG_RING_SIZE, &outStream, LogStreamLock), std::memory_order_release);
+        atexit(StopSink);
+#if !defined(SKIP_PTHREADS) && !(defined(WIN32) || defined(__MINGW32__))
+        pthread_atfork(SinkBeforeFork, NULL, SinkAfterFork);
+#endif
+    }
+    LogStreamLock.unlock();
+}
+
+void TLMErrorLog::SetOutStream(std::ostream& of) {
+    SuspendSink();
+    LogStreamLock.lock();
+    if(outStream != NULL) outStream->flush();
+    outStream = &of;
+    LogStreamLock.unlock();
+    ResumeSink();
+}
+
+void TLMErrorLog::Flush() {
+    SuspendSink();
+    LogStreamLock.lock();
+    if(outStream != NULL) outStream->flush();
+    LogStreamLock.unlock();
+    ResumeSink();
+}
+
+void TLMErrorLog::Write(const char* Label, const std::string& mess) {
+    Open();
+    if(Sink.load(std::memory_order_relaxed)->Put(TimeStr(), Label, mess)) return;
+
+    LogStreamLock.lock();
+    if(outStream != NULL) *outStream << TimeStr() << Label << mess << std::endl;
     LogStreamLock.unlock();
 }
 
 void TLMErrorLog::Close()
 {
+  SuspendSink();
   LogStreamLock.lock();
   if(outStream!=nullptr) {
     *outStream << TimeStr() << " Log finished." << std::endl;
@@ -68,21 +145,27 @@ void TLMErrorLog::Close()
     LogLevel = Disabled;
   }
   LogStreamLock.unlock();
+  ResumeSink();
 }
 
 
 // FatalError function writes a message to log file
 // then terminates the program abnormally.
 void TLMErrorLog::FatalError(const std::string& mess) {
+    // Write the queued messages first and keep the writer stopped, the
+    // lines logged from now on are written directly after the fatal error.
     Open();
+    SuspendSink();
     std::cout << TimeStr() << " Fatal error: " << mess << std::endl;
-    *outStream << TimeStr() << " Fatal error: " << mess << std::endl;
+    LogStreamLock.lock();
+    if(outStream != NULL) *outStream << TimeStr() << " Fatal error: " << mess << std::endl;
+    LogStreamLock.unlock();
+#ifdef USE_ERRORLOG
     if(NormalErrorLogOn) {
         _strtime(tmpbuf);
-#ifdef USE_ERRORLOG
         Error("TMLLog:"+Bstring(tmpbuf)+" "+mess);
-#endif
     }
+#endif
 
     if(!ExceptionOn) {
 #ifdef DEBUGFLG
@@ -92,6 +175,7 @@ void TLMErrorLog::FatalError(const std::string& mess) {
         exit(1);
     }
     else {
+        ResumeSink();
         throw mess;
     }
 }
@@ -100,43 +184,39 @@ void TLMErrorLog::FatalError(const std::string& mess) {
 //
 void  TLMErrorLog::Warning(const std::string& mess) {
     if(LogLevel < TLMLogLevel::Warning) return;
-    Open();
-    //std::cout << TimeStr() << " Warning: " << mess << std::endl;
-    *outStream << TimeStr() << " Warning: " << mess << std::endl;
+    Write(" Warning: ", mess);
 
+#ifdef USE_ERRORLOG
     if(NormalErrorLogOn) {
         _strtime(tmpbuf);
-#ifdef USE_ERRORLOG
         ::Warning("TMLLog:"+Bstring(tmpbuf)+" "+mess);
-#endif
     }
+#endif
 }
 
 // Log function logs a message to log file
 void  TLMErrorLog::Info(const std::string& mess) {
     if(LogLevel < TLMLogLevel::Info) return;
-    Open();
-    *outStream << TimeStr() << " Info: " << mess << std::endl;
+    Write(" Info: ", mess);
+#ifdef USE_ERRORLOG
     if(NormalErrorLogOn) {
         _strtime(tmpbuf);
-#ifdef USE_ERRORLOG
         Log1("TMLLog:"+Bstring(tmpbuf)+" "+mess);
-#endif
     }
+#endif
 }
 
 
 // Log function logs a message to log file
 void  TLMErrorLog::Debug(const std::string& mess) {
     if(LogLevel < TLMLogLevel::Debug) return;
-    Open();
-    *outStream << TimeStr() << " Debug: " << mess << std::endl;
+    Write(" Debug: ", mess);
+#ifdef USE_ERRORLOG
     if(NormalErrorLogOn) {
         _strtime(tmpbuf);
-#ifdef USE_ERRORLOG
         Log1("TMLLog:"+Bstring(tmpbuf)+" "+mess);
-#endif
     }
+#endif
 }
 
 
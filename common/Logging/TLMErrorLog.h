@@ -18,6 +18,36 @@
 
 enum TLMLogLevel { Disabled, Fatal, Warning, Info, Debug };
 
+//! TLM_MAX_LOG_LEVEL is the highest log level compiled in by the logging
+//! macros below, e.g., build with -DTLM_MAX_LOG_LEVEL=2 to remove the Info
+//! and Debug messages. Default is 4 (Debug).
+#ifndef TLM_MAX_LOG_LEVEL
+#define TLM_MAX_LOG_LEVEL 4
+#endif
+
+//! The logging macros check the log level before the message is evaluated,
+//! so a disabled message costs a compare and builds no strings:
+//! TLM_LOG_INFO("Interface " + name + " got data").
+#define TLM_LOG_WARNING(mess) do { \
+        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Warning) TLMErrorLog::Warning(mess); \
+    } while(0)
+
+#if TLM_MAX_LOG_LEVEL >= 3
+#define TLM_LOG_INFO(mess) do { \
+        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) TLMErrorLog::Info(mess); \
+    } while(0)
+#else
+#define TLM_LOG_INFO(mess) do { } while(0)
+#endif
+
+#if TLM_MAX_LOG_LEVEL >= 4
+#define TLM_LOG_DEBUG(mess) do { \
+        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Debug) TLMErrorLog::Debug(mess); \
+    } while(0)
+#else
+#define TLM_LOG_DEBUG(mess) do { } while(0)
+#endif
+
 //! Error handling is implemented in the most simple way
 //! with the functions that write messages to standard error output (cerr).
 //! In addition FatalError calls abort() to terminate the application.
@@ -58,7 +88,7 @@ public:
 
     //! Sets the output stream for output of all log, warning, and error messages.
     //! Default output stream id std::cout
-    static void SetOutStream(std::ostream& of) { outStream = &of; }
+    static void SetOutStream(std::ostream& of);
 
     //! Sets the error mode to exception instead of abort()/exit().
     //! When exception mode is on TLMErrorLog will throw an exception on fatal error.
@@ -71,6 +101,9 @@ public:
     //! Return current time as string.
     static std::string TimeStr();
 
+    //! Write the queued messages and flush the log.
+    static void Flush();
+
     static void Close();
 private:
 
@@ -96,6 +129,10 @@ private:
 
     //! Open log file
     static  void Open();
+
+    //! Write a message with the given label. The line is queued for the
+    //! background writer if there is one, otherwise it is written here.
+    static void Write(const char* Label, const std::string& mess);
 };
 
 
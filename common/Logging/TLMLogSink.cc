@@ -0,0 +1,198 @@
+/**
+ * File: TLMLogSink.cc
+ *
+ * Implementation of the background log writer
+ */
+#include "Logging/TLMLogSink.h"
+
+//! Number of yields before the writer flushes the stream and parks.
+//! The writer does not spin, logging is not worth a busy CPU.
+static const int TLM_LOG_YIELD = 20;
+
+
+TLMLogSink::TLMLogSink(size_t size, std::ostream* const* stream, SimpleLock& streamLock)
+    : Cells(new Cell[size])
+    , Mask(size - 1)
+    , EnqueuePos(0)
+    , DequeuePos(0)
+    , Stream(stream)
+    , StreamLock(streamLock)
+    , Stopping(false)
+    , ParkLock()
+    , DataWait()
+    , WriterParked(false)
+    , ControlLock()
+    , Running(false)
+    , Disabled(false)
+    , Suspended(0)
+    , Putting(0) {
+    for(size_t i = 0; i < size; i++) {
+        Cells[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+TLMLogSink::~TLMLogSink() {
+    Stop();
+    delete[] Cells;
+}
+
+bool TLMLogSink::Put(const std::string& Time, const char* Label, const std::string& mess) {
+    // Pairs with Suspend: either we see the suspension or Suspend waits
+    // until our line is in the ring.
+    Putting.fetch_add(1, std::memory_order_seq_cst);
+    if(Suspended.load(std::memory_order_seq_cst) != 0
+       || (!Running.load(std::memory_order_acquire) && !Start())) {
+        Putting.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    Cell* cell;
+    size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+    for(;;) {
+        cell = &Cells[pos & Mask];
+        const size_t seq = cell->Sequence.load(std::memory_order_acquire);
+        const ptrdiff_t dif = ptrdiff_t(seq) - ptrdiff_t(pos);
+        if(dif == 0) {
+            if(EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if(dif < 0) {
+            // Full, wait for the writer instead of dropping the line
+            YieldThread();
+            pos = EnqueuePos.load(std::memory_order_relaxed);
+        }
+        else {
+            pos = EnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // The string keeps its capacity from the previous lap
+    cell->Text.assign(Time).append(Label).append(mess);
+    cell->Sequence.store(pos + 1, std::memory_order_release);
+
+    // Pairs with the fence in WriterRun: either the writer sees the
+    // line before parking or we see that it is parked.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(WriterParked.load(std::memory_order_relaxed)) {
+        ParkLock.lock();
+        DataWait.signal();
+        ParkLock.unlock();
+    }
+    Putting.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool TLMLogSink::Start() {
+#ifdef SKIP_PTHREADS
+    return false;
+#else
+    if(Disabled.load(std::memory_order_relaxed)) return false;
+
+    AutoLock lock(ControlLock);
+    if(Running.load(std::memory_order_relaxed)) return true;
+
+    Stopping = false;
+    if(pthread_create(&Thread, NULL, ThreadRun, this) != 0) {
+        Disabled = true;
+        return false;
+    }
+    Running.store(true, std::memory_order_release);
+    return true;
+#endif
+}
+
+void TLMLogSink::Stop() {
+    if(!Running.load(std::memory_order_acquire)) return;
+
+    AutoLock lock(ControlLock);
+    if(!Running.load(std::memory_order_relaxed)) return;
+
+    ParkLock.lock();
+    Stopping = true;
+    DataWait.signal();
+    ParkLock.unlock();
+
+#ifndef SKIP_PTHREADS
+    pthread_join(Thread, NULL);
+#endif
+    Running.store(false, std::memory_order_release);
+}
+
+void TLMLogSink::Suspend() {
+    Suspended.fetch_add(1, std::memory_order_seq_cst);
+    while(Putting.load(std::memory_order_seq_cst) != 0) {
+        YieldThread();
+    }
+    // The writer exits only when the ring is empty
+    Stop();
+}
+
+void TLMLogSink::Resume() {
+    Suspended.fetch_sub(1, std::memory_order_release);
+}
+
+void TLMLogSink::AfterFork() {
+    Disabled = true;
+    Running = false;
+    // The threads that were putting do not exist in the child
+    Putting = 0;
+}
+
+void* TLMLogSink::ThreadRun(void* arg) {
+    ((TLMLogSink*)arg)->WriterRun();
+    return NULL;
+}
+
+void TLMLogSink::WriterRun() {
+    bool unflushed = false;
+    for(int idle = 0; ; idle++) {
+        Cell& cell = Cells[DequeuePos & Mask];
+        if(cell.Sequence.load(std::memory_order_acquire) == DequeuePos + 1) {
+            // Write the lines that are ready as one batch, at most a lap
+            // so that the direct writers are not locked out.
+            StreamLock.lock();
+            std::ostream* out = *Stream;
+            Cell* next = &cell;
+            for(size_t n = 0; n <= Mask; n++) {
+                if(out != NULL) *out << next->Text << '\n';
+                next->Sequence.store(DequeuePos + Mask + 1, std::memory_order_release);
+                DequeuePos++;
+                next = &Cells[DequeuePos & Mask];
+                if(next->Sequence.load(std::memory_order_acquire) != DequeuePos + 1) break;
+            }
+            StreamLock.unlock();
+            unflushed = true;
+            idle = 0;
+            continue;
+        }
+
+        if(Stopping && Empty()) break;
+
+        if(idle < TLM_LOG_YIELD) {
+            YieldThread();
+            continue;
+        }
+
+        // Nothing for a while, flush and park until the next line.
+        if(unflushed) {
+            Flush();
+            unflushed = false;
+        }
+        ParkLock.lock();
+        WriterParked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(Empty() && !Stopping) {
+            DataWait.wait(ParkLock);
+        }
+        WriterParked.store(false, std::memory_order_relaxed);
+        ParkLock.unlock();
+
+        idle = 0;
+    }
+
+    Flush();
+}
+
+void TLMLogSink::Flush() {
+    AutoLock lock(StreamLock);
+    if(*Stream != NULL) (*Stream)->flush();
+}
@@ -0,0 +1,147 @@
+//!
+//! \file TLMLogSink.h
+//!
+//! Defines the background writer used by TLMErrorLog so that the
+//! logging threads do not wait for the log file.
+//!
+
+#ifndef TLMLogSink_h_
+#define TLMLogSink_h_
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include "Communication/TLMThreadSynch.h"
+
+//! Class TLMLogSink writes log lines to a stream in a background thread.
+//! The logging threads put the lines in a bounded lock-free ring (D. Vyukov's
+//! bounded MPMC queue, see TLMMessageRing) and continue. The writer thread
+//! writes them without flushing and flushes the stream once the ring is
+//! empty, before it parks. The line buffers stay in the ring cells, so in
+//! steady state logging does not allocate.
+//!
+//! The writer holds the stream lock of TLMErrorLog while it writes a batch,
+//! the same lock as the threads that write to the stream directly. Suspend
+//! stops the writer, with all queued lines written, and keeps it stopped so
+//! that the stream can be flushed, replaced or closed.
+class TLMLogSink {
+
+    //! Ring cell
+    struct Cell {
+        std::atomic<size_t> Sequence;
+        std::string Text;
+    };
+
+    //! The cells, size is a power of two
+    Cell* Cells;
+
+    //! Number of cells minus one
+    size_t Mask;
+
+    char Pad0[64];
+
+    //! Next position to put to
+    std::atomic<size_t> EnqueuePos;
+
+    char Pad1[64];
+
+    //! Next position to write, used by the writer thread only
+    size_t DequeuePos;
+
+    char Pad2[64];
+
+    //! The stream the writer thread writes to, read under StreamLock
+    std::ostream* const* Stream;
+
+    //! Lock of the stream, also taken by the direct writers
+    SimpleLock& StreamLock;
+
+    //! Set by Stop, the thread exits when the ring is empty.
+    std::atomic<bool> Stopping;
+
+    //! Lock used together with DataWait when the writer parks.
+    SimpleLock ParkLock;
+
+    //! The writer waits on this when the ring is empty.
+    SimpleCond DataWait;
+
+    //! True while the writer is parked (or about to park).
+    std::atomic<bool> WriterParked;
+
+    //! Serializes Start and Stop.
+    SimpleLock ControlLock;
+
+    //! True while the thread runs
+    std::atomic<bool> Running;
+
+    //! Set if the thread could not be started or after a fork.
+    //! The lines are then written by the caller.
+    std::atomic<bool> Disabled;
+
+    //! Number of Suspend calls without Resume. The lines are written by
+    //! the caller while it is nonzero.
+    std::atomic<int> Suspended;
+
+    //! Number of Put calls that passed the Suspended check and have not
+    //! yet published their line. Suspend waits for them.
+    std::atomic<int> Putting;
+
+#ifndef SKIP_PTHREADS
+    //! The writer thread
+    pthread_t Thread;
+#endif
+
+public:
+
+    //! Constructor, size must be a power of two. The lines are written to
+    //! *stream while holding streamLock, nothing is written if it is NULL.
+    TLMLogSink(size_t size, std::ostream* const* stream, SimpleLock& streamLock);
+
+    //! Destructor, writes the queued lines and stops the thread.
+    ~TLMLogSink();
+
+    //! Queue the line Time + Label + mess. Starts the writer thread if
+    //! necessary. Returns 'false' if there is no writer thread or the sink
+    //! is suspended, the caller must then write the line itself.
+    bool Put(const std::string& Time, const char* Label, const std::string& mess);
+
+    //! Write the queued lines, flush the stream and stop the thread.
+    void Stop();
+
+    //! Stop the thread as Stop and keep it from being restarted until
+    //! Resume. When it returns all the lines put so far are written.
+    void Suspend();
+
+    //! Allow the thread to be started again by the next Put.
+    void Resume();
+
+    //! Called in the child process after fork(). The writer thread does
+    //! not exist there, so the lines are written by the caller.
+    void AfterFork();
+
+private:
+
+    //! Start the writer thread.
+    bool Start();
+
+    //! Check if a line is queued or being put.
+    bool Empty() const {
+        return EnqueuePos.load(std::memory_order_seq_cst) == DequeuePos;
+    }
+
+    //! Thread function
+    static void* ThreadRun(void* arg);
+
+    //! Write loop
+    void WriterRun();
+
+    //! Flush the stream, used by the writer thread.
+    void Flush();
+
+    // Should never be used
+    TLMLogSink(const TLMLogSink&);
+    TLMLogSink& operator=(const TLMLogSink&);
+};
+
+#endif
@@ -0,0 +1,276 @@
+/**
+ * File: TLMStatistics.cc
+ *
+ * Implementation of the interface statistics and their output
+ */
+#include "Logging/TLMStatistics.h"
+#include "Logging/TLMErrorLog.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//! Index of the highest set bit of n > 0.
+static inline int HighBit(uint64_t n) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(n);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanReverse64(&i, n);
+    return int(i);
+#else
+    int i = 0;
+    while(n >>= 1) i++;
+    return i;
+#endif
+}
+
+void TLMHistogram::Add(uint64_t ns) {
+    int i = (ns > 0) ? HighBit(ns) : 0;
+    if(i >= NUM_BUCKETS) i = NUM_BUCKETS - 1;
+    Buckets[i].Add(1);
+    Count.Add(1);
+    Total.Add(ns);
+
+    uint64_t max = Max.load(std::memory_order_relaxed);
+    while(ns > max && !Max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+uint64_t TLMHistogram::Quantile(double p) const {
+    const uint64_t count = GetCount();
+    const uint64_t max = GetMax();
+    if(count == 0) return 0;
+
+    uint64_t rank = uint64_t(p * count);
+    if(rank < p * count || rank == 0) rank++;
+
+    uint64_t sum = 0;
+    for(int i = 0; i < NUM_BUCKETS - 1; i++) {
+        sum += GetBucket(i);
+        if(sum >= rank) {
+            const uint64_t bound = uint64_t(1) << (i + 1);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+
+//! Snapshot period used if SetFile gets none, in nanoseconds.
+static const uint64_t TLM_STATS_DEFAULT_PERIOD = 1000000000;
+
+TLMStatistics::TLMStatistics()
+    : Names()
+    , Stats()
+    , File()
+    , Period(TLM_STATS_DEFAULT_PERIOD)
+    , WriteLock()
+    , ThreadLock()
+    , StopWait()
+    , Stopping(false)
+    , Running(false) {
+}
+
+TLMStatistics::~TLMStatistics() {
+    StopSnapshots();
+}
+
+void TLMStatistics::Add(const std::string& name, const TLMInterfaceStats* stats) {
+    AutoLock lock(WriteLock);
+    Names.push_back(name);
+    Stats.push_back(stats);
+}
+
+void TLMStatistics::SetFile(const std::string& file, double period) {
+    StopSnapshots();
+
+    WriteLock.lock();
+    File = file;
+    Period = (period > 0.0) ? uint64_t(period * 1e9) : TLM_STATS_DEFAULT_PERIOD;
+    WriteLock.unlock();
+
+    if(!file.empty()) {
+        StartSnapshots();
+    }
+}
+
+void TLMStatistics::Close() {
+    StopSnapshots();
+    Write();
+}
+
+void TLMStatistics::StartSnapshots() {
+#ifndef SKIP_PTHREADS
+    Stopping = false;
+    if(pthread_create(&Thread, NULL, ThreadRun, this) != 0) {
+        TLMErrorLog::Warning("Failed to start the statistics thread, the file is written at the end only");
+        return;
+    }
+    Running = true;
+#endif
+}
+
+void TLMStatistics::StopSnapshots() {
+    if(!Running) return;
+
+    ThreadLock.lock();
+    Stopping = true;
+    StopWait.signal();
+    ThreadLock.unlock();
+
+#ifndef SKIP_PTHREADS
+    pthread_join(Thread, NULL);
+#endif
+    Running = false;
+}
+
+void* TLMStatistics::ThreadRun(void* arg) {
+    ((TLMStatistics*)arg)->SnapshotRun();
+    return NULL;
+}
+
+void TLMStatistics::SnapshotRun() {
+    // The file is written here so that the disk latency stays out of the
+    // solver and forwarding threads being measured.
+    ThreadLock.lock();
+    while(!Stopping) {
+        StopWait.timed_wait(ThreadLock, Period * 1e-9);
+        if(Stopping) break;
+
+        ThreadLock.unlock();
+        Write();
+        ThreadLock.lock();
+    }
+    ThreadLock.unlock();
+}
+
+std::string TLMStatistics::DefaultFile(const std::string& name) {
+    const char* dir = getenv("TLM_STATS");
+    if(dir == NULL || *dir == '\0') return std::string();
+    return std::string(dir) + "/" + name + ".stats.csv";
+}
+
+uint64_t TLMStatistics::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TLMStatistics::Write() {
+    AutoLock lock(WriteLock);
+    if(File.empty()) return;
+
+    // Write a new file and move it in place
+    const std::string tmpFile = File + ".tmp";
+    {
+        std::ofstream out(tmpFile.c_str());
+        if(!out.good()) {
+            TLMErrorLog::Warning("Failed to open statistics file " + tmpFile);
+            return;
+        }
+
+        const bool csv = File.size() >= 4 && File.compare(File.size() - 4, 4, ".csv") == 0;
+        if(csv) {
+            WriteCSV(out);
+        }
+        else {
+            WriteJSON(out);
+        }
+    }
+
+#if defined(WIN32) || defined(__MINGW32__)
+    // rename does not replace an existing file on Windows
+    std::remove(File.c_str());
+#endif
+    if(std::rename(tmpFile.c_str(), File.c_str()) != 0) {
+        TLMErrorLog::Warning("Failed to write statistics file " + File);
+    }
+}
+
+//! Nanoseconds to microseconds
+static inline double Micro(uint64_t ns) {
+    return ns * 1e-3;
+}
+
+//! Write count, total, mean, median, 99% quantile and max of a histogram
+//! as CSV fields, the times in microseconds.
+static void WriteHistogramCSV(std::ostream& out, const TLMHistogram& h) {
+    const uint64_t count = h.GetCount();
+    out << ',' << count
+        << ',' << Micro(h.GetTotal())
+        << ',' << (count > 0 ? Micro(h.GetTotal()) / count : 0.0)
+        << ',' << Micro(h.Quantile(0.5))
+        << ',' << Micro(h.Quantile(0.99))
+        << ',' << Micro(h.GetMax());
+}
+
+void TLMStatistics::WriteCSV(std::ostream& out) const {
+    out << "interface,messages_sent,bytes_sent,messages_received,bytes_received,"
+           "extrapolations_back,extrapolations_forward,"
+           "wait_count,wait_total_us,wait_mean_us,wait_p50_us,wait_p99_us,wait_max_us,"
+           "send_count,send_total_us,send_mean_us,send_p50_us,send_p99_us,send_max_us\n";
+
+    for(size_t i = 0; i < Stats.size(); i++) {
+        const TLMInterfaceStats& s = *Stats[i];
+        out << Names[i]
+            << ',' << s.MessagesSent.Get()
+            << ',' << s.BytesSent.Get()
+            << ',' << s.MessagesReceived.Get()
+            << ',' << s.BytesReceived.Get()
+            << ',' << s.ExtrapolationsBack.Get()
+            << ',' << s.ExtrapolationsForward.Get();
+        WriteHistogramCSV(out, s.RecvWait);
+        WriteHistogramCSV(out, s.Send);
+        out << '\n';
+    }
+}
+
+//! Write a string as a JSON string
+static void WriteJSONString(std::ostream& out, const std::string& str) {
+    out << '"';
+    for(std::string::const_iterator it = str.begin(); it != str.end(); ++it) {
+        if(*it == '"' || *it == '\\') out << '\\';
+        out << *it;
+    }
+    out << '"';
+}
+
+//! Write a histogram as a JSON object, the times in microseconds.
+static void WriteHistogramJSON(std::ostream& out, const TLMHistogram& h) {
+    const uint64_t count = h.GetCount();
+    out << "{ \"count\": " << count
+        << ", \"total_us\": " << Micro(h.GetTotal())
+        << ", \"mean_us\": " << (count > 0 ? Micro(h.GetTotal()) / count : 0.0)
+        << ", \"p50_us\": " << Micro(h.Quantile(0.5))
+        << ", \"p99_us\": " << Micro(h.Quantile(0.99))
+        << ", \"max_us\": " << Micro(h.GetMax())
+        << ", \"buckets\": [";
+    for(int i = 0; i < TLMHistogram::NUM_BUCKETS; i++) {
+        out << (i > 0 ? ", " : "") << h.GetBucket(i);
+    }
+    out << "] }";
+}
+
+void TLMStatistics::WriteJSON(std::ostream& out) const {
+    out << "{\n  \"interfaces\": [";
+    for(size_t i = 0; i < Stats.size(); i++) {
+        const TLMInterfaceStats& s = *Stats[i];
+        out << (i > 0 ? ",\n" : "\n") << "    { \"name\": ";
+        WriteJSONString(out, Names[i]);
+        out << ",\n      \"messages_sent\": " << s.MessagesSent.Get()
+            << ", \"bytes_sent\": " << s.BytesSent.Get()
+            << ", \"messages_received\": " << s.MessagesReceived.Get()
+            << ", \"bytes_received\": " << s.BytesReceived.Get()
+            << ",\n      \"extrapolations_back\": " << s.ExtrapolationsBack.Get()
+            << ", \"extrapolations_forward\": " << s.ExtrapolationsForward.Get()
+            << ",\n      \"wait\": ";
+        WriteHistogramJSON(out, s.RecvWait);
+        out << ",\n      \"send\": ";
+        WriteHistogramJSON(out, s.Send);
+        out << " }";
+    }
+    out << "\n  ]\n}\n";
+}
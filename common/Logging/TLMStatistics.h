@@ -0,0 +1,194 @@
+//!
+//! \file TLMStatistics.h
+//!
+//! Defines the per-interface counters and latency histograms of the TLM
+//! clients and the manager, and their output as CSV or JSON
+//!
+
+#ifndef TLMStatistics_h_
+#define TLMStatistics_h_
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "Communication/TLMThreadSynch.h"
+
+//! TLMCounter is a statistics counter. It is updated without ordering
+//! and may be read by another thread while it is updated.
+class TLMCounter {
+    std::atomic<uint64_t> Value;
+
+public:
+    TLMCounter() : Value(0) {}
+
+    void Add(uint64_t n) { Value.fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t Get() const { return Value.load(std::memory_order_relaxed); }
+
+private:
+    // Should never be used
+    TLMCounter(const TLMCounter&);
+    TLMCounter& operator=(const TLMCounter&);
+};
+
+//! TLMHistogram collects durations in nanoseconds in buckets of powers
+//! of two: bucket i counts the durations in [2^i, 2^(i+1)) ns, the last
+//! bucket everything longer. The exact total and maximum are kept too.
+class TLMHistogram {
+public:
+
+    //! Number of buckets, the last one starts at about 2 seconds.
+    static const int NUM_BUCKETS = 32;
+
+    //! Add a duration.
+    void Add(uint64_t ns);
+
+    uint64_t GetCount() const { return Count.Get(); }
+
+    //! Sum of the durations in nanoseconds
+    uint64_t GetTotal() const { return Total.Get(); }
+
+    //! Longest duration in nanoseconds
+    uint64_t GetMax() const { return Max.load(std::memory_order_relaxed); }
+
+    uint64_t GetBucket(int i) const { return Buckets[i].Get(); }
+
+    //! Estimate the p-quantile (0 < p <= 1) in nanoseconds by the upper
+    //! bound of its bucket, at most the maximum.
+    uint64_t Quantile(double p) const;
+
+    TLMHistogram() : Max(0) {}
+
+private:
+    TLMCounter Buckets[NUM_BUCKETS];
+    TLMCounter Count;
+    TLMCounter Total;
+    std::atomic<uint64_t> Max;
+
+    // Should never be used
+    TLMHistogram(const TLMHistogram&);
+    TLMHistogram& operator=(const TLMHistogram&);
+};
+
+//! TLMInterfaceStats are the statistics of one TLM interface.
+//! On the clients the wait is the time the solver is blocked in
+//! ReceiveTimeData, the send time covers packing and sending. On the
+//! manager there is no wait and the send time is the forwarding.
+struct TLMInterfaceStats {
+    //! Time blocked waiting for the data of the coupled simulation
+    TLMHistogram RecvWait;
+
+    //! Time spent packing and sending
+    TLMHistogram Send;
+
+    TLMCounter MessagesSent;
+    TLMCounter BytesSent;
+    TLMCounter MessagesReceived;
+    TLMCounter BytesReceived;
+
+    //! Number of requests before the first data point
+    TLMCounter ExtrapolationsBack;
+
+    //! Number of requests after the last data point
+    TLMCounter ExtrapolationsForward;
+};
+
+//! TLMStatistics writes the statistics of a set of interfaces to a file,
+//! CSV if its name ends with ".csv" and JSON otherwise. The file is
+//! rewritten periodically by a background thread while the simulation
+//! runs, as a snapshot for the monitor, and at shutdown. It is replaced by a rename so that the
+//! readers never see a partly written file. The statistics are always
+//! collected, the file is only written when asked for, e.g., by setting
+//! the environment variable TLM_STATS to a directory.
+class TLMStatistics {
+public:
+
+    //! Constructor, no file.
+    TLMStatistics();
+
+    //! Destructor, stops the snapshots.
+    ~TLMStatistics();
+
+    //! Add an interface. The stats must stay valid while this object writes.
+    void Add(const std::string& name, const TLMInterfaceStats* stats);
+
+    //! Set the output file, empty for none, and the snapshot period in seconds.
+    //! Starts the snapshot thread if there is a file.
+    void SetFile(const std::string& file, double period);
+
+    const std::string& GetFile() const { return File; }
+
+    //! The file a process named name writes to unless told otherwise:
+    //! \<dir\>/\<name\>.stats.csv if TLM_STATS=\<dir\> is set, empty if not.
+    static std::string DefaultFile(const std::string& name);
+
+    //! Time from a monotonic clock in nanoseconds.
+    static uint64_t Now();
+
+    //! Write the file now.
+    void Write();
+
+    //! Stop the snapshots and write the file a last time. Call before the
+    //! interface statistics are deleted.
+    void Close();
+
+    //! Write the statistics as CSV, one line per interface.
+    void WriteCSV(std::ostream& out) const;
+
+    //! Write the statistics as JSON, including the histogram buckets.
+    void WriteJSON(std::ostream& out) const;
+
+private:
+
+    //! Start the snapshot thread.
+    void StartSnapshots();
+
+    //! Stop the snapshot thread.
+    void StopSnapshots();
+
+    //! Thread function
+    static void* ThreadRun(void* arg);
+
+    //! Write the file every Period until stopped.
+    void SnapshotRun();
+
+    //! Interface names
+    std::vector<std::string> Names;
+
+    //! Interface statistics, same order as Names
+    std::vector<const TLMInterfaceStats*> Stats;
+
+    //! The output file
+    std::string File;
+
+    //! Snapshot period in nanoseconds
+    uint64_t Period;
+
+    //! Serializes the writes
+    SimpleLock WriteLock;
+
+    //! Protects Stopping, used with StopWait
+    SimpleLock ThreadLock;
+
+    //! Signaled to stop the snapshot thread
+    SimpleCond StopWait;
+
+    //! Set to stop the snapshot thread
+    bool Stopping;
+
+    //! True while the snapshot thread runs
+    bool Running;
+
+#ifndef SKIP_PTHREADS
+    //! The snapshot thread
+    pthread_t Thread;
+#endif
+
+    // Should never be used
+    TLMStatistics(const TLMStatistics&);
+    TLMStatistics& operator=(const TLMStatistics&);
+};
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * File: TLMTrace.cc
+ *
+ * Implementation of the timeline tracing
+ */
+#include "Logging/TLMTrace.h"
+#include "Logging/TLMErrorLog.h"
+#include "Communication/TLMThreadSynch.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(WIN32) || defined(__MINGW32__)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+//! Number of events a thread buffers before it writes them.
+static const size_t TLM_TRACE_BUFFER_SIZE = 4096;
+
+//! TLMTraceBuffer holds the unwritten events of one thread.
+struct TLMTraceBuffer {
+    //! Taken by the owning thread and by Close
+    SimpleLock Lock;
+
+    std::vector<TLMTraceEvent> Events;
+
+    //! Thread number
+    uint32_t Thread;
+};
+
+std::atomic<bool> TLMTrace::Enabled(false);
+
+//! Serializes the writes to File and the access to Buffers.
+static SimpleLock FileLock;
+
+//! The trace file, NULL if closed
+static FILE* File = NULL;
+
+//! Set by the first Open call
+static bool Opened = false;
+
+//! The buffers of all the threads that recorded events.
+static std::vector<TLMTraceBuffer*> Buffers;
+
+//! The buffer of the calling thread
+static thread_local TLMTraceBuffer* ThreadBuffer = NULL;
+
+//! Write and clear the events of a buffer, the caller holds its lock.
+static void WriteEvents(TLMTraceBuffer& buffer) {
+    AutoLock lock(FileLock);
+    if(File != NULL && !buffer.Events.empty()) {
+        fwrite(&buffer.Events[0], sizeof(TLMTraceEvent), buffer.Events.size(), File);
+    }
+    buffer.Events.clear();
+}
+
+static void CloseTrace() {
+    TLMTrace::Close();
+}
+
+void TLMTrace::Open(const std::string& name) {
+    const char* dir = getenv("TLM_TRACE");
+    if(dir == NULL || *dir == '\0') return;
+
+    AutoLock lock(FileLock);
+    if(Opened) return;
+    Opened = true;
+
+    // The name becomes a part of the file name
+    std::string fileName = name;
+    for(std::string::iterator it = fileName.begin(); it != fileName.end(); ++it) {
+        if(*it == '/' || *it == '\\' || *it == ':') *it = '_';
+    }
+    const uint32_t pid = uint32_t(getpid());
+    fileName = std::string(dir) + "/" + fileName + "." + TLMErrorLog::ToStdStr(int(pid)) + ".tlmtrace";
+
+    File = fopen(fileName.c_str(), "wb");
+    if(File == NULL) {
+        TLMErrorLog::Warning("Failed to open trace file " + fileName);
+        return;
+    }
+
+    const uint32_t header[3] = { VERSION, 0x01020304, pid };
+    const uint32_t nameLength = uint32_t(name.size());
+    fwrite("TLMTRACE", 1, 8, File);
+    fwrite(header, sizeof(uint32_t), 3, File);
+    fwrite(&nameLength, sizeof(uint32_t), 1, File);
+    fwrite(name.data(), 1, nameLength, File);
+
+    atexit(CloseTrace);
+
+    TLMErrorLog::Info("Writing trace to " + fileName);
+    Enabled.store(true, std::memory_order_relaxed);
+}
+
+void TLMTrace::Close() {
+    Enabled.store(false, std::memory_order_relaxed);
+
+    std::vector<TLMTraceBuffer*> buffers;
+    FileLock.lock();
+    buffers = Buffers;
+    FileLock.unlock();
+
+    for(std::vector<TLMTraceBuffer*>::iterator it = buffers.begin(); it != buffers.end(); ++it) {
+        AutoLock lock((*it)->Lock);
+        WriteEvents(**it);
+    }
+
+    AutoLock lock(FileLock);
+    if(File != NULL) {
+        fclose(File);
+        File = NULL;
+    }
+}
+
+int64_t TLMTrace::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void TLMTrace::Add(TLMTraceKind kind, int id, double simTime, int64_t start) {
+    TLMTraceEvent event;
+    event.Start = start;
+    event.Duration = Now() - start;
+    event.SimTime = simTime;
+    event.ID = id;
+    event.Kind = uint32_t(kind);
+    event.Reserved = 0;
+
+    TLMTraceBuffer* buffer = ThreadBuffer;
+    if(buffer == NULL) {
+        buffer = new TLMTraceBuffer;
+        buffer->Events.reserve(TLM_TRACE_BUFFER_SIZE);
+
+        AutoLock lock(FileLock);
+        Buffers.push_back(buffer);
+        buffer->Thread = uint32_t(Buffers.size());
+        ThreadBuffer = buffer;
+    }
+    event.Thread = buffer->Thread;
+
+    AutoLock lock(buffer->Lock);
+    buffer->Events.push_back(event);
+    if(buffer->Events.size() >= TLM_TRACE_BUFFER_SIZE) {
+        WriteEvents(*buffer);
+    }
+}
+
+const char* TLMTrace::KindName(uint32_t kind) {
+    static const char* const Names[TLM_TRACE_NUM_KINDS] = {
+        "SolverStep",
+        "SendMessage",
+        "ReceiveMessage",
+        "SendTimeData",
+        "ReceiveWait",
+        "Marshal",
+        "Forward",
+        "MonitorWrite"
+    };
+    return kind < TLM_TRACE_NUM_KINDS ? Names[kind] : "Unknown";
+}
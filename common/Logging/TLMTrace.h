@@ -0,0 +1,127 @@
+//!
+//! \file TLMTrace.h
+//!
+//! Defines the optional timeline tracing of the TLM processes. Each process
+//! writes its events to a binary file, tlmtracemerge merges the files of a
+//! co-simulation into one Chrome trace (chrome://tracing, Perfetto).
+//!
+
+#ifndef TLMTrace_h_
+#define TLMTrace_h_
+
+#include <atomic>
+#include <limits>
+#include <string>
+#include <stdint.h>
+
+//! The traced events. The numbers are stored in the trace files, new kinds
+//! are added at the end.
+enum TLMTraceKind {
+    TLM_TRACE_SOLVER_STEP = 0,   //!< Solver step of a wrapper
+    TLM_TRACE_SEND_MESSAGE,      //!< TLMCommUtil::SendMessage
+    TLM_TRACE_RECEIVE_MESSAGE,   //!< TLMCommUtil::ReceiveMessage, including the wait
+    TLM_TRACE_SEND_TIME_DATA,    //!< Interface packs and sends its time data
+    TLM_TRACE_RECEIVE_WAIT,      //!< Interface waits in ReceiveTimeData
+    TLM_TRACE_MARSHAL,           //!< Manager marshals a time data message
+    TLM_TRACE_FORWARD,           //!< Manager forwards a time data message
+    TLM_TRACE_MONITOR_WRITE,     //!< Monitor writes a data row
+    TLM_TRACE_NUM_KINDS
+};
+
+//! One event in a trace file. Time is the wall clock time in nanoseconds
+//! since the epoch so that the files of the processes on one host (or on
+//! hosts with synchronized clocks) can be merged.
+struct TLMTraceEvent {
+    //! Start time in nanoseconds
+    int64_t Start;
+
+    //! Duration in nanoseconds
+    int64_t Duration;
+
+    //! Simulation time of the event, NaN if not known
+    double SimTime;
+
+    //! Thread number within the process, starting from 1
+    uint32_t Thread;
+
+    //! Interface ID, -1 if none
+    int32_t ID;
+
+    //! TLMTraceKind
+    uint32_t Kind;
+
+    uint32_t Reserved;
+};
+
+//! Class TLMTrace collects the events of this process. Tracing is off
+//! unless the environment variable TLM_TRACE names a directory, then
+//! Open creates the file \<dir\>/\<name\>.\<pid\>.tlmtrace. The events are
+//! kept in per thread buffers and written when a buffer is full and at exit.
+//!
+//! File format: the magic "TLMTRACE", uint32 version, uint32 0x01020304 to
+//! detect the byte order, uint32 process ID, uint32 name length, the name
+//! and then TLMTraceEvent records.
+class TLMTrace {
+public:
+
+    //! File format version
+    static const uint32_t VERSION = 1;
+
+    //! Start tracing if TLM_TRACE is set. The name identifies the process in
+    //! the merged trace. Only the first call has an effect.
+    static void Open(const std::string& name);
+
+    //! Write the buffered events and close the file. Called at exit.
+    static void Close();
+
+    //! Check if tracing is on.
+    static bool IsEnabled() { return Enabled.load(std::memory_order_relaxed); }
+
+    //! Wall clock time in nanoseconds since the epoch.
+    static int64_t Now();
+
+    //! Simulation time of the events that have none.
+    static double NoTime() { return std::numeric_limits<double>::quiet_NaN(); }
+
+    //! Record an event that started at start and ends now.
+    static void Add(TLMTraceKind kind, int id, double simTime, int64_t start);
+
+    //! Name of an event kind as shown in the merged trace.
+    static const char* KindName(uint32_t kind);
+
+private:
+
+    //! Set by Open if the file could be created.
+    static std::atomic<bool> Enabled;
+};
+
+//! TLMTraceScope records an event for its lifetime, e.g.,
+//! { TLMTraceScope trace(TLM_TRACE_SOLVER_STEP, -1, time); DoStep(); }
+//! Nothing is recorded, and the clock not read, when tracing is off.
+class TLMTraceScope {
+    TLMTraceKind Kind;
+    int ID;
+    double SimTime;
+    int64_t Start;
+
+public:
+    TLMTraceScope(TLMTraceKind kind, int id, double simTime)
+        : Kind(kind), ID(id), SimTime(simTime), Start(TLMTrace::IsEnabled() ? TLMTrace::Now() : 0) {}
+
+    ~TLMTraceScope() {
+        if(Start != 0) TLMTrace::Add(Kind, ID, SimTime, Start);
+    }
+
+    //! Set the simulation time if it is known only at the end.
+    void SetSimTime(double simTime) { SimTime = simTime; }
+
+    //! Set the interface ID if it is known only at the end.
+    void SetID(int id) { ID = id; }
+
+private:
+    // Should never be used
+    TLMTraceScope(const TLMTraceScope&);
+    TLMTraceScope& operator=(const TLMTraceScope&);
+};
+
+#endif
@@ -9,6 +9,8 @@
 #include <cstdlib>
 #include <cstring>
 #include "Logging/TLMErrorLog.h"
+#include "Logging/TLMStatistics.h"
+#include "Logging/TLMTrace.h"
 #include "CompositeModels/CompositeModel.h"
 #include "CompositeModels/CompositeModelReader.h"
 #include "Communication/ManagerCommHandler.h"
@@ -25,11 +27,18 @@ using std::string;
 
 void usage() {
     string usageStr =
-            "Usage: tlmmananger [-d] [-m <monitor-port>] [-p <server-port>] [-r] <compositemodel>, where compositemodel is a name of XML file.\n"
+            "Usage: tlmmananger [-d] [-l] [-m <monitor-port>] [-n] [-p <server-port>|unix:<path>] [-r] [-S <stats-file>] [-w <workers>] <compositemodel>, where compositemodel is a name of XML file.\n"
             "-d                 : enable debug mode\n"
+            "-l                 : let connected simulation tools exchange time data directly, not through the manager\n"
             "-m <monitor-port>  : set the port for monitoring connections\n"
+            "-n                 : do not offer shared memory transport to the simulation tools, use sockets only\n"
             "-p <server-port>   : set the server network port for communication with the simulation tools\n"
-            "-r                 : run manager in interface request mode, get information about interface locations";
+            "-p unix:<path>     : use a Unix domain socket with the given path instead of a network port (same host only)\n"
+            "-r                 : run manager in interface request mode, get information about interface locations\n"
+            "-S <stats-file>    : write the interface statistics to the file, JSON unless its name ends with .csv\n"
+            "-w <workers>       : number of threads serving the simulation tools, each one a share of them (default 1)\n"
+            "Set TLM_STATS=<directory> to write the interface statistics of the manager and the simulation tools there\n"
+            "Set TLM_TRACE=<directory> to write timeline traces of the manager and the simulation tools, see tlmtracemerge";
     TLMErrorLog::SetLogLevel(TLMLogLevel::Debug);
     TLMErrorLog::Info(usageStr);
     std::cout << usageStr << std::endl;
@@ -120,28 +129,52 @@ int main(int argc, char* argv[]) {
 #endif
     bool debugFlg = false;
     int serverPort = 0;
+    std::string serverAddress;
     int monitorPort = 0;
+    bool sharedMemory = true;
+    bool directLinks = false;
+    int ioWorkers = 1;
+    bool statisticsSet = false;
+    std::string statisticsFile;
     ManagerCommHandler::CommunicationMode comMode=ManagerCommHandler::CoSimulationMode;
     std::string singleModel;
 
     char c;
-    while((c = getopt (argc, argv, "dp:m:rs:")) != -1) {
+    while((c = getopt (argc, argv, "dlp:m:nrs:S:w:")) != -1) {
         switch(c) {
         case 'd':
             debugFlg = true;
             break;
+        case 'l':
+            directLinks = true;
+            break;
         case 'p':
-            serverPort = atoi(optarg);
+            if(!TLMCommUtil::GetUnixSocketPath(optarg).empty()) {
+                serverAddress = optarg;
+            }
+            else {
+                serverPort = atoi(optarg);
+            }
             break;
         case 'm':
             monitorPort = atoi(optarg);
             break;
+        case 'n':
+            sharedMemory = false;
+            break;
         case 'r':
             comMode = ManagerCommHandler::InterfaceRequestMode;
             break;
         case 's':
             singleModel = optarg;
             break;
+        case 'S':
+            statisticsSet = true;
+            statisticsFile = optarg;
+            break;
+        case 'w':
+            ioWorkers = atoi(optarg);
+            break;
         default:
             usage();
             break;
@@ -162,12 +195,12 @@ int main(int argc, char* argv[]) {
     // Create the meta model object
     omtlm_CompositeModel theModel;
 
+    std::string inFile(argv[optind]);
+
     {
         // Create model reader for the model
         CompositeModelReader modelReader(theModel);
 
-        std::string inFile(argv[optind]);
-
         // read the XML file and build the model
         // Note: Skip loading connections in interface request mode in case an interface no longer exists
         modelReader.ReadModel(inFile,comMode == ManagerCommHandler::InterfaceRequestMode, singleModel);
@@ -180,11 +213,28 @@ int main(int argc, char* argv[]) {
         theModel.GetSimParams().SetPort(serverPort);
     }
 
+    // Unix domain socket instead of the network port
+    if(!serverAddress.empty()) {
+        theModel.GetSimParams().SetAddress(serverAddress);
+    }
+
     // Set preferred network port for monitoring
     if(monitorPort > 0) {
         theModel.GetSimParams().SetMonitorPort(monitorPort);
     }
 
+    theModel.GetSimParams().SetSharedMemory(sharedMemory);
+    theModel.GetSimParams().SetDirectLinks(directLinks);
+    theModel.GetSimParams().SetIOWorkers(ioWorkers);
+
+    // The monitor looks for the statistics in the TLM_STATS directory
+    if(!statisticsSet) {
+        statisticsFile = TLMStatistics::DefaultFile(theModel.GetModelName());
+    }
+    theModel.GetSimParams().SetStatisticsFile(statisticsFile);
+
+    TLMTrace::Open("manager");
+
     // Create manager object
     ManagerCommHandler manager(theModel);
 
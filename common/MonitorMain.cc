@@ -9,11 +9,14 @@
 #include <cstring>
 #include <map>
 #include <sstream>
+#include <iomanip>
 #include "Logging/TLMErrorLog.h"
 #include "CompositeModels/CompositeModel.h"
 #include "CompositeModels/CompositeModelReader.h"
 #include "Communication/ManagerCommHandler.h"
 #include "Plugin/MonitoringPluginImplementer.h"
+#include "Logging/TLMStatistics.h"
+#include "Logging/TLMTrace.h"
 #include "double3.h"
 #include "double33.h"
 #ifndef NO_RTIME
@@ -676,6 +679,105 @@ void PrintRunStatus(omtlm_CompositeModel& model, std::ofstream& runFile, tTM_Inf
     runFile << "                                                              " << std::endl;
 }
 
+//! Rows of a statistics file (see TLMStatistics) by interface name, each
+//! row maps the column names to the values. Empty if there is no file.
+typedef std::map<std::string, std::map<std::string, std::string> > StatisticsRows;
+
+void ReadStatistics(const std::string& fileName, StatisticsRows& rows) {
+    rows.clear();
+    std::ifstream file(fileName.c_str());
+    std::string line, field;
+    if(!std::getline(file, line)) return;
+
+    std::vector<std::string> columns;
+    std::istringstream header(line);
+    while(std::getline(header, field, ',')) columns.push_back(field);
+
+    while(std::getline(file, line)) {
+        std::istringstream row(line);
+        std::map<std::string, std::string> values;
+        for(size_t i = 0; i < columns.size() && std::getline(row, field, ','); i++) {
+            values[columns[i]] = field;
+        }
+        if(!values.empty()) rows[values["interface"]] = values;
+    }
+}
+
+//! Minimum time between two reads of the statistics files in nanoseconds,
+//! the period the manager and the components rewrite them with.
+static const uint64_t TLM_MONITOR_STATS_PERIOD = 1000000000;
+
+//! The statistics files as last read by PrintStatistics.
+struct StatisticsCache {
+    //! Time of the last read, 0 if never read
+    uint64_t ReadTime;
+
+    StatisticsRows Manager;
+
+    //! Rows by component index
+    std::map<int, StatisticsRows> Components;
+
+    StatisticsCache() : ReadTime(0), Manager(), Components() {}
+};
+
+//! Append the interface statistics written by the manager (forwarded
+//! messages) and the components (wait times, extrapolations) to the run
+//! file. Each line has the same width so that it overwrites the old one.
+//! The files are read again only when they might have been rewritten.
+void PrintStatistics(omtlm_CompositeModel& model, std::ofstream& runFile, StatisticsCache& cache) {
+    // Written only if TLM_STATS is set
+    const std::string managerFile = TLMStatistics::DefaultFile(model.GetModelName());
+    if(managerFile.empty()) return;
+
+    const uint64_t now = TLMStatistics::Now();
+    if(cache.ReadTime == 0 || now - cache.ReadTime >= TLM_MONITOR_STATS_PERIOD) {
+        cache.ReadTime = now;
+        ReadStatistics(managerFile, cache.Manager);
+        for(int i = 0; i < model.GetComponentsNum(); i++) {
+            ReadStatistics(TLMStatistics::DefaultFile(model.GetTLMComponentProxy(i).GetName()), cache.Components[i]);
+        }
+    }
+    StatisticsRows& manager = cache.Manager;
+    std::map<int, StatisticsRows>& components = cache.Components;
+
+    std::ostringstream line;
+    line << std::left << std::setw(30) << "Interface" << std::right
+         << std::setw(10) << "Messages" << std::setw(12) << "Bytes"
+         << std::setw(12) << "Wait [us]" << std::setw(12) << "Max [us]"
+         << std::setw(12) << "Send [us]" << std::setw(8) << "Extrap";
+    runFile << line.str() << std::endl;
+
+    for(size_t i = 0; i < model.GetInterfacesNum(); i++) {
+        TLMInterfaceProxy& ifc = model.GetTLMInterfaceProxy(i);
+        const std::string& compName = model.GetTLMComponentProxy(ifc.GetComponentID()).GetName();
+
+        std::map<std::string, std::string>& fwd = manager[compName + "." + ifc.GetName()];
+        std::map<std::string, std::string>& own = components[ifc.GetComponentID()][ifc.GetName()];
+
+        // Prefer the counts of the component, the manager only sees what it forwards
+        std::map<std::string, std::string>& counts = own.empty() ? fwd : own;
+        const std::string sent = counts.empty() ? "-" : counts["messages_sent"];
+        const std::string bytes = counts.empty() ? "-" : counts["bytes_sent"];
+
+        std::string extrap = "-";
+        if(!own.empty()) {
+            extrap = ToStr(atoi(own["extrapolations_back"].c_str()) + atoi(own["extrapolations_forward"].c_str()));
+        }
+
+        line.str("");
+        line << std::left << std::setw(30) << (compName + "." + ifc.GetName()).substr(0, 29) << std::right
+             << std::setw(10) << sent << std::setw(12) << bytes
+             << std::setw(12) << (own.empty() ? "-" : own["wait_mean_us"])
+             << std::setw(12) << (own.empty() ? "-" : own["wait_max_us"])
+             << std::setw(12) << (own.empty() ? "-" : own["send_mean_us"])
+             << std::setw(8) << extrap;
+        runFile << line.str() << std::endl;
+    }
+
+    // Blank out the rest of a longer previous status
+    runFile << std::string(line.str().size(), ' ') << std::endl;
+}
+
 int main(int argc, char* argv[]) {
 
     TLMErrorLog::Info("Starting monitor...");
@@ -756,6 +858,8 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
+    TLMTrace::Open("monitor");
+
     // Initialize TLM
     TLMPlugin* thePlugin = InitializeTLMConnection(theModel, serverStr);
     if(!thePlugin) {
@@ -788,6 +892,8 @@ int main(int argc, char* argv[]) {
     TM_Init(&tInfo);
     TM_Clear(&tInfo);
 
+    StatisticsCache statistics;
+
     do {
         // Next time step (yes I know, we miss the first step)
         simTime += timeStep;
@@ -806,13 +912,20 @@ int main(int argc, char* argv[]) {
         TM_Stop(&tInfo);
 
         // Print data row
-        PrintData(theModel, outdataFile, dataSignal, data1D, data3D);
+        {
+            TLMTraceScope trace(TLM_TRACE_MONITOR_WRITE, -1, simTime);
+            PrintData(theModel, outdataFile, dataSignal, data1D, data3D);
+        }
 
         // Update run status
         PrintRunStatus(theModel, runFile, tInfo, simTime);
+        PrintStatistics(theModel, runFile, statistics);
 
     } while(simTime < endTime);
 
+    // The log stream is local, write the queued messages before it is closed
+    TLMErrorLog::Flush();
+
     return 0;
 }
 
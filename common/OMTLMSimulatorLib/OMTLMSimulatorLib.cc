@@ -25,6 +25,7 @@
 #include "CompositeModels/CompositeModelReader.h"
 #include "Communication/ManagerCommHandler.h"
 #include "Plugin/MonitoringPluginImplementer.h"
+#include "Logging/TLMTrace.h"
 #include "OMTLMSimulatorLib.h"
 
 #ifndef _WIN32
@@ -93,6 +94,7 @@ public:
   int monitorPort = 12111;
   double logStepSize = 1e-4;
   int numLogSteps = 1000;
+  int ioWorkers = 1;
 
 };
 
@@ -837,7 +839,10 @@ int startMonitor(double timeStep,
     TM_Stop(&tInfo);
 
     // Print data row
-    PrintData(model, outdataFile, tInfo, dataSignal, data1D, data3D);
+    {
+      TLMTraceScope trace(TLM_TRACE_MONITOR_WRITE, -1, simTime);
+      PrintData(model, outdataFile, tInfo, dataSignal, data1D, data3D);
+    }
 
     // Update run status
     PrintRunStatus(model, runFile, tInfo, simTime);
@@ -933,6 +938,7 @@ void PrintInterfaceInformation(omtlm_CompositeModel& theModel) {
 int startManager(std::string address,
                  int serverPort,
                  int monitorPort,
+                 int ioWorkers,
                  ManagerCommHandler::CommunicationMode comMode,
                  omtlm_CompositeModel &model) {
 
@@ -950,6 +956,10 @@ int startManager(std::string address,
     model.GetSimParams().SetMonitorPort(monitorPort);
   }
 
+  model.GetSimParams().SetIOWorkers(ioWorkers);
+
+  model.GetSimParams().SetStatisticsFile(TLMStatistics::DefaultFile(model.GetModelName()));
+
   // Create manager object
   ManagerCommHandler manager(model);
 
@@ -1018,7 +1028,16 @@ void simulateInternal(void *pModel,
 
   std::string modelName = pCompositeModel->GetModelName();
 
-  std::string server = std::string(pModelProxy->serverAddress)+
+  // Manager and monitor share the trace of this process
+  TLMTrace::Open(modelName);
+
+  // The monitoring port is always a network port, use the loopback
+  // address if the manager listens on a Unix domain socket.
+  std::string monitorHost = pModelProxy->serverAddress;
+  if(!TLMCommUtil::GetUnixSocketPath(monitorHost).empty()) {
+    monitorHost = "127.0.0.1";
+  }
+  std::string server = monitorHost+
                        ":"+std::to_string(pModelProxy->monitorPort);
 
   // Start manager thread
@@ -1026,6 +1045,7 @@ void simulateInternal(void *pModel,
                                           pModelProxy->serverAddress,
                                           pModelProxy->managerPort,
                                           pModelProxy->monitorPort,
+                                          pModelProxy->ioWorkers,
                                           comMode,
                                           std::ref(*pCompositeModel));
 
@@ -1363,6 +1383,11 @@ void omtlm_setNumLogStep(void *pModel, int steps) {
   pModelProxy->numLogSteps = steps;
 }
 
+void omtlm_setNumIOWorkers(void *pModel, int workers) {
+  CompositeModelProxy *pModelProxy = (CompositeModelProxy*)pModel;
+  pModelProxy->ioWorkers = workers;
+}
+
 void omtlm_printModelStructure(void *pModel)
 {
   CompositeModelProxy *pModelProxy = (CompositeModelProxy*)pModel;
@@ -184,6 +184,17 @@ DLLEXPORT void omtlm_setLogStepSize(void *pModel, double stepSize);
  */
 DLLEXPORT void omtlm_setNumLogStep(void *pModel, int steps);
 
+/**
+ * \brief Sets number of manager I/O worker threads.
+ *
+ * With more than one worker the simulation tools are split into shards,
+ * each served by its own thread.
+ *
+ * @param pModel Model as opaque pointer.
+ * @param workers Number of worker threads (default 1).
+ */
+DLLEXPORT void omtlm_setNumIOWorkers(void *pModel, int workers);
+
 /**
  * \brief Simulates the model.
  *
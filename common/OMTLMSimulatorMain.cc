@@ -26,6 +26,7 @@ struct optionsType {
   std::string model = "";
   double logStepSize = 0;
   int numLogSteps = 1000;
+  int workers = 1;
 
   bool addressSet = false;
   bool managerSet = false;
@@ -89,6 +90,9 @@ struct optionsType {
         else if(name == "loglevel") {
           logLevel = stoi(value);
         }
+        else if(name == "workers") {
+          workers = stoi(value);
+        }
       }
       else if(std::string(argv[i]) == "-r") {
         interfaceRequest = true;
@@ -135,6 +139,7 @@ struct optionsType {
     std::cout << "   modelFile        = " << model << "\n";
     std::cout << "   timeStep         = " << logStepSize << "\n";
     std::cout << "   nLogSteps        = " << numLogSteps << "\n";
+    std::cout << "   ioWorkers        = " << workers << "\n";
 
   }
 } options;
@@ -157,6 +162,7 @@ int main(int argc, char *argv[])
 
   void* pModel = omtlm_loadModel(options.model.c_str());
   omtlm_setLogLevel(pModel, options.logLevel);
+  omtlm_setNumIOWorkers(pModel, options.workers);
 /*
   void *pModel = omtlm_newModel("FmiTest");
   omtlm_addSubModel(pModel, "adder","/home/robbr48/Documents/Git/OMTLMSimulator/CompositeModels/FmiTestLinux/cs_adder1fmu1/cs_adder1.fmu", "StartTLMFmiWrapper");
@@ -23,12 +23,8 @@ ComponentParameter::ComponentParameter(TLMClientComm& theComm, std::string& aNam
     Comm.CreateParameterRegMessage(aName, aDefaultValue, Message);
     Message.SocketHandle = Comm.GetSocketHandle();
 
-    TLMCommUtil::SendMessage(Message);
+    Comm.ExchangeRegMessage(Message);
 
-    TLMCommUtil::ReceiveMessage(Message);
-    while(Message.Header.MessageType != TLMMessageTypeConst::TLM_REG_PARAMETER) {
-        TLMCommUtil::ReceiveMessage(Message);
-    }
     ParameterID =  Message.Header.ComponentParameterID;
 
     Comm.UnpackRegParameterMessage(Message, Value);
@@ -18,12 +18,10 @@ void MonitoringPluginImplementer::ReceiveTimeData(omtlm_TLMInterface* reqIfc, do
     while(time > reqIfc->GetNextRecvTime()) { // while data is needed
 
         // Receive data untill there is info for this interface
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info("Interface " +
-                              reqIfc->GetName() +
-                              " needs data for time= " +
-                              TLMErrorLog::ToStdStr(time));
-        }
+        TLM_LOG_INFO("Interface " +
+                     reqIfc->GetName() +
+                     " needs data for time= " +
+                     TLMErrorLog::ToStdStr(time));
 
         omtlm_TLMInterface* ifc = NULL;
 
@@ -33,29 +31,14 @@ void MonitoringPluginImplementer::ReceiveTimeData(omtlm_TLMInterface* reqIfc, do
             if(!TLMCommUtil::ReceiveMessage(*Message)) // on error leave this loop and use extrapolation
                 break;
 
-            // Get the target ID
-            int id = Message->Header.TLMInterfaceID;
-
-            // Use the ID to get to the right interface object
-            int idx = GetInterfaceIndex(id);
-            ifc = Interfaces[idx];
-
             // Unpack the message into the Interface object data structures
-            ifc->UnpackTimeData(*Message);
-
-            // Received data
-            if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-              TLMErrorLog::Info(string("Interface ") + ifc->GetName() + " got data until time= "
-                               + TLMErrorLog::ToStdStr(ifc->GetNextRecvTime()));
-            }
+            ifc = UnpackTimeData(*Message);
 
         } while(ifc != reqIfc); // loop until a message for this interface arrives
 
         if(ifc == NULL) break; // receive error - breaking
 
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info(string("Got data until time=") + TLMErrorLog::ToStdStr(ifc->GetNextRecvTime()));
-        }
+        TLM_LOG_INFO(string("Got data until time=") + TLMErrorLog::ToStdStr(ifc->GetNextRecvTime()));
     }
 }
 
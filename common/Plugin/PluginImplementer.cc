@@ -3,9 +3,12 @@
 #include "Plugin/TLMPlugin.h"
 #include "Communication/TLMCommUtil.h"
 #include "Plugin/PluginImplementer.h"
-#include <cassert>
+#include "Interfaces/TLMInterpolation.h"
+#include "Logging/TLMTrace.h"
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <algorithm>
 #include <locale>
@@ -21,6 +24,13 @@ using std::map;
 using std::ofstream;
 
 PluginImplementer* PluginImplementerInstance = 0;
+
+// Check if a switch is set in the environment, e.g., TLM_BACKGROUND_RECEIVE=1.
+static bool EnvironmentSwitch(const char* name) {
+    const char* value = getenv(name);
+    return value != NULL && *value != '\0' && strcmp(value, "0") != 0;
+}
+
 TLMPlugin* TLMPlugin::CreateInstance() {
     PluginImplementerInstance = new PluginImplementer;
     return PluginImplementerInstance;
@@ -40,22 +50,35 @@ void PluginImplementer::InterfaceReadyForTakedown(std::string IfcName) {
 
 void PluginImplementer::AwaitClosePermission()
 {
+    ClientComm.FlushBundle();
+
+    Message->SocketHandle = ClientComm.GetSocketHandle();
     Message->Header.MessageType = TLMMessageTypeConst::TLM_CLOSE_REQUEST;
-    TLMCommUtil::SendMessage(*Message);
+    Message->Header.DataSize = 0;
+    ClientComm.Send(*Message); // after the queued time data
+    if(Receiver.IsRunning()) {
+        // The receiver thread reads the manager connection
+        TLMMessage* mess = Receiver.GetControlMessage();
+        while(mess != NULL && mess->Header.MessageType != TLMMessageTypeConst::TLM_CLOSE_PERMISSION) {
+            TLMErrorLog::Info("Awaiting close permission...");
+            mess = Receiver.GetControlMessage();
+        }
+        TLMErrorLog::Info("Close permission received.");
+        Statistics.Close();
+        return;
+    }
     while(Message->Header.MessageType != TLMMessageTypeConst::TLM_CLOSE_PERMISSION) {
         TLMErrorLog::Info("Awaiting close permission...");
         TLMCommUtil::ReceiveMessage(*Message);
     }
     TLMErrorLog::Info("Close permission received.");
+    Statistics.Close();
 }
 
 void PluginImplementer::SetInitialForce3D(int interfaceID, double f1, double f2, double f3, double t1, double t2, double t3)
 {
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterface3D* ifc = dynamic_cast<TLMInterface3D*>(Interfaces[idx]);
-
-    assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+    TLMInterface3D* ifc = GetInterface<TLMInterface3D>(interfaceID);
 
     ifc->SetInitialForce(f1,f2,f3,t1,t2,t3);
 }
@@ -63,21 +86,16 @@ void PluginImplementer::SetInitialForce3D(int interfaceID, double f1, double f2,
 void PluginImplementer::SetInitialFlow3D(int interfaceID, double v1, double v2, double v3, double w1, double w2, double w3)
 {
   // Use the ID to get to the right interface object
-  int idx = GetInterfaceIndex(interfaceID);
-  TLMInterface3D* ifc = dynamic_cast<TLMInterface3D*>(Interfaces[idx]);
-
-  assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+  TLMInterface3D* ifc = GetInterface<TLMInterface3D>(interfaceID);
 
   ifc->SetInitialFlow(v1,v2,v3,w1,w2,w3);
 }
 
 void PluginImplementer::SetInitialValue(int interfaceID, double value)
 {
-    // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterfaceSignal* ifc = dynamic_cast<TLMInterfaceSignal*>(Interfaces[idx]);
-
-    assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+    // Use the ID to get to the right interface object, input or output
+    TLMInterfaceSignal* ifc = GetInterface<TLMInterfaceInput>(interfaceID);
+    if(!ifc) ifc = GetInterface<TLMInterfaceOutput>(interfaceID);
 
     ifc->SetInitialValue(value);
 }
@@ -85,10 +103,7 @@ void PluginImplementer::SetInitialValue(int interfaceID, double value)
 void PluginImplementer::SetInitialForce1D(int interfaceID, double force)
 {
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterface1D* ifc = dynamic_cast<TLMInterface1D*>(Interfaces[idx]);
-
-    assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+    TLMInterface1D* ifc = GetInterface<TLMInterface1D>(interfaceID);
 
     ifc->SetInitialForce(force);
 }
@@ -96,10 +111,7 @@ void PluginImplementer::SetInitialForce1D(int interfaceID, double force)
 void PluginImplementer::SetInitialFlow1D(int interfaceID, double flow)
 {
   // Use the ID to get to the right interface object
-  int idx = GetInterfaceIndex(interfaceID);
-  TLMInterface1D* ifc = dynamic_cast<TLMInterface1D*>(Interfaces[idx]);
-
-  assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+  TLMInterface1D* ifc = GetInterface<TLMInterface1D>(interfaceID);
 
   ifc->SetInitialFlow(flow);
 }
@@ -122,7 +134,17 @@ PluginImplementer::PluginImplementer():
     ModelChecked(false),
     Interfaces(),
     ClientComm(),
-    MapID2Ind(),
+    Message(0),
+    ComponentID(-1),
+    Slots(),
+    BundleEntry(),
+    BackgroundReceive(false),
+    Receiver(),
+    AsyncSend(false),
+    Statistics(),
+    StatisticsFileSet(false),
+    nSenders(0),
+    nSendersWaitingForShutdown(0),
     StartTime(0.0),
     EndTime(0.0),
     MaxStep(0.0) {
@@ -137,6 +159,12 @@ PluginImplementer::PluginImplementer():
 
 
 PluginImplementer::~PluginImplementer() {
+    Receiver.Stop();
+
+    // Before the interfaces it reads are deleted
+    if(Connected) {
+        Statistics.Close();
+    }
 
     for(vector<omtlm_TLMInterface*>::iterator it = Interfaces.begin();
         it != Interfaces.end(); ++it) {
@@ -148,7 +176,13 @@ PluginImplementer::~PluginImplementer() {
 
 void PluginImplementer::HandleSignal(int signum) {
     if(Connected) {
+        // The abort is written directly, which is only safe when no sender
+        // thread writes to the same socket or shared memory ring.
+        ClientComm.StopAsyncSend();
+
+        Message->SocketHandle = ClientComm.GetSocketHandle();
         Message->Header.MessageType = TLMMessageTypeConst::TLM_ABORT;
+        Message->Header.DataSize = 0;
         TLMCommUtil::SendMessage(*Message);
     }
 
@@ -161,8 +195,19 @@ void PluginImplementer::CheckModel() {
         TLMErrorLog::FatalError("Check model cannot be called before the TLM client is connected to manager");
     }
 
+    Message->SocketHandle = ClientComm.GetSocketHandle();
     Message->Header.MessageType =  TLMMessageTypeConst::TLM_CHECK_MODEL;
 
+    // Tell the manager where we accept direct links. The manager ignores
+    // the port unless direct links are enabled.
+    int linkPort = ClientComm.StartDirectLinkListener();
+    string portStr = (linkPort > 0) ? TLMErrorLog::ToStdStr(linkPort) : string();
+    Message->Header.DataSize = portStr.size();
+    Message->Data.resize(portStr.size());
+    if(!portStr.empty()) {
+        memcpy(&Message->Data[0], portStr.c_str(), portStr.size());
+    }
+
     TLMCommUtil::SendMessage(*Message);
     TLMCommUtil::ReceiveMessage(*Message);
 
@@ -171,10 +216,106 @@ void PluginImplementer::CheckModel() {
         TLMErrorLog::FatalError("Header id is " + TLMErrorLog::ToStdStr(int(Message->Header.TLMInterfaceID)));
     }
 
+    SetupDirectLinks(*Message);
+    ClientComm.StopDirectLinkListener();
+
+    // Bundle the time data for the manager if it accepts bundles from all interfaces.
+    bool useBundles = !Interfaces.empty();
+    for(vector<omtlm_TLMInterface*>::iterator it = Interfaces.begin(); it != Interfaces.end(); ++it) {
+        if((int((*it)->GetConnParams().Encoding) & TLMWireEncodingConst::TLM_ENC_BUNDLE) == 0) {
+            useBundles = false;
+        }
+    }
+    ClientComm.SetUseBundles(useBundles);
+
+    if(BackgroundReceive) {
+        StartReceiver();
+    }
+
+    if(AsyncSend && !ClientComm.StartAsyncSend()) {
+        TLMErrorLog::Warning("Asynchronous send is not available, the data is sent by the solver thread");
+    }
+
     ModelChecked = true;
 }
 
 
+// StartReceiver starts the receiver threads for the manager connection
+// and each direct link socket.
+void PluginImplementer::StartReceiver() {
+    vector<int> sockets(1, ClientComm.GetSocketHandle());
+    map<int, int> index;
+    for(size_t i = 0; i < Interfaces.size(); i++) {
+        int socket = Interfaces[i]->GetRecvSocket();
+        if(std::find(sockets.begin(), sockets.end(), socket) == sockets.end()) {
+            sockets.push_back(socket);
+        }
+        index[Interfaces[i]->GetInterfaceID()] = i;
+    }
+
+    if(Receiver.Start(sockets, index)) {
+        TLMErrorLog::Info("Receiving time data in the background on " +
+                          TLMErrorLog::ToStdStr(int(sockets.size())) + " connection(s)");
+    }
+    else {
+        TLMErrorLog::Warning("Background receive is not available, the data is received when needed");
+    }
+}
+
+
+// SetupDirectLinks connects the interfaces listed in the CheckModel
+// reply directly to their linked interfaces. Each line of the reply reads
+// "<interface ID> <linked interface ID> <linked component ID> <host>:<port> <mirror>".
+// The component with the lower ID connects, the other one accepts, so that
+// there is one socket per pair of components.
+void PluginImplementer::SetupDirectLinks(TLMMessage& mess) {
+    if(mess.Header.DataSize <= 0) return; // no direct links
+
+    struct DirectLink {
+        int InterfaceID;
+        int LinkedID;
+        int PeerID;
+        std::string Address;
+        int Mirror;
+    };
+
+    vector<DirectLink> links;
+    std::istringstream table(string((const char*)&mess.Data[0], mess.Header.DataSize));
+    DirectLink link;
+    while(table >> link.InterfaceID >> link.LinkedID >> link.PeerID >> link.Address >> link.Mirror) {
+        links.push_back(link);
+    }
+
+    map<int, int> peerSockets;
+    int numToAccept = 0;
+    for(vector<DirectLink>::iterator it = links.begin(); it != links.end(); ++it) {
+        if(peerSockets.count(it->PeerID)) continue;
+        if(ComponentID < it->PeerID) {
+            peerSockets[it->PeerID] = ClientComm.ConnectDirectLink(it->Address, ComponentID);
+        }
+        else {
+            peerSockets[it->PeerID] = -1;
+            numToAccept++;
+        }
+    }
+
+    // All our connects are complete (queued by the peers), it is safe to block in accept now.
+    for(int i = 0; i < numToAccept; i++) {
+        int peerID = -1;
+        int s = ClientComm.AcceptDirectLink(peerID);
+        if(peerSockets.count(peerID) == 0 || peerSockets[peerID] != -1) {
+            TLMErrorLog::FatalError("Unexpected direct link from component " + TLMErrorLog::ToStdStr(peerID));
+        }
+        peerSockets[peerID] = s;
+    }
+
+    for(vector<DirectLink>::iterator it = links.begin(); it != links.end(); ++it) {
+        if(!HasInterface(it->InterfaceID)) continue;
+        Slots[it->InterfaceID].Ifc->SetDirectLink(peerSockets[it->PeerID], it->LinkedID, it->Mirror != 0);
+    }
+}
+
+
 // Init method. Should be called after the default constructor. It will
 // initialize the object and connect to TLMManager. Will return true
 // on success, false otherwize. Note that the method can be called
@@ -186,16 +327,22 @@ bool PluginImplementer::Init(std::string model,
                               std::string ServerName) {
     if(Connected) return true;
 
-    string::size_type colPos = ServerName.rfind(':');
+    string host = ServerName;
+    int port = 0;
 
-    if(colPos == string::npos) {
-        TLMErrorLog::Warning(string("Server name string expected <server>:<port>, got:") + ServerName);
-        return false;
-    }
+    // unix:<path> is passed to ConnectManager as is
+    if(TLMCommUtil::GetUnixSocketPath(ServerName).empty()) {
+        string::size_type colPos = ServerName.rfind(':');
 
-    int port = atoi(ServerName.c_str() + colPos + 1);
+        if(colPos == string::npos) {
+            TLMErrorLog::Warning(string("Server name string expected <server>:<port> or unix:<path>, got:") + ServerName);
+            return false;
+        }
+
+        port = atoi(ServerName.c_str() + colPos + 1);
 
-    string host = ServerName.substr(0,colPos);
+        host = ServerName.substr(0,colPos);
+    }
 
     Message = new TLMMessage();
 
@@ -211,13 +358,38 @@ bool PluginImplementer::Init(std::string model,
     TLMCommUtil::SendMessage(*Message);
     TLMCommUtil::ReceiveMessage(*Message);
 
+    ComponentID = Message->Header.TLMInterfaceID;
+
     TLMErrorLog::Info(string("Got component ID: ") +
-                     TLMErrorLog::ToStdStr(Message->Header.TLMInterfaceID));
+                     TLMErrorLog::ToStdStr(ComponentID));
+
+    // Newer managers accept all the registrations in one message.
+    ClientComm.SetUseRegBatch((TLMCommUtil::GetEncoding(Message->Header)
+                               & TLMWireEncodingConst::TLM_ENC_REG_BATCH) != 0);
+
+    // Switch to shared memory if the manager offers it and runs on this host.
+    ClientComm.NegotiateSharedMemory(*Message);
 
     StartTime = timeStart;
     EndTime = timeEnd;
     MaxStep = maxStep;
 
+    // Lets the tools that don't call SetBackgroundReceive or SetAsyncSend use them.
+    if(EnvironmentSwitch("TLM_BACKGROUND_RECEIVE")) {
+        BackgroundReceive = true;
+    }
+    if(EnvironmentSwitch("TLM_ASYNC_SEND")) {
+        AsyncSend = true;
+    }
+
+    TLMErrorLog::Info(string("Interpolation kernel: ") + TLMInterpolation::KernelName());
+
+    TLMTrace::Open(model);
+
+    if(!StatisticsFileSet) {
+        Statistics.SetFile(TLMStatistics::DefaultFile(model), 1.0);
+    }
+
     Connected = true;
     SetInitialized();
 
@@ -269,12 +441,26 @@ int  PluginImplementer::RegisteTLMInterface(std::string name , int dimensions,
         return id;
     }
 
+    // Reserve the time data history for the expected number of steps
+    ifc->ReserveTimeData(MaxStep);
+
     // The index of the new interface:
     int idx = Interfaces.size();
 
     Interfaces.push_back(ifc);
 
-    MapID2Ind[id] = idx;
+    if(id >= (int)Slots.size()) {
+        Slots.resize(id + 1);
+    }
+    Slots[id].Ifc = ifc;
+    Slots[id].Index = idx;
+    Slots[id].Kind = ifc->GetKind();
+
+    Statistics.Add(name, &ifc->GetStats());
+
+    if(ifc->GetCausalityType() != TLM_CAUSALITY_INPUT) {
+        nSenders++;
+    }
 
     return id;
 }
@@ -298,6 +484,52 @@ int PluginImplementer::RegisterComponentParameter(std::string name, std::string
 }
 
 
+// RegisterTLMInterfaces sends all the registration requests in one message
+// if the manager supports it. The interface and parameter objects are then
+// created as usual and take their replies from the batch.
+void PluginImplementer::RegisterTLMInterfaces(const std::vector<TLMInterfaceSpec>& interfaces,
+                                              const std::vector<TLMParameterSpec>& parameters,
+                                              std::vector<int>& interfaceIDs,
+                                              std::vector<int>& parameterIDs) {
+    if(ClientComm.CanBatchRegistrations()) {
+        std::vector<TLMMessage> requests(interfaces.size() + parameters.size());
+        std::locale loc;
+        size_t i = 0;
+        for(std::vector<TLMInterfaceSpec>::const_iterator it = interfaces.begin(); it != interfaces.end(); ++it, ++i) {
+            // Same request as sent by the interface constructors in RegisteTLMInterface
+            string name = it->Name;
+            string causality = it->Causality;
+            string domain = it->Domain;
+            causality[0] = std::tolower(causality[0],loc);
+            domain[0] = std::tolower(domain[0],loc);
+            if(it->Dimensions == 6) {
+                causality = "bidirectional";
+            }
+            ClientComm.CreateInterfaceRegMessage(name, it->Dimensions, causality, domain, requests[i]);
+        }
+        for(std::vector<TLMParameterSpec>::const_iterator it = parameters.begin(); it != parameters.end(); ++it, ++i) {
+            string name = it->Name;
+            string value = it->DefaultValue;
+            ClientComm.CreateParameterRegMessage(name, value, requests[i]);
+        }
+
+        TLMErrorLog::Info(string("Register ") + TLMErrorLog::ToStdStr(int(requests.size())) +
+                          " interfaces and parameters in one request");
+        ClientComm.PrefetchRegistrations(requests);
+    }
+
+    interfaceIDs.clear();
+    for(std::vector<TLMInterfaceSpec>::const_iterator it = interfaces.begin(); it != interfaces.end(); ++it) {
+        interfaceIDs.push_back(RegisteTLMInterface(it->Name, it->Dimensions, it->Causality, it->Domain));
+    }
+
+    parameterIDs.clear();
+    for(std::vector<TLMParameterSpec>::const_iterator it = parameters.begin(); it != parameters.end(); ++it) {
+        parameterIDs.push_back(RegisterComponentParameter(it->Name, it->DefaultValue));
+    }
+}
+
+
 // ReceiveTimeData receives time-stamped data from coupled simulations.
 // Since the order of messages can vary the specified interfaceID
 // is used only to detect the last message expected when the function
@@ -306,17 +538,21 @@ int PluginImplementer::RegisterComponentParameter(std::string name, std::string
 // Input:
 //   interfaceID - ID of a TLM interface that triggered the request
 void PluginImplementer::ReceiveTimeData(omtlm_TLMInterface* reqIfc, double time) {
+    if(time <= reqIfc->GetNextRecvTime()) return;
+
+    // Time blocked until the data is there, or extrapolation is used
+    const uint64_t waitStart = TLMStatistics::Now();
+    TLMTraceScope trace(TLM_TRACE_RECEIVE_WAIT, reqIfc->GetInterfaceID(), time);
+
     while(time > reqIfc->GetNextRecvTime()) { // while data is needed
 
         // Receive data untill there is info for this interface
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-           TLMErrorLog::Info("Interface " + reqIfc->GetName() +
-                            " needs data for time= " + TLMErrorLog::ToStdStr(time));
-        }
+        TLM_LOG_INFO("Interface " + reqIfc->GetName() +
+                    " needs data for time= " + TLMErrorLog::ToStdStr(time));
 
         double allowedMaxTime = reqIfc->GetLastSendTime() + reqIfc->GetConnParams().Delay;
 
-        if(allowedMaxTime < time && reqIfc->GetCausality() != "input") {            //Why not for signal interfaces?
+        if(allowedMaxTime < time && reqIfc->GetKind() != TLM_INTERFACE_INPUT) {            //Why not for signal interfaces?
             TLMErrorLog::Warning("Interface " + reqIfc->GetName() +
                              " is NOT ALLOWED to ask data after time= " + TLMErrorLog::ToStdStr(allowedMaxTime) +
                              ". The error is: "+TLMErrorLog::ToStdStr(time - allowedMaxTime));
@@ -325,37 +561,99 @@ void PluginImplementer::ReceiveTimeData(omtlm_TLMInterface* reqIfc, double time)
 
         omtlm_TLMInterface* ifc = NULL;
 
-        do {
+        // The peers might wait for the data we have not sent yet
+        ClientComm.FlushBundle();
 
-            // Receive a message
-            if(!TLMCommUtil::ReceiveMessage(*Message)) // on error leave this loop and use extrapolation
-                break;
+        // The data comes either directly from the linked component or from the manager
+        Message->SocketHandle = reqIfc->GetRecvSocket();
 
-            // Get the target ID
-            int id = Message->Header.TLMInterfaceID;
+        if(Receiver.IsRunning()) {
+            // The receiver threads have queued the data per interface
+            TLMMessage* mess = Receiver.GetTimeData(GetInterfaceIndex(reqIfc->GetInterfaceID()),
+                                                   reqIfc->GetRecvSocket());
+            if(mess != NULL) { // on a closed connection use extrapolation
+                ifc = UnpackTimeData(*mess);
+            }
+        }
+        else {
+            do {
+
+                // Receive a message
+                if(!TLMCommUtil::ReceiveMessage(*Message)) // on error leave this loop and use extrapolation
+                    break;
+
+                if(Message->Header.MessageType == TLMMessageTypeConst::TLM_TIME_DATA_BUNDLE) {
+                    // Unpack all the messages, stop if one of them is for reqIfc
+                    size_t offset = 0;
+                    while(TLMCommUtil::GetBundleEntry(*Message, offset, BundleEntry)) {
+                        omtlm_TLMInterface* entryIfc = UnpackTimeData(BundleEntry);
+                        if(ifc != reqIfc) ifc = entryIfc;
+                    }
+                }
+                else {
+                    ifc = UnpackTimeData(*Message);
+                }
+
+            } while(ifc != reqIfc); // loop until a message for this interface arrives
+        }
 
-            // Use the ID to get to the right interface object
-            int idx = GetInterfaceIndex(id);
-            ifc = Interfaces[idx];
+        if(ifc == NULL) break; // receive error - breaking
 
-            // Unpack the message into the Interface object data structures
-            ifc->UnpackTimeData(*Message);
+        TLM_LOG_INFO(string("Got data until time=") +
+                    TLMErrorLog::ToStdStr(ifc->GetNextRecvTime()));
+    }
 
-            // Received data
-            if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-                TLMErrorLog::Info(string("Interface ") + ifc->GetName() + " got data until time= " +
-                                 TLMErrorLog::ToStdStr(ifc->GetNextRecvTime()));
-            }
+    reqIfc->GetStats().RecvWait.Add(TLMStatistics::Now() - waitStart);
+}
 
-        } while(ifc != reqIfc); // loop until a message for this interface arrives
 
-        if(ifc == NULL) break; // receive error - breaking
+// UnpackTimeData passes a received time data message to its interface.
+omtlm_TLMInterface* PluginImplementer::UnpackTimeData(TLMMessage& mess) {
+    // Get the target ID
+    int id = mess.Header.TLMInterfaceID;
+
+    // Use the ID to get to the right interface object
+    if(!HasInterface(id)) {
+        TLMErrorLog::Warning("Time data for unknown interface " + TLMErrorLog::ToStdStr(id));
+        return NULL;
+    }
+    omtlm_TLMInterface* ifc = Slots[id].Ifc;
+
+    // Unpack the message into the Interface object data structures,
+    // the kind gives the class so no virtual call is needed
+    switch(Slots[id].Kind) {
+    case TLM_INTERFACE_3D:
+        static_cast<TLMInterface3D*>(ifc)->Unpack(mess);
+        break;
+    case TLM_INTERFACE_1D:
+        static_cast<TLMInterface1D*>(ifc)->Unpack(mess);
+        break;
+    default:
+        static_cast<TLMInterfaceSignal*>(ifc)->Unpack(mess);
+        break;
+    }
 
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info(string("Got data until time=") +
-                             TLMErrorLog::ToStdStr(ifc->GetNextRecvTime()));
+    // Received data
+    TLM_LOG_INFO(string("Interface ") + ifc->GetName() + " got data until time= " +
+                TLMErrorLog::ToStdStr(ifc->GetNextRecvTime()));
+    return ifc;
+}
+
+
+// FlushBundle sends the pending time data bundle when no other interface
+// is due to send for the given time, i.e., all the data of this sync
+// point is in the bundle.
+void PluginImplementer::FlushBundle(double time) {
+    if(!ClientComm.HasBundle()) return;
+
+    for(vector<omtlm_TLMInterface*>::iterator it = Interfaces.begin(); it != Interfaces.end(); ++it) {
+        omtlm_TLMInterface* ifc = *it;
+        if(ifc->SendsToManager() && !ifc->waitForShutdown()
+           && ifc->IsSendDue(time) && !ClientComm.IsBundled(ifc->GetInterfaceID())) {
+            return;
         }
     }
+    ClientComm.FlushBundle();
 }
 
 
@@ -363,10 +661,7 @@ void PluginImplementer::GetValueSignal(int interfaceID, double time, double *val
     if(!ModelChecked) CheckModel();
 
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterfaceInput* ifc = dynamic_cast<TLMInterfaceInput*>(Interfaces[idx]);
-
-    assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+    TLMInterfaceInput* ifc = GetInterface<TLMInterfaceInput>(interfaceID);
 
     if(!ifc) {
         (*value) = 0.0;
@@ -398,10 +693,7 @@ void PluginImplementer::GetForce1D(int interfaceID, double time, double speed, d
     if(!ModelChecked) CheckModel();
 
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterface1D* ifc = dynamic_cast<TLMInterface1D*>(Interfaces[idx]);
-
-    assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+    TLMInterface1D* ifc = GetInterface<TLMInterface1D>(interfaceID);
 
     if(!ifc) {
         (*force) = 0.0;
@@ -431,10 +723,7 @@ void PluginImplementer::GetForce3D(int interfaceID,
     if(!ModelChecked) CheckModel();
 
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterface3D* ifc = dynamic_cast<TLMInterface3D*>(Interfaces[idx]);
-
-    assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+    TLMInterface3D* ifc = GetInterface<TLMInterface3D>(interfaceID);
 
     if(!ifc) {
         for(int i = 0; i < 6; i++) {
@@ -455,15 +744,90 @@ void PluginImplementer::GetForce3D(int interfaceID,
 }
 
 
+// GetForces3D looks up all the interfaces first and receives their data
+// in one pass before the forces are evaluated.
+void PluginImplementer::GetForces3D(int n,
+                                    const int interfaceIDs[],
+                                    double time,
+                                    double position[],
+                                    double orientation[],
+                                    double speed[],
+                                    double ang_speed[],
+                                    double* force) {
+
+    if(!ModelChecked) CheckModel();
+
+    BatchIfcs.resize(n);
+    for(int k = 0; k < n; k++) {
+        BatchIfcs[k] = GetInterface<TLMInterface3D>(interfaceIDs[k]);
+    }
+
+    ReceiveBatchTimeData(time);
+
+    for(int k = 0; k < n; k++) {
+        TLMInterface3D* ifc = static_cast<TLMInterface3D*>(BatchIfcs[k]);
+        if(!ifc) {
+            for(int i = 0; i < 6; i++) {
+                force[6*k + i] = 0.0;
+            }
+
+            TLMErrorLog::Warning(string("No interface in GetForces3D()"));
+
+            continue;
+        }
+
+        // evaluate the reaction force from the TLM connection
+        ifc->GetForce(time, position + 3*k, orientation + 9*k, speed + 3*k, ang_speed + 3*k, force + 6*k);
+    }
+}
+
+
+void PluginImplementer::GetForces1D(int n,
+                                    const int interfaceIDs[],
+                                    double time,
+                                    double speed[],
+                                    double* force) {
+
+    if(!ModelChecked) CheckModel();
+
+    BatchIfcs.resize(n);
+    for(int k = 0; k < n; k++) {
+        BatchIfcs[k] = GetInterface<TLMInterface1D>(interfaceIDs[k]);
+    }
+
+    ReceiveBatchTimeData(time);
+
+    for(int k = 0; k < n; k++) {
+        TLMInterface1D* ifc = static_cast<TLMInterface1D*>(BatchIfcs[k]);
+        if(!ifc) {
+            force[k] = 0.0;
+
+            TLMErrorLog::Warning(string("No interface in GetForces1D()"));
+
+            continue;
+        }
+
+        // evaluate the reaction force from the TLM connection
+        ifc->GetForce(time, speed[k], force + k);
+    }
+}
+
+
+void PluginImplementer::ReceiveBatchTimeData(double time) {
+    for(vector<omtlm_TLMInterface*>::iterator it = BatchIfcs.begin(); it != BatchIfcs.end(); ++it) {
+        if(*it != NULL && time > (*it)->GetNextRecvTime()) {
+            ReceiveTimeData(*it, time);
+        }
+    }
+}
+
+
 
 void PluginImplementer::GetWaveImpedance1D(int interfaceID, double time, double *impedance, double *wave) {
     if(!ModelChecked) CheckModel();
 
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterface1D* ifc = dynamic_cast<TLMInterface1D*>(Interfaces[idx]);
-
-    assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+    TLMInterface1D* ifc = GetInterface<TLMInterface1D>(interfaceID);
 
     if(!ifc) {
         (*wave) = 0.0;
@@ -488,10 +852,7 @@ void PluginImplementer::GetWaveImpedance3D(int interfaceID, double time, double
     if(!ModelChecked) CheckModel();
 
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterface3D* ifc = dynamic_cast<TLMInterface3D*>(Interfaces[idx]);
-
-    assert(!ifc || (ifc -> GetInterfaceID() == interfaceID));
+    TLMInterface3D* ifc = GetInterface<TLMInterface3D>(interfaceID);
 
     if(!ifc) {
         for(int i = 0; i < 6; i++) {
@@ -524,30 +885,22 @@ void PluginImplementer::SetMotion3D(int forceID,
 
     if(!ModelChecked) CheckModel();
     if(forceID < 0) return;
-    // Find the interface object by its ID
-    int idx = GetInterfaceIndex(forceID);
-    TLMInterface3D* ifc = dynamic_cast<TLMInterface3D*>(Interfaces[idx]);
-    assert(ifc -> GetInterfaceID() == forceID);
+    // Use the ID to get to the right interface object
+    TLMInterface3D* ifc = GetInterface<TLMInterface3D>(forceID);
+    if(!ifc) {
+        TLMErrorLog::Warning(string("No interface in SetMotion3D()"));
+        return;
+    }
 
     if(!ifc->waitForShutdown()) {
         // Store the data into the interface object
-        TLMErrorLog::Info(string("calling SetTimeData()"));
+        TLM_LOG_INFO(string("calling SetTimeData()"));
         ifc->SetTimeData(time, position, orientation,speed,ang_speed);
+        if(ifc->waitForShutdown()) nSendersWaitingForShutdown++;
+        FlushBundle(time);
     }
     else {
-        // Check if all interfaces wait for shutdown
-        std::vector<omtlm_TLMInterface*>::iterator iter;
-        for(iter=Interfaces.begin(); iter!=Interfaces.end(); iter++) {
-            if((*iter)->GetCausality() == "input") continue;
-            if(! (*iter)->waitForShutdown()) return;
-        }
-#ifdef _MSC_VER
-        WSACleanup(); // BZ306 fixed here
-#else
-        // needed anything ?
-#endif
-
-        InterfaceReadyForTakedown(ifc->GetName());
+        CheckShutdown(ifc);
     }
 }
 
@@ -559,30 +912,22 @@ void PluginImplementer::SetValueSignal(int valueID,
 
     if(valueID < 0) return;
 
-    // Find the interface object by its ID
-    int idx = GetInterfaceIndex(valueID);
-    TLMInterfaceOutput* ifc = dynamic_cast<TLMInterfaceOutput*>(Interfaces[idx]);
-    assert(ifc -> GetInterfaceID() == valueID);
+    // Use the ID to get to the right interface object
+    TLMInterfaceOutput* ifc = GetInterface<TLMInterfaceOutput>(valueID);
+    if(!ifc) {
+        TLMErrorLog::Warning(string("No interface in SetValueSignal()"));
+        return;
+    }
 
     if(!ifc->waitForShutdown()) {
         // Store the data into the interface object
-        TLMErrorLog::Info(string("calling SetTimeData()"));
+        TLM_LOG_INFO(string("calling SetTimeData()"));
         ifc->SetTimeData(time, value);
+        if(ifc->waitForShutdown()) nSendersWaitingForShutdown++;
+        FlushBundle(time);
     }
     else {
-        // Check if all interfaces wait for shutdown
-        std::vector<omtlm_TLMInterface*>::iterator iter;
-        for(iter=Interfaces.begin(); iter!=Interfaces.end(); iter++) {
-            if((*iter)->GetCausality() == "input") continue;
-            if(! (*iter)->waitForShutdown()) return;
-        }
-#ifdef _MSC_VER
-        WSACleanup(); // BZ306 fixed here
-#else
-        // needed anything ?
-#endif
-
-        InterfaceReadyForTakedown(ifc->GetName());
+        CheckShutdown(ifc);
     }
 }
 
@@ -593,33 +938,102 @@ void PluginImplementer::SetMotion1D(int forceID,
 
     if(!ModelChecked) CheckModel();
     if(forceID < 0) return;
-    // Find the interface object by its ID
-    int idx = GetInterfaceIndex(forceID);
-    TLMInterface1D* ifc = dynamic_cast<TLMInterface1D*>(Interfaces[idx]);
-    assert(ifc -> GetInterfaceID() == forceID);
+    // Use the ID to get to the right interface object
+    TLMInterface1D* ifc = GetInterface<TLMInterface1D>(forceID);
+    if(!ifc) {
+        TLMErrorLog::Warning(string("No interface in SetMotion1D()"));
+        return;
+    }
 
     if(!ifc->waitForShutdown()) {
         // Store the data into the interface object
-        if(TLMErrorLog::GetLogLevel() >= TLMLogLevel::Info) {
-            TLMErrorLog::Info(string("calling SetTimeData()"));
-        }
+        TLM_LOG_INFO(string("calling SetTimeData()"));
         ifc->SetTimeData(time, position, speed);
+        if(ifc->waitForShutdown()) nSendersWaitingForShutdown++;
+        FlushBundle(time);
     }
     else {
-        // Check if all interfaces wait for shutdown
-        std::vector<omtlm_TLMInterface*>::iterator iter;
-        for(iter=Interfaces.begin(); iter!=Interfaces.end(); iter++) {
-            if((*iter)->GetCausality() == "input") continue;
-            if(! (*iter)->waitForShutdown()) return;
+        CheckShutdown(ifc);
+    }
+}
+
+
+// SetMotions3D stores the data of all the interfaces before the bundle is
+// flushed, the single calls would check the bundle for each interface.
+void PluginImplementer::SetMotions3D(int n,
+                                     const int forceIDs[],
+                                     double time,
+                                     double position[],
+                                     double orientation[],
+                                     double speed[],
+                                     double ang_speed[]) {
+
+    if(!ModelChecked) CheckModel();
+
+    for(int k = 0; k < n; k++) {
+        if(forceIDs[k] < 0) continue;
+        TLMInterface3D* ifc = GetInterface<TLMInterface3D>(forceIDs[k]);
+        if(!ifc) {
+            TLMErrorLog::Warning(string("No interface in SetMotions3D()"));
+            continue;
+        }
+
+        if(!ifc->waitForShutdown()) {
+            // Store the data into the interface object
+            ifc->SetTimeData(time, position + 3*k, orientation + 9*k, speed + 3*k, ang_speed + 3*k);
+            if(ifc->waitForShutdown()) nSendersWaitingForShutdown++;
         }
+        else {
+            CheckShutdown(ifc);
+        }
+    }
+
+    FlushBundle(time);
+}
+
+
+void PluginImplementer::SetMotions1D(int n,
+                                     const int forceIDs[],
+                                     double time,
+                                     double position[],
+                                     double speed[]) {
+
+    if(!ModelChecked) CheckModel();
+
+    for(int k = 0; k < n; k++) {
+        if(forceIDs[k] < 0) continue;
+        TLMInterface1D* ifc = GetInterface<TLMInterface1D>(forceIDs[k]);
+        if(!ifc) {
+            TLMErrorLog::Warning(string("No interface in SetMotions1D()"));
+            continue;
+        }
+
+        if(!ifc->waitForShutdown()) {
+            // Store the data into the interface object
+            ifc->SetTimeData(time, position[k], speed[k]);
+            if(ifc->waitForShutdown()) nSendersWaitingForShutdown++;
+        }
+        else {
+            CheckShutdown(ifc);
+        }
+    }
+
+    FlushBundle(time);
+}
+
+
+// CheckShutdown takes the component down once all the interfaces that send
+// data wait for shutdown (interface request mode).
+void PluginImplementer::CheckShutdown(omtlm_TLMInterface* ifc) {
+    // Check if all interfaces wait for shutdown
+    if(!AllSendersWaitForShutdown()) return;
 #ifdef _MSC_VER
-        WSACleanup(); // BZ306 fixed here
+    WSACleanup(); // BZ306 fixed here
 #else
-        // needed anything ?
+    // needed anything ?
 #endif
 
-        InterfaceReadyForTakedown(ifc->GetName());
-    }
+    InterfaceReadyForTakedown(ifc->GetName());
 }
 
 // GetConnectionParams returnes the ConnectionParams for
@@ -628,9 +1042,12 @@ void PluginImplementer::SetMotion1D(int forceID,
 void PluginImplementer::GetConnectionParams(int interfaceID, TLMConnectionParams& ParamsOut) {
 
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    omtlm_TLMInterface* ifc = Interfaces[idx];
-    assert(ifc -> GetInterfaceID() == interfaceID);
+    if(!HasInterface(interfaceID)) {
+        TLMErrorLog::Warning(string("No interface in GetConnectionParams()"));
+
+        return;
+    }
+    omtlm_TLMInterface* ifc = Slots[interfaceID].Ifc;
 
     ParamsOut = ifc->GetConnParams();
 }
@@ -638,13 +1055,9 @@ void PluginImplementer::GetConnectionParams(int interfaceID, TLMConnectionParams
 void PluginImplementer::GetTimeDataSignal(int interfaceID, double time, TLMTimeDataSignal &DataOut, bool monitoring) {
     if(!ModelChecked) CheckModel();
 
-    // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-
     if(!monitoring) {
         // Use the ID to get to the right interface object
-        TLMInterfaceInput* ifc = dynamic_cast<TLMInterfaceInput*>(Interfaces[idx]);
-        assert(ifc -> GetInterfaceID() == interfaceID);
+        TLMInterfaceInput* ifc = GetInterface<TLMInterfaceInput>(interfaceID);
         // Check if the interface expects more data from the coupled simulation
         // Receive if necessary .Note that potentially more that one receive is possible
         ReceiveTimeData(ifc, time);
@@ -653,9 +1066,8 @@ void PluginImplementer::GetTimeDataSignal(int interfaceID, double time, TLMTimeD
         ifc->GetTimeData(DataOut);
     }
     else {          //Monitoring = receive time data for output interface
-        TLMInterfaceOutput* ifc = dynamic_cast<TLMInterfaceOutput*>(Interfaces[idx]);
+        TLMInterfaceOutput* ifc = GetInterface<TLMInterfaceOutput>(interfaceID);
 
-        assert(ifc -> GetInterfaceID() == interfaceID);
         // Check if the interface expects more data from the coupled simulation
         // Receive if necessary .Note that potentially more that one receive is possible
         ReceiveTimeData(ifc, time);
@@ -669,9 +1081,7 @@ void PluginImplementer::GetTimeData1D(int interfaceID, double time, TLMTimeData1
     if(!ModelChecked) CheckModel();
 
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterface1D* ifc = dynamic_cast<TLMInterface1D*>(Interfaces[idx]);
-    assert(ifc -> GetInterfaceID() == interfaceID);
+    TLMInterface1D* ifc = GetInterface<TLMInterface1D>(interfaceID);
 
     // Check if the interface expects more data from the coupled simulation
     // Receive if necessary .Note that potentially more that one receive is possible
@@ -689,9 +1099,7 @@ void PluginImplementer::GetTimeData3D(int interfaceID, double time, TLMTimeData3
     if(!ModelChecked) CheckModel();
 
     // Use the ID to get to the right interface object
-    int idx = GetInterfaceIndex(interfaceID);
-    TLMInterface3D* ifc = dynamic_cast<TLMInterface3D*>(Interfaces[idx]);
-    assert(ifc -> GetInterfaceID() == interfaceID);
+    TLMInterface3D* ifc = GetInterface<TLMInterface3D>(interfaceID);
 
     // Check if the interface expects more data from the coupled simulation
     // Receive if necessary .Note that potentially more that one receive is possible
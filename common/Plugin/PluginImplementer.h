@@ -8,6 +8,7 @@
 #include <vector>
 #include <map>
 #include "Communication/TLMClientComm.h"
+#include "Communication/TLMClientReceiver.h"
 #include "Interfaces/TLMInterface.h"
 #include "Interfaces/TLMInterfaceSignalInput.h"
 #include "Interfaces/TLMInterfaceSignalOutput.h"
@@ -27,7 +28,8 @@ public:
     //! Destructor
     ~PluginImplementer();
 
-    //! Catch signals
+    //! Catch signals, tells the manager to abort. The sender thread is
+    //! stopped first since the abort is written directly.
     void HandleSignal(int signum);
 
     void SetInitialForce3D(int interfaceID,
@@ -40,6 +42,18 @@ public:
     void SetInitialFlow1D(int interfaceID, double flow);
     void SetInitialValue(int interfaceID, double value);
 
+    //! Receive the time data in background threads, see TLMPlugin.
+    void SetBackgroundReceive(bool enable) { BackgroundReceive = enable; }
+
+    //! Send the time data from a background thread, see TLMPlugin.
+    void SetAsyncSend(bool enable) { AsyncSend = enable; }
+
+    //! Set the interface statistics file, see TLMPlugin.
+    void SetStatisticsFile(const std::string& file, double period) {
+        Statistics.SetFile(file, period);
+        StatisticsFileSet = true;
+    }
+
     //! CheckModel method results in CheckModel request sent to TLM manager.
     //! The successful return indicates that the simulation is ready to run.
     void CheckModel();
@@ -66,15 +80,76 @@ protected:
     //! The message object used as a buffer
     TLMMessage *Message;
 
-    //! MapID2Ind provides a mapping between the ID of interfaces
-    //!  and their index in the Interfaces vector
-    std::map<int, int> MapID2Ind;
+    //! Component ID received from the TLM manager
+    int ComponentID;
+
+    //! InterfaceSlot is an entry of the interface table
+    struct InterfaceSlot {
+        InterfaceSlot() : Ifc(NULL), Index(-1), Kind(TLM_INTERFACE_3D) {}
+
+        //! The interface, NULL if the ID is not registered by this component
+        omtlm_TLMInterface* Ifc;
+
+        //! Index of the interface in the Interfaces vector
+        int Index;
+
+        //! The concrete class of the interface
+        TLMInterfaceKind Kind;
+    };
+
+    //! Slots maps the interface IDs to the registered interfaces. The IDs
+    //! are given out by the manager from 0 on, so the table is a vector
+    //! indexed by the ID.
+    std::vector<InterfaceSlot> Slots;
 
     //! MapID2Ind provides a mapping between the ID of parameters
     //!  and their index in the Parameters vector
     std::map<int, int> MapID2Par;
 
-    int GetInterfaceIndex(int ID) const { return MapID2Ind.find(ID)->second; }
+    //! Buffer for the messages unpacked from a time data bundle
+    TLMMessage BundleEntry;
+
+    //! Receive the time data in background threads
+    bool BackgroundReceive;
+
+    //! Background receiver, started by CheckModel if BackgroundReceive is set
+    TLMClientReceiver Receiver;
+
+    //! Send the time data from a background thread
+    bool AsyncSend;
+
+    //! The interfaces of the current GetForces* call, reused between the calls
+    std::vector<omtlm_TLMInterface*> BatchIfcs;
+
+    //! Statistics of the registered interfaces
+    TLMStatistics Statistics;
+
+    //! Set if SetStatisticsFile was called, otherwise Init sets the default
+    bool StatisticsFileSet;
+
+    //! Number of interfaces that send data (all but the inputs)
+    size_t nSenders;
+
+    //! Number of the sending interfaces that wait for shutdown
+    size_t nSendersWaitingForShutdown;
+
+    //! Check if the interface ID is registered by this component
+    bool HasInterface(int ID) const { return ID >= 0 && ID < (int)Slots.size() && Slots[ID].Ifc != NULL; }
+
+    int GetInterfaceIndex(int ID) const { return Slots[ID].Index; }
+
+    //! Get the interface with the given ID as its class T (TLMInterface3D,
+    //! TLMInterface1D, TLMInterfaceInput or TLMInterfaceOutput), NULL if it
+    //! is not registered or of another class.
+    template<class T>
+    T* GetInterface(int ID) const {
+        if(ID < 0 || ID >= (int)Slots.size()) return NULL;
+        const InterfaceSlot& slot = Slots[ID];
+        return (slot.Kind == T::KIND && slot.Ifc != NULL) ? static_cast<T*>(slot.Ifc) : NULL;
+    }
+
+    //! Check if all sending interfaces wait for shutdown
+    bool AllSendersWaitForShutdown() const { return nSendersWaitingForShutdown >= nSenders; }
 
     int GetParameterIndex(int ID) const { return MapID2Par.find(ID)->second; }
 
@@ -88,6 +163,14 @@ protected:
                        double maxStep,
                        std::string ServerName);
 
+    //! SetupDirectLinks connects the interfaces listed in the CheckModel
+    //! reply directly to their linked interfaces in other components.
+    void SetupDirectLinks(TLMMessage& mess);
+
+    //! Start the background receiver on the manager connection and
+    //! the direct links.
+    void StartReceiver();
+
     void InterfaceReadyForTakedown(std::string IfcName);
 
     void AwaitClosePermission();
@@ -100,6 +183,11 @@ protected:
 
     int RegisterComponentParameter(std::string name, std::string defaultValue);
 
+    void RegisterTLMInterfaces(const std::vector<TLMInterfaceSpec>& interfaces,
+                               const std::vector<TLMParameterSpec>& parameters,
+                               std::vector<int>& interfaceIDs,
+                               std::vector<int>& parameterIDs);
+
     //! ReceiveTimeData receives time-stamped data from coupled simulations
     //! if the specified interface needs more data for the given time..
     //! Since the order of messages can vary the specified interface
@@ -111,6 +199,24 @@ protected:
     //!   time - time needed
     virtual void ReceiveTimeData(omtlm_TLMInterface* reqIfc, double time);
 
+    //! Receive the time data for all the interfaces in BatchIfcs that
+    //! need more data for the given time. The messages for the other
+    //! interfaces are unpacked on the way, so that the later interfaces
+    //! usually find their data already received.
+    void ReceiveBatchTimeData(double time);
+
+    //! Called by the Set* methods for an interface that waits for shutdown,
+    //! takes the component down when all sending interfaces are done.
+    void CheckShutdown(omtlm_TLMInterface* ifc);
+
+    //! Unpack a received time data message into its interface.
+    //! Returns the interface.
+    omtlm_TLMInterface* UnpackTimeData(TLMMessage& mess);
+
+    //! Send the pending time data bundle if no other interface is due
+    //! to send data for the given time.
+    void FlushBundle(double time);
+
     //! Evaluate the reaction force from the TLM connection
     //! for a specified interface. Might need to receive messages from the
     //! TLM manager with TimeData.
@@ -145,6 +251,21 @@ protected:
                     double ang_speed[],
                     double* force);
 
+    //! Evaluate the reaction forces of n interfaces at once, see TLMPlugin.
+    void GetForces3D(int n,
+                     const int interfaceIDs[],
+                     double time,
+                     double position[],
+                     double orientation[],
+                     double speed[],
+                     double ang_speed[],
+                     double* force);
+    void GetForces1D(int n,
+                     const int interfaceIDs[],
+                     double time,
+                     double speed[],
+                     double* force);
+
     void GetWaveImpedance1D(int interfaceID, double time, double *impedance, double *wave);
 
     void GetWaveImpedance3D(int interfaceID, double time, double *Zt, double *Zr, double *wave);
@@ -168,6 +289,20 @@ protected:
                      double speed[],
                      double ang_speed[]);
 
+    //! Set the motion of n interfaces at once, see TLMPlugin.
+    void SetMotions3D(int n,
+                      const int forceIDs[],
+                      double time,
+                      double position[],
+                      double orientation[],
+                      double speed[],
+                      double ang_speed[]);
+    void SetMotions1D(int n,
+                      const int forceIDs[],
+                      double time,
+                      double position[],
+                      double speed[]);
+
     //! GetConnectionParams returnes the ConnectionParams for
     //! the specified interface ID. Interface must be registered
     //! first.
@@ -12,6 +12,7 @@
 #include "Interfaces/TLMInterface.h"
 
 #include <string>
+#include <vector>
 
 #ifndef _MSC_VER
 // This is because there are too many virtual functions that have trivial body
@@ -19,6 +20,28 @@
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #endif
 
+//! Description of a TLM interface for TLMPlugin::RegisterTLMInterfaces,
+//! the fields have the meaning of the RegisteTLMInterface arguments.
+struct TLMInterfaceSpec {
+    std::string Name;
+    int Dimensions;
+    std::string Causality;
+    std::string Domain;
+
+    TLMInterfaceSpec(const std::string& name, int dimensions=6,
+                     const std::string& causality="bidirectional", const std::string& domain="mechanical")
+        : Name(name), Dimensions(dimensions), Causality(causality), Domain(domain) {}
+};
+
+//! Description of a component parameter for TLMPlugin::RegisterTLMInterfaces.
+struct TLMParameterSpec {
+    std::string Name;
+    std::string DefaultValue;
+
+    TLMParameterSpec(const std::string& name, const std::string& defaultValue)
+        : Name(name), DefaultValue(defaultValue) {}
+};
+
 //!
 //! \class TLMPlugin 
 //! This class provides an abstract interface for the client
@@ -45,7 +68,8 @@ public:
     //! \param timeStart start time for the simulation
     //! \param timeEnd end time for the simulation
     //! \param maxStep maximum step of the solver
-    //! \param serverName IP address and port of the computer running TLM manager
+    //! \param serverName IP address and port of the computer running TLM manager,
+    //!        or unix:\<path> of its Unix domain socket
     //!        separated by colon (e.g., 198.111.123.2:1111)
     virtual bool Init(std::string model,
                        double timeStart,
@@ -55,6 +79,29 @@ public:
 
     virtual void AwaitClosePermission() = 0;
 
+    //! Receive the time data in background threads, so that the network
+    //! latency overlaps with the solver work. GetForce and friends then only
+    //! wait if the data they need has not arrived yet. Must be called
+    //! before the simulation starts, i.e., before the first GetForce or
+    //! SetMotion call. Disabled by default, Init enables it if the
+    //! environment variable TLM_BACKGROUND_RECEIVE is set to 1.
+    virtual void SetBackgroundReceive(bool enable) = 0;
+
+    //! Send the time data from a background thread, so that SetMotion and
+    //! friends never wait for a full socket buffer. Must be called before
+    //! the simulation starts like SetBackgroundReceive. Disabled by default,
+    //! Init enables it if the environment variable TLM_ASYNC_SEND is set to 1.
+    virtual void SetAsyncSend(bool enable) = 0;
+
+    //! Set the file the interface statistics (message counts, wait and send
+    //! times, extrapolations) are written to, CSV if the name ends with
+    //! ".csv" and JSON otherwise. The file is rewritten every period seconds
+    //! while the simulation runs and at the end. An empty name disables the
+    //! file, the statistics are collected anyway. There is no file by
+    //! default, Init sets \<dir\>/\<model\>.stats.csv if the environment
+    //! variable TLM_STATS=\<dir\> is set.
+    virtual void SetStatisticsFile(const std::string& file, double period) = 0;
+
     //! Register TLM interface sends a registration request to TLMManager
     //! and returns the ID for the interface. '-1' is returned if
     //! the interface is not connected in the CompositeModel.
@@ -64,6 +111,16 @@ public:
 
     virtual int RegisterComponentParameter(std::string name, std::string defaultValue) = 0;
 
+    //! Register several TLM interfaces and component parameters at once.
+    //! Newer managers get all the requests in one message, which saves a
+    //! round-trip per interface at startup. The IDs are returned in the
+    //! order of the descriptions, as RegisteTLMInterface and
+    //! RegisterComponentParameter would return them.
+    virtual void RegisterTLMInterfaces(const std::vector<TLMInterfaceSpec>& interfaces,
+                                       const std::vector<TLMParameterSpec>& parameters,
+                                       std::vector<int>& interfaceIDs,
+                                       std::vector<int>& parameterIDs) = 0;
+
     //! Evaluate the reaction force from the TLM connection
     //! for a specified interface. This function might result in a request sent
     //! to the TLM manager.
@@ -98,6 +155,27 @@ public:
                             double speed[],
                             double ang_speed[],
                             double* force)  = 0;
+
+    //! Evaluate the reaction forces of n interfaces at once. The result is
+    //! the same as calling GetForce3D (GetForce1D) for each of them, but the
+    //! data needed by all the interfaces is received in one pass.
+    //! The arrays hold the values of the interfaces one after another,
+    //! i.e., position[3*n], orientation[9*n], speed[3*n], ang_speed[3*n]
+    //! and force[6*n] for 3D interfaces.
+    virtual void GetForces3D(int n,
+                             const int interfaceIDs[],
+                             double time,
+                             double position[],
+                             double orientation[],
+                             double speed[],
+                             double ang_speed[],
+                             double* force) = 0;
+    virtual void GetForces1D(int n,
+                             const int interfaceIDs[],
+                             double time,
+                             double speed[],
+                             double* force) = 0;
+
     virtual void GetWaveImpedance1D(int interfaceID,
                                     double time,
                                     double* impedance,
@@ -127,6 +205,23 @@ public:
                              double speed[],
                              double ang_speed[]) = 0;
 
+    //! Set the motion of n interfaces at once, same as SetMotion3D
+    //! (SetMotion1D) for each of them, but the time data due to be sent
+    //! is flushed once for all the interfaces. The arrays are laid out
+    //! as for GetForces3D.
+    virtual void SetMotions3D(int n,
+                              const int forceIDs[],
+                              double time,
+                              double position[],
+                              double orientation[],
+                              double speed[],
+                              double ang_speed[]) = 0;
+    virtual void SetMotions1D(int n,
+                              const int forceIDs[],
+                              double time,
+                              double position[],
+                              double speed[]) = 0;
+
     virtual void GetParameterValue(int parameterID,
                                    std::string &Name,
                                    std::string &Value) = 0;
@@ -215,7 +310,7 @@ private:
     //! Maximum solver time step
     double MaxStep;
 
-    //! Name of the TLM mananger server (\<server>:\<port>)
+    //! Name of the TLM mananger server (\<server>:\<port> or unix:\<path>)
     std::string ServerName;
 
 };
@@ -0,0 +1,166 @@
+//
+// File: TLMInterpolationBench.cc
+//
+// Compares the orientation interpolation methods of the 3D interfaces:
+// the 3-2-1 Euler angle path used by default and the slerp and nlerp of
+// TLMQuaternionInterval. The accuracy is measured on a rotation with a
+// constant rate about a fixed axis, where the exact orientation is known
+// at any time, the speed as the time per interpolation call.
+//
+// Usage: interpbench (no arguments)
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "Interfaces/TLMInterpolation.h"
+#include "double3.h"
+#include "double33.h"
+
+//! Number of points per interval the error is evaluated at
+static const int BENCH_POINTS = 100;
+
+//! Number of calls timed per method
+static const int BENCH_CALLS = 2000000;
+
+//! The Euler angle interpolation as in TLMInterface3D::InterpolateLinear.
+//! Matrices are row-wise.
+void InterpolateEuler(double time, double t0, double t1, const double* A0, const double* A1, double* A) {
+    double33 R0(A0[0], A0[1], A0[2], A0[3], A0[4], A0[5], A0[6], A0[7], A0[8]);
+    double33 R1(A1[0], A1[1], A1[2], A1[3], A1[4], A1[5], A1[6], A1[7], A1[8]);
+    R1 = R0.T() * R1;
+    double3 phi = ATophi321(R1);
+    for(int j = 1; j <= 3; j++) {
+        phi(j) = ((time - t0) * phi(j)) / (t1 - t0);
+    }
+    R0 *= A321(phi);
+    R0.Get(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[8]);
+}
+
+//! Rotation by the angle about the unit axis u
+void Rotation(const double* u, double angle, double* A) {
+    const double c = cos(angle), s = sin(angle), C = 1 - c;
+    const double x = u[0], y = u[1], z = u[2];
+    A[0] = c + x*x*C;   A[1] = x*y*C - z*s; A[2] = x*z*C + y*s;
+    A[3] = y*x*C + z*s; A[4] = c + y*y*C;   A[5] = y*z*C - x*s;
+    A[6] = z*x*C - y*s; A[7] = z*y*C + x*s; A[8] = c + z*z*C;
+}
+
+//! C = A * B
+void Multiply(const double* A, const double* B, double* C) {
+    for(int i = 0; i < 3; i++) {
+        for(int j = 0; j < 3; j++) {
+            C[3*i + j] = 0;
+            for(int k = 0; k < 3; k++) {
+                C[3*i + j] += A[3*i + k] * B[3*k + j];
+            }
+        }
+    }
+}
+
+//! Angle of the rotation A^T B, i.e., the error of B if A is exact
+double AngleError(const double* A, const double* B) {
+    double trace = 0;
+    for(int i = 0; i < 3; i++) {
+        for(int k = 0; k < 3; k++) {
+            trace += A[3*k + i] * B[3*k + i];
+        }
+    }
+    double c = (trace - 1) / 2;
+    if(c > 1) c = 1;
+    if(c < -1) c = -1;
+    return acos(c);
+}
+
+//! Print the max. error over one interval for each method. The interval
+//! is [0, 1] with the rotation angle per interval given. Errors below
+//! about 2e-8 rad are not resolved, acos is not more precise near 1.
+void MeasureError(const char* label, const double* base, const double* axis, double angle) {
+    double R[9], A0[9], A1[9];
+    Rotation(axis, 0, R);
+    Multiply(base, R, A0);
+    Rotation(axis, angle, R);
+    Multiply(base, R, A1);
+
+    TLMQuaternionInterval interval;
+    interval.Set(0, A0, 1, A1);
+
+    double maxEuler = 0, maxSlerp = 0, maxNlerp = 0;
+    for(int k = 0; k <= BENCH_POINTS; k++) {
+        const double t = double(k) / BENCH_POINTS;
+        double exact[9], A[9];
+        Rotation(axis, angle * t, R);
+        Multiply(base, R, exact);
+
+        InterpolateEuler(t, 0, 1, A0, A1, A);
+        maxEuler = fmax(maxEuler, AngleError(exact, A));
+        interval.Interpolate(t, true, A);
+        maxSlerp = fmax(maxSlerp, AngleError(exact, A));
+        interval.Interpolate(t, false, A);
+        maxNlerp = fmax(maxNlerp, AngleError(exact, A));
+    }
+
+    printf("%-8s %-8g %10.1e %10.1e %10.1e\n", label, angle, maxEuler, maxSlerp, maxNlerp);
+}
+
+//! Nanoseconds per call of f(i, A), i = 0, 1, ...
+template<class F>
+double TimeCalls(F f) {
+    double A[9];
+    volatile double sink = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int i = 0; i < BENCH_CALLS; i++) {
+        f(i, A);
+        sink += A[0];
+    }
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / BENCH_CALLS;
+}
+
+int main() {
+    const double axis[3] = { 0.48, 0.6, 0.64 };
+    const double pitchAxis[3] = { 0, 1, 0 };
+    const double angles[] = { 1e-3, 1e-2, 1e-1, 0.5 };
+
+    printf("Max. angle error [rad] over an interval\n");
+    printf("%-8s %-8s %10s %10s %10s\n", "base", "angle", "euler", "slerp", "nlerp");
+    double base[9];
+    Rotation(pitchAxis, 0.7, base);
+    for(double angle : angles) {
+        MeasureError("general", base, axis, angle);
+    }
+    // Close to the singularity of the 3-2-1 angles
+    Rotation(pitchAxis, M_PI/2 - 1e-4, base);
+    for(double angle : angles) {
+        MeasureError("pitch90", base, axis, angle);
+    }
+
+    // Ten calls per interval as from a solver, and one call per interval
+    double R[9], A0[9], A1[9];
+    Rotation(axis, 0, R);
+    Multiply(base, R, A0);
+    Rotation(axis, 0.01, R);
+    Multiply(base, R, A1);
+    TLMQuaternionInterval interval;
+
+    printf("\nTime per call [ns]\n");
+    printf("%-28s %6.1f\n", "euler", TimeCalls([&](int i, double* A) {
+        InterpolateEuler(0.001 * (i % 10), 0, 0.01, A0, A1, A);
+    }));
+    printf("%-28s %6.1f\n", "slerp", TimeCalls([&](int i, double* A) {
+        interval.Set(0, A0, 0.01, A1);
+        interval.Interpolate(0.001 * (i % 10), true, A);
+    }));
+    printf("%-28s %6.1f\n", "nlerp", TimeCalls([&](int i, double* A) {
+        interval.Set(0, A0, 0.01, A1);
+        interval.Interpolate(0.001 * (i % 10), false, A);
+    }));
+    printf("%-28s %6.1f\n", "slerp, new interval", TimeCalls([&](int i, double* A) {
+        interval.Set(i, A0, i + 0.01, A1);
+        interval.Interpolate(i + 0.001 * (i % 10), true, A);
+    }));
+    printf("%-28s %6.1f\n", "nlerp, new interval", TimeCalls([&](int i, double* A) {
+        interval.Set(i, A0, i + 0.01, A1);
+        interval.Interpolate(i + 0.001 * (i % 10), false, A);
+    }));
+
+    return 0;
+}
@@ -11,6 +11,7 @@
 // The program uses TLM plug-in as any other tool should.
 
 #include "Plugin/TLMPlugin.h"
+#include "Logging/TLMTrace.h"
 #include <cmath>
 #include <iostream>
 #include <fstream>
@@ -88,6 +89,8 @@ int main(int argn, char* argv[]) {
         // Time step is random between 0.5 MaxStep and MaxStep
         dt = (MaxStep + rand() * MaxStep / RAND_MAX) / 2;
 
+        TLMTraceScope trace(TLM_TRACE_SOLVER_STEP, -1, Time+dt);
+
         // Get force & moment from TLM connection
         TlmForce->GetForce3D(forceID, Time+dt,  position, orientation, speed, ang_speed, force);
 
@@ -0,0 +1,206 @@
+//
+// File: TLMTraceMerge.cc
+//
+// Merges the trace files written with TLM_TRACE=<directory> by the manager,
+// the monitor and the simulation tools into one Chrome trace JSON file,
+// to be opened with chrome://tracing or https://ui.perfetto.dev
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Logging/TLMTrace.h"
+
+#ifdef _MSC_VER
+#include "mygetopt.h"
+#else
+#include <getopt.h>
+#endif
+
+using std::string;
+
+void usage() {
+    string usageStr =
+            "Usage: tlmtracemerge [-o <output>] <trace-file>..., where the trace files are written by the TLM processes\n"
+            "when the environment variable TLM_TRACE is set to a directory, e.g., tlmtracemerge -o run.json trace/*.tlmtrace\n"
+            "-o <output>        : Chrome trace JSON file to write (default tlmtrace.json)";
+    std::cout << usageStr << std::endl;
+    exit(1);
+}
+
+//! TraceProcess is the content of one trace file
+struct TraceProcess {
+    //! Process name given to TLMTrace::Open
+    string Name;
+
+    //! Operating system process ID
+    uint32_t PID;
+
+    //! Number of threads, the highest thread number in the events
+    uint32_t NumThreads;
+};
+
+//! An event with the index of its process
+struct MergedEvent {
+    TLMTraceEvent Event;
+    size_t Process;
+};
+
+//! Order by time, the events that start at the same time by simulation time.
+bool EarlierEvent(const MergedEvent& a, const MergedEvent& b) {
+    if(a.Event.Start != b.Event.Start) return a.Event.Start < b.Event.Start;
+    return a.Event.SimTime < b.Event.SimTime;
+}
+
+//! Read a trace file, add its events to events. Returns false if the file
+//! can't be read.
+bool ReadTrace(const string& fileName, size_t index, TraceProcess& process, std::vector<MergedEvent>& events) {
+    std::ifstream file(fileName.c_str(), std::ios::binary);
+    char magic[8];
+    uint32_t header[4];
+    if(!file.read(magic, 8) || strncmp(magic, "TLMTRACE", 8) != 0
+       || !file.read((char*)header, sizeof(header))) {
+        std::cerr << fileName << ": not a TLM trace file" << std::endl;
+        return false;
+    }
+    if(header[1] != 0x01020304) {
+        std::cerr << fileName << ": written on a machine of another byte order" << std::endl;
+        return false;
+    }
+    if(header[0] != TLMTrace::VERSION) {
+        std::cerr << fileName << ": unsupported version " << header[0] << std::endl;
+        return false;
+    }
+
+    process.PID = header[2];
+    process.Name.resize(header[3]);
+    if(header[3] > 0 && !file.read(&process.Name[0], header[3])) {
+        std::cerr << fileName << ": truncated header" << std::endl;
+        return false;
+    }
+
+    process.NumThreads = 0;
+    MergedEvent merged;
+    merged.Process = index;
+    while(file.read((char*)&merged.Event, sizeof(TLMTraceEvent))) {
+        process.NumThreads = std::max(process.NumThreads, merged.Event.Thread);
+        events.push_back(merged);
+    }
+    return true;
+}
+
+//! Write a string as a JSON string
+void WriteJSONString(std::ostream& out, const string& str) {
+    out << '"';
+    for(string::const_iterator it = str.begin(); it != str.end(); ++it) {
+        if(*it == '"' || *it == '\\') {
+            out << '\\' << *it;
+        }
+        else if((unsigned char)*it < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(*it) << std::dec << std::setfill(' ');
+        }
+        else {
+            out << *it;
+        }
+    }
+    out << '"';
+}
+
+int main(int argc, char* argv[]) {
+    string outFile = "tlmtrace.json";
+
+    char c;
+    while((c = getopt(argc, argv, "o:")) != -1) {
+        switch(c) {
+        case 'o':
+            outFile = optarg;
+            break;
+        default:
+            usage();
+            break;
+        }
+    }
+
+    if(optind >= argc) {
+        usage();
+    }
+
+    std::vector<TraceProcess> processes;
+    std::vector<MergedEvent> events;
+    for(int i = optind; i < argc; i++) {
+        TraceProcess process;
+        if(ReadTrace(argv[i], processes.size(), process, events)) {
+            processes.push_back(process);
+        }
+    }
+
+    if(events.empty()) {
+        std::cerr << "No events found." << std::endl;
+        return 1;
+    }
+
+    // The wall clock of all the processes is the common time line
+    std::sort(events.begin(), events.end(), EarlierEvent);
+    const int64_t origin = events.front().Event.Start;
+
+    std::ofstream out(outFile.c_str());
+    if(!out.good()) {
+        std::cerr << "Failed to open " << outFile << std::endl;
+        return 1;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+
+    // Name the processes and threads, the file index is the process ID in
+    // the merged trace since the files might come from several hosts.
+    for(size_t p = 0; p < processes.size(); p++) {
+        out << (p > 0 ? ",\n" : "") << "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": " << p + 1
+            << ", \"args\": {\"name\": ";
+        WriteJSONString(out, processes[p].Name + " (" + std::to_string(processes[p].PID) + ")");
+        out << "}}";
+        for(uint32_t t = 1; t <= processes[p].NumThreads; t++) {
+            out << ",\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": " << p + 1 << ", \"tid\": " << t
+                << ", \"args\": {\"name\": \"thread " << t << "\"}}";
+        }
+    }
+
+    // The simulation time reached by each process, shown as a counter so
+    // that the process the others wait for stands out.
+    std::vector<double> simTime(processes.size(), -HUGE_VAL);
+
+    for(std::vector<MergedEvent>::const_iterator it = events.begin(); it != events.end(); ++it) {
+        const TLMTraceEvent& e = it->Event;
+        const size_t pid = it->Process + 1;
+        const bool hasSimTime = !std::isnan(e.SimTime);
+
+        out << ",\n{\"ph\": \"X\", \"cat\": \"tlm\", \"name\": \"" << TLMTrace::KindName(e.Kind)
+            << "\", \"pid\": " << pid << ", \"tid\": " << e.Thread
+            << ", \"ts\": " << (e.Start - origin) * 1e-3 << ", \"dur\": " << e.Duration * 1e-3
+            << ", \"args\": {";
+        if(e.ID >= 0) {
+            out << "\"interface\": " << e.ID << (hasSimTime ? ", " : "");
+        }
+        if(hasSimTime) {
+            out << "\"sim_time\": " << std::setprecision(9) << e.SimTime << std::setprecision(3);
+        }
+        out << "}}";
+
+        if(hasSimTime && (e.Kind == TLM_TRACE_SOLVER_STEP || e.Kind == TLM_TRACE_SEND_TIME_DATA)
+           && e.SimTime > simTime[it->Process]) {
+            simTime[it->Process] = e.SimTime;
+            out << ",\n{\"ph\": \"C\", \"name\": \"sim_time\", \"pid\": " << pid
+                << ", \"ts\": " << (e.Start + e.Duration - origin) * 1e-3
+                << ", \"args\": {\"t\": " << std::setprecision(9) << e.SimTime << std::setprecision(3) << "}}";
+        }
+    }
+
+    out << "\n]}\n";
+
+    std::cout << "Merged " << events.size() << " events of " << processes.size()
+              << " processes into " << outFile << std::endl;
+    return 0;
+}